@@ -14,6 +14,7 @@ import (
 	"context"
 	"log"
 	"regexp"
+	"sort"
 	"sync"
 	"time"
 
@@ -51,6 +52,24 @@ func FileListerFunc(bh *gcs.BucketHandle, prefix string, filter *regexp.Regexp)
 	}
 }
 
+// LargestFirst wraps a FileLister so that it lists the largest files first.
+// Dispatching the longest tasks first keeps a few large archives at the end
+// of a job from setting the job's completion time, since the remaining small
+// tasks fill in around them.
+func LargestFirst(fl FileLister) FileLister {
+	return func(ctx context.Context) ([]*storage.ObjectAttrs, int64, error) {
+		files, bytes, err := fl(ctx)
+		sort.SliceStable(files, func(i, j int) bool {
+			// Nil files are skipped by streamToPending, so order them last.
+			if files[i] == nil || files[j] == nil {
+				return files[j] == nil && files[i] != nil
+			}
+			return files[i].Size > files[j].Size
+		})
+		return files, bytes, err
+	}
+}
+
 // Context implements context.Context, but allows injection of an alternate Err().
 type Context struct {
 	context.Context
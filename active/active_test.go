@@ -237,3 +237,43 @@ func TestExpiredFileListerContext(t *testing.T) {
 		t.Error("Should return os.ErrInvalid", err)
 	}
 }
+
+func TestLargestFirst(t *testing.T) {
+	p := newCounter(t)
+	lister := func(ctx context.Context) ([]*storage.ObjectAttrs, int64, error) {
+		return []*storage.ObjectAttrs{
+			{Name: "small", Size: 10},
+			nil,
+			{Name: "large", Size: 1000},
+			{Name: "medium", Size: 100},
+			{Name: "medium2", Size: 100},
+		}, 1210, nil
+	}
+
+	ctx := context.Background()
+	fs, err := active.NewGCSSource(ctx, "test", active.LargestFirst(lister), p.toRunnable)
+	if err != nil {
+		t.Fatal(err)
+	}
+	names := []string{}
+	for {
+		r, err := fs.Next(ctx)
+		if err == iterator.Done {
+			break
+		}
+		if err != nil {
+			t.Fatal(err)
+		}
+		names = append(names, r.(*runnable).obj.Name)
+	}
+	want := []string{"large", "medium", "medium2", "small"}
+	if len(names) != len(want) {
+		t.Fatal("Wrong files", names)
+	}
+	for i := range want {
+		if names[i] != want[i] {
+			t.Error("Wrong order", names)
+			break
+		}
+	}
+}
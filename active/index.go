@@ -0,0 +1,181 @@
+package active
+
+import (
+	"context"
+	"log"
+	"net/url"
+	"strconv"
+	"strings"
+
+	"cloud.google.com/go/storage"
+	"github.com/googleapis/google-cloud-go-testing/storage/stiface"
+	"github.com/prometheus/client_golang/prometheus"
+	"github.com/prometheus/client_golang/prometheus/promauto"
+	"google.golang.org/api/iterator"
+
+	"github.com/m-lab/etl/metrics"
+)
+
+// Processing index.
+//   A reprocessing job lists and parses every archive under its prefix,
+//   though usually only a few have changed since they were last processed.
+//   A ProcessedIndex records each archive processed successfully, keyed by
+//   the archive object's path and generation, the parser version, and the
+//   output target, so that JobFileSource can skip archives whose output is
+//   already current.
+//
+//   This is only correct for outputs that are appended to, such as GCS.
+//   Gardener rebuilds each day of BigQuery output from scratch, so every
+//   archive must be parsed again.  Archives with any failed rows are never
+//   recorded, so that reprocessing repairs them.
+
+// SkippedFiles counts the archives skipped because the processing index
+// shows they have already been processed.
+//
+// Provides metrics:
+//   etl_skipped_files{target}
+// Example usage:
+//   SkippedFiles.WithLabelValues("gs://etl-mlab-sandbox/jsonl").Inc()
+var SkippedFiles = promauto.NewCounterVec(
+	prometheus.CounterOpts{
+		Name: "etl_skipped_files",
+		Help: "Archives skipped because they were already processed.",
+	},
+	[]string{"target"},
+)
+
+// IndexKey identifies the processing of one archive.
+type IndexKey struct {
+	Path       string // gs://bucket/object
+	Generation int64  // The archive object's generation.
+	Version    string // The parser version.
+	Target     string // The output destination, e.g. a bucket or dataset.
+}
+
+// ProcessedIndex is a persistent record of the archives processed
+// successfully.
+type ProcessedIndex interface {
+	// Processed returns the subset of keys recorded by MarkProcessed.
+	Processed(ctx context.Context, keys []IndexKey) (map[IndexKey]bool, error)
+	// MarkProcessed records that key has been processed successfully.
+	MarkProcessed(ctx context.Context, key IndexKey) error
+}
+
+// SkipProcessed wraps a FileLister so that it omits the files that idx
+// records as processed with the parser version, into target.  If the index
+// cannot be read, all files are listed.
+func SkipProcessed(fl FileLister, idx ProcessedIndex, version, target string) FileLister {
+	return func(ctx context.Context) ([]*storage.ObjectAttrs, int64, error) {
+		files, bytes, err := fl(ctx)
+		keys := make([]IndexKey, 0, len(files))
+		for _, f := range files {
+			if f != nil {
+				keys = append(keys, fileKey(f, version, target))
+			}
+		}
+		if len(keys) == 0 {
+			return files, bytes, err
+		}
+		done, idxErr := idx.Processed(ctx, keys)
+		if idxErr != nil {
+			log.Println("Ignoring processing index:", idxErr)
+			metrics.ActiveErrors.WithLabelValues(target, "processed index").Inc()
+			return files, bytes, err
+		}
+		remaining := make([]*storage.ObjectAttrs, 0, len(files))
+		for _, f := range files {
+			if f != nil && done[fileKey(f, version, target)] {
+				bytes -= f.Size
+				SkippedFiles.WithLabelValues(target).Inc()
+				continue
+			}
+			remaining = append(remaining, f)
+		}
+		if skipped := len(files) - len(remaining); skipped > 0 {
+			log.Println("Skipping", skipped, "already processed files")
+		}
+		return remaining, bytes, err
+	}
+}
+
+// fileKey returns the IndexKey for processing f.
+func fileKey(f *storage.ObjectAttrs, version, target string) IndexKey {
+	return IndexKey{
+		Path:       "gs://" + f.Bucket + "/" + f.Name,
+		Generation: f.Generation,
+		Version:    version,
+		Target:     target,
+	}
+}
+
+// GCSIndex is a ProcessedIndex kept in GCS, as one empty object for each
+// archive and output target, with the archive generation and the parser
+// version in the object's metadata.  Each archive's record is overwritten
+// when it is processed again.
+type GCSIndex struct {
+	client stiface.Client
+	bucket string
+	prefix string
+}
+
+// NewGCSIndex creates a GCSIndex with objects under prefix in bucket.
+// The client must have write access.
+func NewGCSIndex(client stiface.Client, bucket, prefix string) *GCSIndex {
+	if prefix != "" && !strings.HasSuffix(prefix, "/") {
+		prefix += "/"
+	}
+	return &GCSIndex{client: client, bucket: bucket, prefix: prefix}
+}
+
+// name returns the index object name for the key's archive and target.
+func (idx *GCSIndex) name(key IndexKey) string {
+	return idx.prefix + url.PathEscape(key.Target) + "/" + strings.TrimPrefix(key.Path, "gs://")
+}
+
+// Processed implements ProcessedIndex.  It lists the index objects sharing
+// the longest common prefix of the keys' objects, which for a single job is
+// usually one date directory.
+func (idx *GCSIndex) Processed(ctx context.Context, keys []IndexKey) (map[IndexKey]bool, error) {
+	done := make(map[IndexKey]bool, len(keys))
+	if len(keys) == 0 {
+		return done, nil
+	}
+	common := idx.name(keys[0])
+	for _, key := range keys[1:] {
+		name := idx.name(key)
+		n := 0
+		for n < len(common) && n < len(name) && common[n] == name[n] {
+			n++
+		}
+		common = common[:n]
+	}
+	records := map[string]map[string]string{}
+	it := idx.client.Bucket(idx.bucket).Objects(ctx, &storage.Query{Prefix: common})
+	for {
+		o, err := it.Next()
+		if err == iterator.Done {
+			break
+		}
+		if err != nil {
+			return nil, err
+		}
+		records[o.Name] = o.Metadata
+	}
+	for _, key := range keys {
+		md, ok := records[idx.name(key)]
+		if ok && md["generation"] == strconv.FormatInt(key.Generation, 10) && md["version"] == key.Version {
+			done[key] = true
+		}
+	}
+	return done, nil
+}
+
+// MarkProcessed implements ProcessedIndex.
+func (idx *GCSIndex) MarkProcessed(ctx context.Context, key IndexKey) error {
+	w := idx.client.Bucket(idx.bucket).Object(idx.name(key)).NewWriter(ctx)
+	w.ObjectAttrs().Metadata = map[string]string{
+		"generation": strconv.FormatInt(key.Generation, 10),
+		"version":    key.Version,
+	}
+	return w.Close()
+}
@@ -0,0 +1,123 @@
+package active_test
+
+import (
+	"context"
+	"errors"
+	"net/url"
+	"sync"
+	"testing"
+
+	"cloud.google.com/go/storage"
+
+	"github.com/m-lab/etl/active"
+	"github.com/m-lab/go/cloudtest/gcsfake"
+)
+
+// memIndex is an in-memory ProcessedIndex.
+type memIndex struct {
+	lock sync.Mutex
+	done map[active.IndexKey]bool
+	err  error
+}
+
+func (idx *memIndex) Processed(ctx context.Context, keys []active.IndexKey) (map[active.IndexKey]bool, error) {
+	idx.lock.Lock()
+	defer idx.lock.Unlock()
+	if idx.err != nil {
+		return nil, idx.err
+	}
+	result := map[active.IndexKey]bool{}
+	for _, k := range keys {
+		if idx.done[k] {
+			result[k] = true
+		}
+	}
+	return result, nil
+}
+
+func (idx *memIndex) MarkProcessed(ctx context.Context, key active.IndexKey) error {
+	idx.lock.Lock()
+	defer idx.lock.Unlock()
+	idx.done[key] = true
+	return nil
+}
+
+func TestSkipProcessed(t *testing.T) {
+	files := []*storage.ObjectAttrs{
+		{Bucket: "foobar", Name: "a", Size: 1, Generation: 1},
+		{Bucket: "foobar", Name: "b", Size: 2, Generation: 2},
+		{Bucket: "foobar", Name: "c", Size: 4, Generation: 3},
+	}
+	lister := func(ctx context.Context) ([]*storage.ObjectAttrs, int64, error) {
+		return append([]*storage.ObjectAttrs{}, files...), 7, nil
+	}
+	idx := &memIndex{done: map[active.IndexKey]bool{
+		{Path: "gs://foobar/a", Generation: 1, Version: "v1", Target: "out"}: true,
+		// Stale generation.
+		{Path: "gs://foobar/b", Generation: 1, Version: "v1", Target: "out"}: true,
+		// Different parser version.
+		{Path: "gs://foobar/c", Generation: 3, Version: "v0", Target: "out"}: true,
+	}}
+
+	got, bytes, err := active.SkipProcessed(lister, idx, "v1", "out")(context.Background())
+	if err != nil {
+		t.Fatal(err)
+	}
+	if len(got) != 2 || got[0].Name != "b" || got[1].Name != "c" || bytes != 6 {
+		t.Errorf("SkipProcessed() = %v, %d, want [b c], 6", got, bytes)
+	}
+
+	// Index errors should not prevent processing.
+	idx.err = errors.New("index error")
+	got, bytes, err = active.SkipProcessed(lister, idx, "v1", "out")(context.Background())
+	if err != nil || len(got) != 3 || bytes != 7 {
+		t.Errorf("SkipProcessed() = %v, %d, %v, want all files", got, bytes, err)
+	}
+}
+
+func TestGCSIndexProcessed(t *testing.T) {
+	client := gcsfake.GCSClient{}
+	client.AddTestBucket("index",
+		&gcsfake.BucketHandle{
+			ObjAttrs: []*storage.ObjectAttrs{
+				{Bucket: "index", Name: "done/out/foobar/ndt/obj1",
+					Metadata: map[string]string{"generation": "1", "version": "v1"}},
+				{Bucket: "index", Name: "done/out/foobar/ndt/obj2",
+					Metadata: map[string]string{"generation": "1", "version": "v1"}},
+				{Bucket: "index", Name: "done/other/foobar/ndt/obj3",
+					Metadata: map[string]string{"generation": "1", "version": "v1"}},
+			}})
+	idx := active.NewGCSIndex(&client, "index", "done")
+
+	keys := []active.IndexKey{
+		{Path: "gs://foobar/ndt/obj1", Generation: 1, Version: "v1", Target: "out"},
+		{Path: "gs://foobar/ndt/obj2", Generation: 2, Version: "v1", Target: "out"},
+		{Path: "gs://foobar/ndt/obj3", Generation: 1, Version: "v1", Target: "out"},
+	}
+	done, err := idx.Processed(context.Background(), keys)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if len(done) != 1 || !done[keys[0]] {
+		t.Errorf("Processed() = %v, want only %v", done, keys[0])
+	}
+}
+
+func TestMarkProcessed(t *testing.T) {
+	ctx := context.Background()
+	g := active.NewGardenerAPI(url.URL{}, testClient())
+	obj := &storage.ObjectAttrs{Bucket: "foobar", Name: "ndt/ndt5/2019/01/01/obj1", Generation: 5}
+	// Without an index, this does nothing.
+	if err := g.MarkProcessed(ctx, obj); err != nil {
+		t.Error(err)
+	}
+	idx := &memIndex{done: map[active.IndexKey]bool{}}
+	g.UseIndex(idx, "v1", "out")
+	if err := g.MarkProcessed(ctx, obj); err != nil {
+		t.Error(err)
+	}
+	want := active.IndexKey{Path: "gs://foobar/ndt/ndt5/2019/01/01/obj1", Generation: 5, Version: "v1", Target: "out"}
+	if !idx.done[want] {
+		t.Errorf("MarkProcessed() recorded %v, want %v", idx.done, want)
+	}
+}
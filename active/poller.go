@@ -16,6 +16,7 @@ import (
 	"github.com/prometheus/client_golang/prometheus"
 	"github.com/prometheus/client_golang/prometheus/promauto"
 	"golang.org/x/sync/errgroup"
+	"google.golang.org/api/iterator"
 	"google.golang.org/api/option"
 
 	job "github.com/m-lab/etl-gardener/client"
@@ -45,6 +46,12 @@ var JobFailures = promauto.NewCounterVec(
 type GardenerAPI struct {
 	trackerBase url.URL
 	gcs         stiface.Client
+
+	// If index is non-nil, archives already processed with the parser
+	// version into the output target are skipped.
+	index   ProcessedIndex
+	version string
+	target  string
 }
 
 // NewGardenerAPI creates a GardenerAPI.
@@ -52,6 +59,21 @@ func NewGardenerAPI(trackerBase url.URL, gcs stiface.Client) *GardenerAPI {
 	return &GardenerAPI{trackerBase: trackerBase, gcs: gcs}
 }
 
+// UseIndex makes JobFileSource skip the archives that idx records as
+// processed with the parser version, into the output target.
+func (g *GardenerAPI) UseIndex(idx ProcessedIndex, version, target string) {
+	g.index, g.version, g.target = idx, version, target
+}
+
+// MarkProcessed records obj in the processing index, if any, once it has
+// been processed successfully.
+func (g *GardenerAPI) MarkProcessed(ctx context.Context, obj *storage.ObjectAttrs) error {
+	if g.index == nil {
+		return nil
+	}
+	return g.index.MarkProcessed(ctx, fileKey(obj, g.version, g.target))
+}
+
 // MustStorageClient creates a default GCS client.
 func MustStorageClient(ctx context.Context) stiface.Client {
 	c, err := storage.NewClient(ctx, option.WithScopes(storage.ScopeReadOnly))
@@ -154,6 +176,10 @@ func (g *GardenerAPI) JobFileSource(ctx context.Context, job tracker.Job,
 		return nil, err
 	}
 	lister := FileListerFunc(bh, prefix, filter)
+	if g.index != nil {
+		lister = SkipProcessed(lister, g.index, g.version, g.target)
+	}
+	lister = LargestFirst(lister)
 	gcsSource, err := NewGCSSource(ctx, job.Path(), lister, toRunnable)
 	if err != nil {
 		failMetric(job, "GCSSource")
@@ -189,6 +215,10 @@ func (g *GardenerAPI) pollAndRun(ctx context.Context,
 	}
 
 	eg, err := g.RunAll(ctx, src, job.Job)
+	if err == iterator.Done {
+		// All the job's tasks were dispatched.
+		err = nil
+	}
 
 	// Once all are dispatched, we want to wait until all have completed
 	// before posting the state change.
@@ -206,12 +236,23 @@ func (g *GardenerAPI) pollAndRun(ctx context.Context,
 	return err
 }
 
-// Poll requests work items from gardener, and processes them.
+// Poll requests work items from gardener, and processes them, with at most
+// maxWorkers running at once.
 func (g *GardenerAPI) Poll(ctx context.Context,
 	toRunnable func(o *storage.ObjectAttrs) Runnable, maxWorkers int, period time.Duration) {
-	// Poll no faster than period.
+	g.PollWithTokens(ctx, toRunnable, NewWSTokenSource(maxWorkers), period)
+}
+
+// PollWithTokens requests work items from gardener, and processes them as
+// admitted by throttle.
+// The next job is requested as soon as all tasks from the previous job have
+// been dispatched, so workers that go idle while the previous job's last
+// tasks are still running pick up files from the next job.
+func (g *GardenerAPI) PollWithTokens(ctx context.Context,
+	toRunnable func(o *storage.ObjectAttrs) Runnable, throttle TokenSource, period time.Duration) {
+	// Poll no faster than period after an error.
 	ticker := time.NewTicker(period)
-	throttle := NewWSTokenSource(maxWorkers)
+	defer ticker.Stop()
 	for {
 		select {
 		case <-ctx.Done():
@@ -219,12 +260,17 @@ func (g *GardenerAPI) Poll(ctx context.Context,
 			return
 		default:
 			err := g.pollAndRun(ctx, toRunnable, throttle)
-			if err != nil {
-				log.Println(err)
+			if err == nil {
+				continue
 			}
+			log.Println(err)
 		}
 
-		<-ticker.C // Wait for next tick, to avoid fast spinning on errors.
+		// Wait for next tick, to avoid fast spinning on errors.
+		select {
+		case <-ctx.Done():
+		case <-ticker.C:
+		}
 	}
 }
 
@@ -192,3 +192,40 @@ func TestGardenerAPI_Poll(t *testing.T) {
 		t.Error(&fg)
 	}
 }
+
+// Queued jobs should run back to back, without waiting for the poll period.
+func TestGardenerAPI_PollQueuedJobs(t *testing.T) {
+	ctx, cancel := context.WithCancel(context.Background())
+	defer cancel()
+
+	c := testClient()
+	fg := fakeGardener{t: t, jobs: make([]tracker.Job, 0)}
+	fg.AddJob(tracker.NewJob("foobar", "ndt", "ndt5", time.Date(2019, 01, 01, 0, 0, 0, 0, time.UTC)))
+	fg.AddJob(tracker.NewJob("foobar", "ndt", "ndt5", time.Date(2019, 01, 01, 0, 0, 0, 0, time.UTC)))
+	tracker := httptest.NewServer(&fg)
+	defer tracker.Close()
+	tkURL, err := url.Parse(tracker.URL)
+	rtx.Must(err, "bad url")
+
+	g := active.NewGardenerAPI(*tkURL, c)
+	p := newCounter(t)
+	done := make(chan struct{})
+	go func() {
+		g.Poll(ctx, p.toRunnable, 2, time.Hour)
+		close(done)
+	}()
+
+	time.Sleep(500 * time.Millisecond)
+	cancel()
+	<-done
+
+	p.lock.Lock()
+	defer p.lock.Unlock()
+	if p.success != 6 {
+		t.Error("Both jobs should have run 3 tasks:", p.success)
+	}
+	// Two each of starting, 3 tasks, postProcessing
+	if fg.updates != 10 {
+		t.Error(&fg)
+	}
+}
@@ -2,6 +2,9 @@ package active
 
 import (
 	"context"
+	"runtime/metrics"
+	"sync/atomic"
+	"time"
 
 	"golang.org/x/sync/semaphore"
 )
@@ -32,6 +35,104 @@ func NewWSTokenSource(n int) TokenSource {
 	return &wsTokenSource{semaphore.NewWeighted(int64(n))}
 }
 
+// RunnableTokenSource is a TokenSource that admits each Runnable according
+// to its expected cost.  Throttle acquires its tokens after Next returns
+// the Runnable, rather than before.
+type RunnableTokenSource interface {
+	TokenSource
+	// AcquireFor blocks until r may run, and returns the function that
+	// releases its tokens.
+	AcquireFor(ctx context.Context, r Runnable) (release func(), err error)
+}
+
+// heapPollInterval is how often a blocked AcquireFor rechecks the heap.
+const heapPollInterval = time.Second
+
+// WeightedTokenSource budgets the estimated resources, e.g. memory bytes,
+// of the running Runnables, instead of their number.  The weight of a
+// Runnable is clamped to the budget, so that a very large one can still
+// run, alone.  If a heap limit is set, no new Runnable is admitted while
+// the live heap exceeds it, unless nothing else is running.
+// WeightedTokenSource is THREAD-SAFE.
+type WeightedTokenSource struct {
+	sem    *semaphore.Weighted
+	budget int64
+	weight func(Runnable) int64
+
+	heapLimit uint64
+	heapBytes func() uint64
+	inFlight  int64 // Total weight of admitted Runnables, accessed atomically.
+}
+
+// NewWeightedTokenSource returns a token source that admits Runnables
+// while the total of weight(r) for the running Runnables is at most budget.
+func NewWeightedTokenSource(budget int64, weight func(Runnable) int64) *WeightedTokenSource {
+	return &WeightedTokenSource{
+		sem:       semaphore.NewWeighted(budget),
+		budget:    budget,
+		weight:    weight,
+		heapBytes: liveHeapBytes,
+	}
+}
+
+// SetHeapLimit sets the live heap size, in bytes, above which new
+// Runnables are not admitted.  Zero disables the limit.
+func (ws *WeightedTokenSource) SetHeapLimit(bytes uint64) {
+	ws.heapLimit = bytes
+}
+
+// liveHeapBytes returns the bytes in live and unswept heap objects.  Unlike
+// runtime.ReadMemStats, this does not stop the world.
+func liveHeapBytes() uint64 {
+	sample := []metrics.Sample{{Name: "/memory/classes/heap/objects:bytes"}}
+	metrics.Read(sample)
+	if sample[0].Value.Kind() != metrics.KindUint64 {
+		return 0
+	}
+	return sample[0].Value.Uint64()
+}
+
+// AcquireFor implements RunnableTokenSource.
+func (ws *WeightedTokenSource) AcquireFor(ctx context.Context, r Runnable) (func(), error) {
+	w := ws.weight(r)
+	if w < 1 {
+		w = 1
+	}
+	if w > ws.budget {
+		w = ws.budget
+	}
+	for ws.heapLimit > 0 && atomic.LoadInt64(&ws.inFlight) > 0 && ws.heapBytes() > ws.heapLimit {
+		select {
+		case <-ctx.Done():
+			return nil, ctx.Err()
+		case <-time.After(heapPollInterval):
+		}
+	}
+	if err := ws.sem.Acquire(ctx, w); err != nil {
+		return nil, err
+	}
+	atomic.AddInt64(&ws.inFlight, w)
+	return func() {
+		atomic.AddInt64(&ws.inFlight, -w)
+		ws.sem.Release(w)
+	}, nil
+}
+
+// Acquire implements TokenSource, with a weight of one.
+func (ws *WeightedTokenSource) Acquire(ctx context.Context) error {
+	if err := ws.sem.Acquire(ctx, 1); err != nil {
+		return err
+	}
+	atomic.AddInt64(&ws.inFlight, 1)
+	return nil
+}
+
+// Release implements TokenSource, releasing a token from Acquire.
+func (ws *WeightedTokenSource) Release() {
+	atomic.AddInt64(&ws.inFlight, -1)
+	ws.sem.Release(1)
+}
+
 // throttedSource encapsulates a Source and a throttling mechanism.
 type throttledSource struct {
 	RunnableSource
@@ -53,6 +154,18 @@ func (tr *throttledRunnable) Run(ctx context.Context) error {
 
 // Next implements Source.Next
 func (ts *throttledSource) Next(ctx context.Context) (Runnable, error) {
+	if rts, ok := ts.throttle.(RunnableTokenSource); ok {
+		// The tokens depend on the Runnable, so it must be fetched first.
+		next, err := ts.RunnableSource.Next(ctx)
+		if err != nil {
+			return nil, err
+		}
+		release, err := rts.AcquireFor(ctx, next)
+		if err != nil {
+			return nil, err
+		}
+		return &throttledRunnable{Runnable: next, release: release}, nil
+	}
 	// We want Next to block here until a throttle token is available.
 	err := ts.throttle.Acquire(ctx)
 	if err != nil {
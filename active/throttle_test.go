@@ -114,3 +114,49 @@ func TestThrottledSource(t *testing.T) {
 		t.Error("Max running != 2", src.stats.max())
 	}
 }
+
+func TestWeightedTokenSource(t *testing.T) {
+	src := source{count: 6, stats: newThrottleStats(100)}
+	// Each runnable weighs 2, so only two fit in a budget of 5.
+	tokens := active.NewWeightedTokenSource(5, func(r active.Runnable) int64 { return 2 })
+	ts := active.Throttle(&src, tokens)
+
+	eg, err := runAll(context.Background(), ts)
+	if err != iterator.Done {
+		t.Fatal("Expected iterator.Done", err)
+	}
+	if err := eg.Wait(); err != nil {
+		t.Fatal(err)
+	}
+	if src.stats.done() != 6 {
+		t.Error("Should have been 6 runnables", src.stats.done())
+	}
+	if src.stats.max() != 2 {
+		t.Error("Max running != 2", src.stats.max())
+	}
+
+	// Runnables heavier than the budget still run, one at a time.
+	src = source{count: 2, stats: newThrottleStats(100)}
+	tokens = active.NewWeightedTokenSource(5, func(r active.Runnable) int64 { return 100 })
+	// The heap is always over the limit, but the first runnable is admitted.
+	tokens.SetHeapLimit(1)
+	eg, _ = runAll(context.Background(), active.Throttle(&src, tokens))
+	if err := eg.Wait(); err != nil {
+		t.Fatal(err)
+	}
+	if src.stats.done() != 2 || src.stats.max() != 1 {
+		t.Error("Expected 2 runnables, one at a time", src.stats.done(), src.stats.max())
+	}
+
+	// A canceled context releases a blocked AcquireFor.
+	release, err := tokens.AcquireFor(context.Background(), nil)
+	if err != nil {
+		t.Fatal(err)
+	}
+	ctx, cancel := context.WithCancel(context.Background())
+	cancel()
+	if _, err := tokens.AcquireFor(ctx, nil); err != context.Canceled {
+		t.Error("Expected context.Canceled", err)
+	}
+	release()
+}
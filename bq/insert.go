@@ -15,7 +15,6 @@ package bq
 
 import (
 	"context"
-	"encoding/json"
 	"log"
 	"math/rand"
 	"net/http"
@@ -99,12 +98,15 @@ func NewColumnPartitionedInserter(pdt bqx.PDT) (row.Sink, error) {
 // NewColumnPartitionedInserterWithUploader creates a new BQInserter with appropriate characteristics.
 // TODO - migrate all the tests to use this instead of NewBQInserter.
 func NewColumnPartitionedInserterWithUploader(pdt bqx.PDT, uploader etl.Uploader) (row.Sink, error) {
+	return newScheduledSink(uploader, nil), nil
+}
+
+// newScheduledSink creates a sink whose inserts are paced by sched, which
+// may be nil.
+func newScheduledSink(uploader etl.Uploader, sched *Scheduler) row.Sink {
 	token := make(chan struct{}, 1)
 	token <- struct{}{}
-	fl := sink{uploader: uploader, putTimeout: putContextTimeout, maxRetryDelay: maxPutRetryDelay, token: token}
-
-	sink := (row.Sink)(&fl)
-	return sink, nil
+	return &sink{uploader: uploader, putTimeout: putContextTimeout, maxRetryDelay: maxPutRetryDelay, token: token, sched: sched}
 }
 
 // NewBQInserter initializes a new BQInserter
@@ -209,10 +211,10 @@ func (in *BQInserter) maybeCountRowSize(data []interface{}) {
 		return
 	}
 	// Note: this estimate works very well for map[]bigquery.Value types. And, we
-	// believe it is an okay estimate for struct types.
-	jsonRow, _ := json.Marshal(data[0])
+	// believe it is an okay estimate for struct types.  Rows that know their
+	// size, e.g. row.Encoded, are not encoded again.
 	metrics.RowSizeHistogram.WithLabelValues(
-		in.TableBase()).Observe(float64(len(jsonRow)))
+		in.TableBase()).Observe(float64(row.SizeOf(data[0])))
 }
 
 // InsertRows adds rows to the insert buffer, and flushes if necessary.
@@ -387,6 +389,7 @@ type sink struct {
 	uploader      etl.Uploader // May be a BQ Uploader, or a test Uploader
 	maxRetryDelay time.Duration
 	putTimeout    time.Duration // Timeout used for BQ put operations.
+	sched         *Scheduler    // Paces inserts, if not nil.
 
 	// TODO: Consider making some of these atomics?
 	pending  int // Number of rows being flushed.
@@ -403,7 +406,10 @@ type sink struct {
 
 // Commit implements row.Sink.
 // It is thread safe, and returns the number of rows successfull committed.
+// The BigQuery client encodes rows using the bigquery struct tags, so any
+// *row.Encoded rows are unwrapped rather than sent as JSON.
 func (in *sink) Commit(rows []interface{}, label string) (int, error) {
+	rows = row.Unwrap(rows)
 	in.acquire()
 	defer in.release()
 	return in.flushSlice(rows, label, label)
@@ -412,6 +418,15 @@ func (in *sink) Commit(rows []interface{}, label string) (int, error) {
 // Close synchronizes on the tokens, and closes the backing file.
 func (in *sink) Close() error { return nil }
 
+// maxBatchBytes is the target encoded size of each insert.  BigQuery rejects
+// requests over 10MB, and rows are measured before annotations are added, so
+// this leaves some headroom.
+const maxBatchBytes = 9 * 1000 * 1000
+
+// MaxBatchBytes implements row.BatchLimiter, so that row.Base sizes batches
+// to avoid splitting in flushSlice.
+func (in *sink) MaxBatchBytes() int { return maxBatchBytes }
+
 // flushSlice flushes a slice of rows to BigQuery.
 // It returns the number of rows successfully committed.
 // It is NOT threadsafe.
@@ -462,19 +477,40 @@ func (in *sink) flushSlice(rows []interface{}, label string, table string) (int,
 	//   until the target utilization is reaches, reducing the number of
 	//   concurrent tasks, and thus the frequency at which the tasks would
 	//   experience 'Quota error' events.
+	//
+	//  With a Scheduler, the pacing is also coordinated across all sinks
+	//   in the process, and quota errors reduce the shared insert rate.
+	//   Retries still back off, as the scheduler may allow an immediate
+	//   retry, and a burst of retries would exhaust them in microseconds.
 
 	start := time.Now()
+	size := 0
+	if in.sched != nil {
+		// Estimate the request size from the first row.
+		size = len(rows) * row.SizeOf(rows[0])
+	}
 	var err error
 	for backoff := 10 * time.Millisecond; backoff < in.maxRetryDelay; backoff *= 2 {
+		if in.sched != nil {
+			in.sched.Wait(context.Background(), size)
+		}
+		putStart := time.Now()
 		// This is heavyweight, and may run forever without a context deadline.
 		ctx, cancel := context.WithTimeout(context.Background(), in.putTimeout)
 		err = in.uploader.Put(ctx, rows)
 		cancel()
 
 		if err == nil || !strings.Contains(err.Error(), "Quota exceeded:") {
+			if err == nil && in.sched != nil {
+				in.sched.Succeeded(time.Since(putStart))
+			}
 			break
 		}
 		metrics.WarningCount.WithLabelValues(label, "", "Quota Exceeded").Inc()
+		if in.sched != nil {
+			// The retry also waits for the scheduler, at the reduced rate.
+			in.sched.QuotaExceeded()
+		}
 
 		// Use some randomness to reduce risk of synchronization across tasks.
 		delayNanos := float32(backoff.Nanoseconds()) * (0.5 + rand.Float32()) // between 0.5 and 1.5 * RetryDelay
@@ -564,7 +600,9 @@ func (in *BQInserter) Failed() int {
 //======================================================================
 
 // TODO consider adding a Job level cache.
-type bqSinkFactory struct{}
+type bqSinkFactory struct {
+	sched *Scheduler // Shared by all sinks from this factory.
+}
 
 // Get mplements factory.SinkFactory
 func (sf *bqSinkFactory) Get(
@@ -583,16 +621,17 @@ func (sf *bqSinkFactory) Get(
 	// data.  We then have to carefully parse the returned error object.
 	uploader.SkipInvalidRows = true
 
-	ins, err := NewColumnPartitionedInserterWithUploader(pdt, uploader)
-	if err != nil {
-		return nil, factory.NewError(path.DataType, "InserterCreation",
-			http.StatusInternalServerError, err)
-	}
-	return ins, nil
+	return newScheduledSink(uploader, sf.sched), nil
 }
 
-// NewSinkFactory returns the default SinkFactory
+// NewSinkFactory returns the default SinkFactory.  If etl.InsertMaxMBPerSec
+// is non-zero, all sinks it creates share a Scheduler limited to that rate.
 // TODO inject a common bq client.
 func NewSinkFactory() factory.SinkFactory {
-	return &bqSinkFactory{}
+	if etl.InsertMaxMBPerSec <= 0 {
+		return &bqSinkFactory{}
+	}
+	config := DefaultSchedulerConfig
+	config.MaxBytesPerSec = float64(etl.InsertMaxMBPerSec) * 1e6
+	return &bqSinkFactory{sched: NewScheduler(config)}
 }
@@ -0,0 +1,178 @@
+package bq
+
+import (
+	"context"
+	"sync"
+	"time"
+
+	"github.com/m-lab/etl/metrics"
+)
+
+// Insert scheduling.
+//   Without coordination, every sink backs off independently when BigQuery
+//   reports "Quota exceeded", so the pipeline alternates between thundering
+//   herds of inserts and many workers sleeping at once.  A Scheduler is a
+//   process wide token bucket, limiting both the bytes and the requests per
+//   second inserted by all sinks that share it.  The rates adapt by additive
+//   increase on each fast successful insert, and multiplicative decrease on
+//   quota errors, so the process converges near the quota with steady
+//   throughput.
+
+// SchedulerConfig holds the rate limits for a Scheduler.
+type SchedulerConfig struct {
+	MinBytesPerSec, MaxBytesPerSec float64
+	MinReqsPerSec, MaxReqsPerSec   float64
+
+	// Decrease is the factor applied to both rates on a quota error.
+	Decrease float64
+	// BytesIncrease and ReqsIncrease are added to the rates after each
+	// successful insert that completes faster than SlowInsert.
+	BytesIncrease, ReqsIncrease float64
+	// SlowInsert is the insert latency above which rates are not increased.
+	SlowInsert time.Duration
+}
+
+// DefaultSchedulerConfig is tuned for the default streaming insert quota of
+// 100MB/sec per project.  NewSinkFactory sets MaxBytesPerSec from
+// etl.InsertMaxMBPerSec.
+var DefaultSchedulerConfig = SchedulerConfig{
+	MinBytesPerSec: 1e6, MaxBytesPerSec: 100e6,
+	MinReqsPerSec: 2, MaxReqsPerSec: 500,
+	Decrease:      0.7,
+	BytesIncrease: 100e3, ReqsIncrease: 0.5,
+	SlowInsert: 5 * time.Second,
+}
+
+// minDecreaseInterval limits how often quota errors reduce the rates, as
+// many concurrent inserts typically fail together.
+const minDecreaseInterval = time.Second
+
+// Scheduler is a token bucket for bytes and requests, with AIMD rate
+// adaptation.  The bucket holds at most one second of tokens.
+// Scheduler is THREAD-SAFE.
+type Scheduler struct {
+	config SchedulerConfig
+	now    func() time.Time // For testing.
+
+	lock         sync.Mutex
+	bytesPerSec  float64
+	reqsPerSec   float64
+	bytes, reqs  float64 // Available tokens, which may be negative.
+	last         time.Time
+	lastDecrease time.Time
+}
+
+// NewScheduler creates a Scheduler, starting at half the maximum rates.
+func NewScheduler(config SchedulerConfig) *Scheduler {
+	s := &Scheduler{config: config, now: time.Now}
+	s.bytesPerSec = config.MaxBytesPerSec / 2
+	s.reqsPerSec = config.MaxReqsPerSec / 2
+	s.bytes, s.reqs = s.bytesPerSec, s.reqsPerSec
+	s.last = s.now()
+	return s
+}
+
+// refill adds tokens for the time since the last refill.  MUST hold the lock.
+func (s *Scheduler) refill(now time.Time) {
+	dt := now.Sub(s.last).Seconds()
+	if dt <= 0 {
+		return
+	}
+	s.last = now
+	s.bytes += dt * s.bytesPerSec
+	if s.bytes > s.bytesPerSec {
+		s.bytes = s.bytesPerSec
+	}
+	s.reqs += dt * s.reqsPerSec
+	if s.reqs > s.reqsPerSec {
+		s.reqs = s.reqsPerSec
+	}
+}
+
+// reserve takes the tokens for an insert of size bytes, and returns how long
+// the caller must wait before inserting.  Tokens are taken immediately, so
+// waiting callers are served in order.
+func (s *Scheduler) reserve(size int) time.Duration {
+	s.lock.Lock()
+	defer s.lock.Unlock()
+	s.refill(s.now())
+	s.bytes -= float64(size)
+	s.reqs--
+	wait := 0.0
+	if s.bytes < 0 {
+		wait = -s.bytes / s.bytesPerSec
+	}
+	if s.reqs < 0 && -s.reqs/s.reqsPerSec > wait {
+		wait = -s.reqs / s.reqsPerSec
+	}
+	return time.Duration(wait * float64(time.Second))
+}
+
+// Wait blocks until an insert of size bytes is allowed, or ctx is done.
+func (s *Scheduler) Wait(ctx context.Context, size int) error {
+	wait := s.reserve(size)
+	if wait <= 0 {
+		return nil
+	}
+	metrics.WorkerState.WithLabelValues("bq", "throttled").Inc()
+	defer metrics.WorkerState.WithLabelValues("bq", "throttled").Dec()
+	t := time.NewTimer(wait)
+	defer t.Stop()
+	select {
+	case <-t.C:
+		return nil
+	case <-ctx.Done():
+		return ctx.Err()
+	}
+}
+
+// QuotaExceeded reduces the rates multiplicatively.
+func (s *Scheduler) QuotaExceeded() {
+	s.lock.Lock()
+	defer s.lock.Unlock()
+	now := s.now()
+	if now.Sub(s.lastDecrease) < minDecreaseInterval {
+		return
+	}
+	s.lastDecrease = now
+	s.refill(now)
+	s.bytesPerSec *= s.config.Decrease
+	if s.bytesPerSec < s.config.MinBytesPerSec {
+		s.bytesPerSec = s.config.MinBytesPerSec
+	}
+	s.reqsPerSec *= s.config.Decrease
+	if s.reqsPerSec < s.config.MinReqsPerSec {
+		s.reqsPerSec = s.config.MinReqsPerSec
+	}
+	// Discard any accumulated burst allowance.
+	if s.bytes > 0 {
+		s.bytes = 0
+	}
+	if s.reqs > 0 {
+		s.reqs = 0
+	}
+}
+
+// Succeeded increases the rates additively, if the insert was not slow.
+func (s *Scheduler) Succeeded(latency time.Duration) {
+	if latency > s.config.SlowInsert {
+		return
+	}
+	s.lock.Lock()
+	defer s.lock.Unlock()
+	s.bytesPerSec += s.config.BytesIncrease
+	if s.bytesPerSec > s.config.MaxBytesPerSec {
+		s.bytesPerSec = s.config.MaxBytesPerSec
+	}
+	s.reqsPerSec += s.config.ReqsIncrease
+	if s.reqsPerSec > s.config.MaxReqsPerSec {
+		s.reqsPerSec = s.config.MaxReqsPerSec
+	}
+}
+
+// Rates returns the current bytes and requests per second.
+func (s *Scheduler) Rates() (float64, float64) {
+	s.lock.Lock()
+	defer s.lock.Unlock()
+	return s.bytesPerSec, s.reqsPerSec
+}
@@ -0,0 +1,127 @@
+package bq
+
+import (
+	"context"
+	"errors"
+	"testing"
+	"time"
+
+	"github.com/m-lab/etl/etl"
+)
+
+func TestScheduler(t *testing.T) {
+	now := time.Date(2020, 1, 1, 0, 0, 0, 0, time.UTC)
+	config := SchedulerConfig{
+		MinBytesPerSec: 100, MaxBytesPerSec: 2000,
+		MinReqsPerSec: 1, MaxReqsPerSec: 20,
+		Decrease:      0.5,
+		BytesIncrease: 100, ReqsIncrease: 1,
+		SlowInsert: time.Second,
+	}
+	s := NewScheduler(config)
+	s.now = func() time.Time { return now }
+	s.last = now
+
+	// Starts at half the maximum, with one second of tokens.
+	if b, r := s.Rates(); b != 1000 || r != 10 {
+		t.Fatal("Bad initial rates", b, r)
+	}
+	if wait := s.reserve(1000); wait != 0 {
+		t.Error("Expected no wait:", wait)
+	}
+	// Bucket is empty, so 500 bytes requires half a second.
+	if wait := s.reserve(500); wait != 500*time.Millisecond {
+		t.Error("Expected 500 msec wait:", wait)
+	}
+	// After the wait, the next request must wait for its own tokens too.
+	now = now.Add(500 * time.Millisecond)
+	if wait := s.reserve(100); wait != 100*time.Millisecond {
+		t.Error("Expected 100 msec wait:", wait)
+	}
+
+	// Quota errors decrease multiplicatively, but at most once per interval.
+	s.QuotaExceeded()
+	s.QuotaExceeded()
+	if b, r := s.Rates(); b != 500 || r != 5 {
+		t.Error("Bad rates after quota error", b, r)
+	}
+	now = now.Add(minDecreaseInterval)
+	for i := 0; i < 10; i++ {
+		s.QuotaExceeded()
+		now = now.Add(minDecreaseInterval)
+	}
+	if b, r := s.Rates(); b != config.MinBytesPerSec || r != config.MinReqsPerSec {
+		t.Error("Rates should not go below minimum", b, r)
+	}
+
+	// Fast successes increase additively, slow ones do not.
+	s.Succeeded(10 * time.Millisecond)
+	s.Succeeded(2 * time.Second)
+	if b, r := s.Rates(); b != 200 || r != 2 {
+		t.Error("Bad rates after success", b, r)
+	}
+	for i := 0; i < 100; i++ {
+		s.Succeeded(0)
+	}
+	if b, r := s.Rates(); b != config.MaxBytesPerSec || r != config.MaxReqsPerSec {
+		t.Error("Rates should not exceed maximum", b, r)
+	}
+}
+
+func TestSchedulerWaitCanceled(t *testing.T) {
+	s := NewScheduler(SchedulerConfig{MinBytesPerSec: 1, MaxBytesPerSec: 2, MinReqsPerSec: 1, MaxReqsPerSec: 2})
+	ctx, cancel := context.WithCancel(context.Background())
+	cancel()
+	if err := s.Wait(ctx, 1000); err != context.Canceled {
+		t.Error("Expected context.Canceled:", err)
+	}
+}
+
+// quotaUploader returns quota errors until a deadline.
+type quotaUploader struct {
+	until time.Time
+	calls int
+	rows  int
+}
+
+func (u *quotaUploader) Put(ctx context.Context, src interface{}) error {
+	u.calls++
+	if time.Now().Before(u.until) {
+		return errors.New("Quota exceeded: too many requests")
+	}
+	u.rows += len(src.([]interface{}))
+	return nil
+}
+
+func TestScheduledSinkQuotaRetry(t *testing.T) {
+	// The scheduler allows every retry immediately, so only the backoff
+	// spaces them out.
+	sched := NewScheduler(SchedulerConfig{
+		MinBytesPerSec: 1e9, MaxBytesPerSec: 2e9,
+		MinReqsPerSec: 1e6, MaxReqsPerSec: 2e6,
+		Decrease: 0.5,
+	})
+	u := &quotaUploader{until: time.Now().Add(200 * time.Millisecond)}
+	s := newScheduledSink(u, sched).(*sink)
+	n, err := s.Commit([]interface{}{1, 2}, "test")
+	if err != nil || n != 2 || u.rows != 2 {
+		t.Errorf("Commit() = %d, %v, with %d rows uploaded after %d calls, want 2 rows", n, err, u.rows, u.calls)
+	}
+	if s.badRows != 0 {
+		t.Error("Rows dropped:", s.badRows)
+	}
+}
+
+func TestNewSinkFactoryPacing(t *testing.T) {
+	defer func(mbps int) { etl.InsertMaxMBPerSec = mbps }(etl.InsertMaxMBPerSec)
+
+	etl.InsertMaxMBPerSec = 0
+	if sched := NewSinkFactory().(*bqSinkFactory).sched; sched != nil {
+		t.Error("Inserts paced by default")
+	}
+	etl.InsertMaxMBPerSec = 20
+	sched := NewSinkFactory().(*bqSinkFactory).sched
+	if sched == nil || sched.config.MaxBytesPerSec != 20e6 {
+		t.Errorf("Scheduler = %+v, want MaxBytesPerSec 20e6", sched)
+	}
+}
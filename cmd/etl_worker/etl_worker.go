@@ -11,6 +11,7 @@ import (
 	"os"
 	"runtime"
 	"strconv"
+	"strings"
 	"sync/atomic"
 	"time"
 
@@ -27,6 +28,7 @@ import (
 	"github.com/m-lab/etl/etl"
 	"github.com/m-lab/etl/factory"
 	"github.com/m-lab/etl/metrics"
+	"github.com/m-lab/etl/parser"
 	"github.com/m-lab/etl/storage"
 	"github.com/m-lab/etl/task"
 	"github.com/m-lab/etl/worker"
@@ -56,8 +58,15 @@ var (
 		Options: []string{"gcs", "bigquery", "local"},
 		Value:   "bigquery",
 	}
+	outputFormat = flagx.Enum{
+		Options: []string{string(storage.JSONL), string(storage.Avro)},
+		Value:   string(storage.JSONL),
+	}
 
 	maxActiveTasks = flag.Int64("max_active", 1, "Maximum number of active tasks")
+	maxActiveMB    = flag.Int64("max_active_mb", 0, "If non-zero, admit tasks by their estimated memory, in MB, instead of max_active")
+	maxHeapMB      = flag.Int64("max_heap_mb", 0, "If non-zero with max_active_mb, admit no new tasks while the live heap is larger")
+	memExpansion   = flag.String("memory_expansion", "", "Comma separated datatype=factor overrides of the peak memory per archive byte, for max_active_mb")
 	gardenerHost   = flag.String("gardener_host", "", "Gardener host for jobs")
 
 	servicePort     = flag.String("service_port", ":8080", "The main (private) service port")
@@ -69,6 +78,14 @@ var (
 	bigqueryProject = flag.String("bigquery_project", "", "Override GCLOUD_PROJECT for BigQuery operations")
 	bigqueryDataset = flag.String("bigquery_dataset", "", "Override the BigQuery dataset for output tables")
 	outputDir       = flag.String("output_dir", "", "If output type is 'local', write output to this directory")
+	prefetchTests   = flag.Int("prefetch_tests", 0, "Number of tests to read ahead of parsing in each task; 0 for serial processing")
+	parseWorkers    = flag.Int("parse_workers", 1, "Parsing goroutines per task for order independent parsers, when prefetching")
+	archiveSplits   = flag.Int("archive_splits", 1, "Byte ranges of indexed archives read concurrently per task, with multiple parse workers")
+	readAheadRanges = flag.Int("read_ahead_ranges", 0, "Ranged reads of each archive run concurrently ahead of parsing; 0 for a single stream")
+	readChunkMB     = flag.Int64("read_chunk_mb", 8, "Size of each read ahead range, in MB")
+	maxBufferMB     = flag.Int("max_buffer_mb", 0, "If non-zero, flush NDT row buffers early when they hold this many MB")
+	insertMaxMBps   = flag.Int("bq_max_mb_per_sec", 0, "If non-zero, pace BigQuery inserts to at most this many MB/sec, backing off on quota errors; 0 for no pacing")
+	processedIndex  = flag.String("processed_index", "", "If set, a gs://bucket/prefix recording processed archives, which gardener jobs then skip.  Only used for gcs output")
 	annotatorURL    = flagx.MustNewURL("https://annotator-dot-mlab-sandbox.appspot.com")
 )
 
@@ -86,6 +103,7 @@ func init() {
 	log.SetFlags(log.LstdFlags | log.Lshortfile)
 
 	flag.Var(&outputType, "output", "Output to bigquery or gcs.")
+	flag.Var(&outputFormat, "output_format", "File format for gcs or local output.")
 	flag.Var(&annotatorURL, "annotator_url", "Base URL for the annotation service.")
 }
 
@@ -126,6 +144,7 @@ func Status(w http.ResponseWriter, r *http.Request) {
 		fmt.Fprintf(w, "Writing output to %s\n", outputBucket())
 	}
 	fmt.Fprintf(w, "<p>Workers: %d / %d</p>\n", atomic.LoadInt32(&inFlight), maxInFlight)
+	metrics.WriteTaskStages(w)
 	env := os.Environ()
 	for i := range env {
 		fmt.Fprintf(w, "%s</br>\n", env[i])
@@ -310,14 +329,26 @@ func (r *runnable) Run(ctx context.Context) error {
 	log.Println("Processing", path)
 
 	statusCode := http.StatusOK
-	pErr := worker.ProcessGKETask(ctx, dp, r.tf)
+	complete, pErr := worker.ProcessGKETaskComplete(ctx, dp, r.tf)
 	if pErr != nil {
 		statusCode = pErr.Code()
 	}
 	metrics.DurationHistogram.WithLabelValues(
 		dp.DataType, http.StatusText(statusCode)).Observe(
 		time.Since(start).Seconds())
-	return err
+	if pErr != nil {
+		return pErr
+	}
+	// Archives with any failed rows or dropped tests are left unrecorded, so
+	// that reprocessing can repair them.
+	if gardenerAPI != nil && !complete {
+		log.Println("Not recording incomplete", path, "in processing index")
+	} else if gardenerAPI != nil {
+		if err := gardenerAPI.MarkProcessed(ctx, &r.ObjectAttrs); err != nil {
+			log.Println("Recording", path, "in processing index:", err)
+		}
+	}
+	return nil
 }
 
 func (r *runnable) Info() string {
@@ -329,6 +360,24 @@ func outputBucket() string {
 	return "etl-" + *gcloudProject
 }
 
+// outputTarget identifies the gcs output destination, for the processing
+// index.
+func outputTarget() string {
+	return "gs://" + outputBucket() + "/" + outputFormat.Value
+}
+
+// mustProcessedIndex creates the processing index at a gs://bucket/prefix.
+func mustProcessedIndex(uri string) active.ProcessedIndex {
+	u, err := url.Parse(uri)
+	rtx.Must(err, "Invalid processed_index: "+uri)
+	if u.Scheme != "gs" || u.Host == "" {
+		log.Fatal("processed_index should be gs://bucket/prefix: ", uri)
+	}
+	c, err := storage.GetStorageClient(true)
+	rtx.Must(err, "Failed to create storage client for processed index")
+	return active.NewGCSIndex(c, u.Host, strings.TrimPrefix(u.Path, "/"))
+}
+
 func toRunnable(obj *gcs.ObjectAttrs) active.Runnable {
 	c, err := storage.GetStorageClient(false)
 	if err != nil {
@@ -340,9 +389,9 @@ func toRunnable(obj *gcs.ObjectAttrs) active.Runnable {
 	case "bigquery":
 		sink = bq.NewSinkFactory()
 	case "gcs":
-		sink = storage.NewSinkFactory(c, outputBucket())
+		sink = storage.NewSinkFactory(c, outputBucket(), storage.Format(outputFormat.Value))
 	case "local":
-		sink = storage.NewLocalFactory(*outputDir)
+		sink = storage.NewLocalFactory(*outputDir, storage.Format(outputFormat.Value))
 	}
 
 	taskFactory := worker.StandardTaskFactory{
@@ -353,6 +402,31 @@ func toRunnable(obj *gcs.ObjectAttrs) active.Runnable {
 	return &runnable{&taskFactory, *obj}
 }
 
+// taskWeight estimates the peak memory of a task, in bytes, from the archive
+// size and data type.
+func taskWeight(r active.Runnable) int64 {
+	rr, ok := r.(*runnable)
+	if !ok {
+		return 1
+	}
+	dt := etl.INVALID
+	dp, err := etl.ValidateTestPath(fmt.Sprintf("gs://%s/%s", rr.Bucket, rr.Name))
+	if err == nil {
+		dt = dp.GetDataType()
+	}
+	return int64(float64(rr.Size) * dt.MemoryExpansion())
+}
+
+// taskTokens returns the TokenSource that admits tasks.
+func taskTokens() active.TokenSource {
+	if *maxActiveMB <= 0 {
+		return active.NewWSTokenSource(int(*maxActiveTasks))
+	}
+	tokens := active.NewWeightedTokenSource(*maxActiveMB<<20, taskWeight)
+	tokens.SetHeapLimit(uint64(*maxHeapMB) << 20)
+	return tokens
+}
+
 func mustGardenerAPI(ctx context.Context, jobServer string) *active.GardenerAPI {
 	rawBase := fmt.Sprintf("http://%s:8080", jobServer)
 	base, err := url.Parse(rawBase)
@@ -419,15 +493,31 @@ func main() {
 	etl.OmitDeltas = *omitDeltas
 	etl.GCloudProject = *gcloudProject
 	etl.BigqueryProject = *bigqueryProject
+	rtx.Must(etl.SetMemoryExpansion(*memExpansion), "Invalid -memory_expansion")
 	etl.BigqueryDataset = *bigqueryDataset
 	etl.BatchAnnotatorURL = annotatorURL.String() + "/batch_annotate"
+	etl.PrefetchTests = *prefetchTests
+	etl.ParseWorkers = *parseWorkers
+	etl.ArchiveSplits = *archiveSplits
+	etl.ReadAheadRanges = *readAheadRanges
+	etl.ReadChunkSize = *readChunkMB * 1024 * 1024
+	etl.MaxBufferBytes = *maxBufferMB * 1024 * 1024
+	etl.InsertMaxMBPerSec = *insertMaxMBps
 
 	if len(*gardenerHost) > 0 {
 		log.Println("Using", *gardenerHost)
 		minPollingInterval := 10 * time.Second
 		gardenerAPI = mustGardenerAPI(mainCtx, *gardenerHost)
+		// Gardener rebuilds each day of BigQuery output from scratch, in a
+		// temporary partition that replaces the final one, so skipping any
+		// archives would lose their rows.  Only appended GCS output can skip.
+		if *processedIndex != "" && outputType.Value == "gcs" {
+			gardenerAPI.UseIndex(mustProcessedIndex(*processedIndex), parser.Version(), outputTarget())
+		} else if *processedIndex != "" {
+			log.Println("Ignoring processed_index for", outputType.Value, "output")
+		}
 		// Note that this does not currently track duration metric.
-		go gardenerAPI.Poll(mainCtx, toRunnable, (int)(*maxActiveTasks), minPollingInterval)
+		go gardenerAPI.PollWithTokens(mainCtx, toRunnable, taskTokens(), minPollingInterval)
 	} else {
 		log.Println("GARDENER_HOST not specified or empty.  Running in passive mode.")
 	}
@@ -3,19 +3,30 @@
 package main
 
 import (
+	"archive/tar"
+	"bytes"
 	"context"
 	"encoding/json"
+	"errors"
 	"flag"
 	"io/ioutil"
 	"log"
 	"net/http"
+	"net/url"
 	"os"
 	"path/filepath"
 	"strings"
 	"testing"
 	"time"
 
+	"cloud.google.com/go/bigquery"
+	gcs "cloud.google.com/go/storage"
+
+	"github.com/m-lab/etl/active"
 	"github.com/m-lab/etl/etl"
+	"github.com/m-lab/etl/parser"
+	"github.com/m-lab/etl/storage"
+	"github.com/m-lab/etl/task"
 )
 
 func init() {
@@ -207,3 +218,70 @@ func TestLocalRequest(t *testing.T) {
 		})
 	}
 }
+
+// closeFailParser accepts every test, and inserts nothing.
+type closeFailParser struct {
+	parser.FakeRowStats
+}
+
+func (p *closeFailParser) IsParsable(testName string, test []byte) (string, bool) {
+	return "test", true
+}
+func (p *closeFailParser) ParseAndInsert(meta map[string]bigquery.Value, testName string, test []byte) error {
+	return nil
+}
+func (p *closeFailParser) Flush() error          { return nil }
+func (p *closeFailParser) TableName() string     { return "test" }
+func (p *closeFailParser) FullTableName() string { return "test" }
+func (p *closeFailParser) TaskError() error      { return nil }
+
+type failingCloser struct{}
+
+func (failingCloser) Close() error { return errors.New("upload failed") }
+
+// closeFailFactory creates tasks for a one file archive, whose sink fails
+// to close.
+type closeFailFactory struct{}
+
+func (closeFailFactory) Get(ctx context.Context, dp etl.DataPath) (*task.Task, etl.ProcessingError) {
+	b := new(bytes.Buffer)
+	tw := tar.NewWriter(b)
+	tw.WriteHeader(&tar.Header{Name: "foo", Mode: 0666, Typeflag: tar.TypeReg, Size: 8})
+	tw.Write([]byte("biscuits"))
+	tw.Close()
+	src := &storage.GCSSource{TarReader: tar.NewReader(b), Closer: ioutil.NopCloser(nil), RetryBaseTime: time.Millisecond}
+	return task.NewTask(dp.URI, src, &closeFailParser{}, failingCloser{}), nil
+}
+
+type recordingIndex struct {
+	marked []active.IndexKey
+}
+
+func (idx *recordingIndex) Processed(ctx context.Context, keys []active.IndexKey) (map[active.IndexKey]bool, error) {
+	return map[active.IndexKey]bool{}, nil
+}
+
+func (idx *recordingIndex) MarkProcessed(ctx context.Context, key active.IndexKey) error {
+	idx.marked = append(idx.marked, key)
+	return nil
+}
+
+// An archive whose output fails to close must not be recorded as processed.
+func TestRunCloseError(t *testing.T) {
+	saved := gardenerAPI
+	defer func() { gardenerAPI = saved }()
+	idx := &recordingIndex{}
+	gardenerAPI = active.NewGardenerAPI(url.URL{}, nil)
+	gardenerAPI.UseIndex(idx, "v1", "gs://etl-mlab-testing/json")
+
+	r := &runnable{tf: closeFailFactory{}, ObjectAttrs: gcs.ObjectAttrs{
+		Bucket: "archive-mlab-testing",
+		Name:   "ndt/ndt5/2019/12/01/20191201T020011.395772Z-ndt5-mlab1-bcn01-ndt.tgz",
+	}}
+	if err := r.Run(context.Background()); err == nil {
+		t.Error("Run() = nil, want close error")
+	}
+	if len(idx.marked) != 0 {
+		t.Errorf("MarkProcessed() recorded %v, want nothing", idx.marked)
+	}
+}
@@ -0,0 +1,97 @@
+// index_archive writes the sidecar index of each archive, listing the
+// offsets at which byte ranges of the archive can be read concurrently.
+// See storage.GCSSource.Split, and the etl_worker -archive_splits flag.
+package main
+
+// Archives may be uncompressed tar files, or block gzipped tar files, with
+// gzip members that start at tar headers.  Archives that are a single gzip
+// stream cannot be split, so no index is written for them.
+//
+// example:
+//   go run ./cmd/index_archive -range_mb=32 gs://archive-mlab-sandbox/ndt/tcpinfo/2019/05/16/20190516T013026.744845Z-tcpinfo-mlab4-arn02-ndt.tar
+import (
+	"context"
+	"errors"
+	"flag"
+	"log"
+	"strings"
+
+	gcs "cloud.google.com/go/storage"
+
+	"github.com/m-lab/go/flagx"
+	"github.com/m-lab/go/rtx"
+
+	"github.com/m-lab/etl/storage"
+)
+
+var (
+	rangeMB = flag.Int64("range_mb", 64, "Minimum size of each indexed range of an archive, in MB")
+)
+
+// indexArchive reads the archive at uri, and writes its index.
+func indexArchive(ctx context.Context, client *gcs.Client, uri string) error {
+	path := strings.TrimPrefix(uri, "gs://")
+	parts := strings.SplitN(path, "/", 2)
+	if path == uri || len(parts) != 2 || parts[1] == "" {
+		return errors.New("not a gs://bucket/object URI: " + uri)
+	}
+	bucket, name := parts[0], parts[1]
+
+	rdr, err := client.Bucket(bucket).Object(name).NewReader(ctx)
+	if err != nil {
+		return err
+	}
+	defer rdr.Close()
+	var offsets []int64
+	switch {
+	case strings.HasSuffix(strings.ToLower(name), "gz"):
+		offsets, err = storage.IndexGzipTar(rdr, *rangeMB<<20)
+	case strings.HasSuffix(name, ".tar"):
+		offsets, err = storage.IndexTar(rdr, *rangeMB<<20)
+	default:
+		return errors.New("not tar or tgz: " + uri)
+	}
+	if err != nil {
+		return err
+	}
+	if len(offsets) < 2 {
+		log.Println("No split points in", uri)
+		return nil
+	}
+
+	w := client.Bucket(bucket).Object(name + storage.IndexSuffix).NewWriter(ctx)
+	w.ContentType = "text/plain"
+	if err := storage.WriteIndex(w, offsets); err != nil {
+		w.Close()
+		return err
+	}
+	if err := w.Close(); err != nil {
+		return err
+	}
+	log.Println("Wrote", len(offsets), "offsets for", uri)
+	return nil
+}
+
+func main() {
+	flag.Parse()
+	rtx.Must(flagx.ArgsFromEnv(flag.CommandLine), "Could not get args from env")
+	if flag.NArg() == 0 {
+		log.Fatal("Usage: index_archive [-range_mb=N] gs://bucket/archive.tar ...")
+	}
+
+	ctx := context.Background()
+	client, err := gcs.NewClient(ctx)
+	rtx.Must(err, "Could not create storage client")
+	defer client.Close()
+
+	failed := 0
+	for _, uri := range flag.Args() {
+		if err := indexArchive(ctx, client, uri); err != nil {
+			log.Println(uri, err)
+			failed++
+		}
+	}
+	if failed > 0 {
+		log.Fatal(failed, " archives were not indexed")
+	}
+}
@@ -135,6 +135,29 @@ type Parser interface {
 	RowStats // Parser must implement RowStats
 }
 
+// DataRetainer is an optional Parser interface, for parsers that keep
+// references to the test data passed to ParseAndInsert after it returns,
+// e.g. to process groups of related files together.  Data passed to such a
+// parser is never released to the TestSource.
+type DataRetainer interface {
+	RetainsData() bool
+}
+
+// OrderIndependent is an optional Parser interface.  Parsers that return
+// true may have ParseAndInsert called concurrently, with tests in any order.
+// Other parsers receive tests sequentially, in archive order.
+type OrderIndependent interface {
+	OrderIndependent() bool
+}
+
+// Forker is an optional interface for OrderIndependent Parsers.  Fork
+// returns a new Parser for use by another goroutine.  The new Parser has its
+// own row buffer, but shares the row.Sink and the row stats of the original,
+// so the original reports the merged stats.  Each fork must be flushed.
+type Forker interface {
+	Fork() Parser
+}
+
 // TestSource provides a source of test data.
 type TestSource interface {
 	// NextTest reads the next test object from the tar file.
@@ -142,6 +165,10 @@ type TestSource interface {
 	// and storage.ErrOversizeFile.
 	// Returns io.EOF when there are no more tests.
 	NextTest(maxSize int64) (string, []byte, error)
+	// Release returns data obtained from NextTest to the source, so that the
+	// buffer may be reused.  The caller must not access data afterwards.
+	// Calling Release is optional.
+	Release(data []byte)
 	Close() error
 
 	Detail() string   // Detail for logs.
@@ -149,6 +176,16 @@ type TestSource interface {
 	Date() civil.Date // Date associated with test source
 }
 
+// Splitter is an optional TestSource interface, for sources that can read
+// separate portions of an archive concurrently.  Split arranges for up to n
+// portions to be read, and returns the number of portions, which is 1 if
+// the archive cannot be split.  Afterwards, NextTest returns tests in no
+// particular order, so Split should only be used with OrderIndependent
+// parsers.  Split must be called before the first call to NextTest.
+type Splitter interface {
+	Split(n int) int
+}
+
 //========================================================================
 // Interface to allow fakes.
 //========================================================================
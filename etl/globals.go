@@ -7,6 +7,7 @@ import (
 	"log"
 	"net"
 	"regexp"
+	"strconv"
 	"strings"
 )
 
@@ -29,6 +30,36 @@ var (
 
 	// BatchAnnotatorURL provides the base URL for batch annotation requests.
 	BatchAnnotatorURL string
+
+	// PrefetchTests is the number of tests each Task reads ahead of parsing.
+	// Zero means tests are read and parsed serially.
+	PrefetchTests int
+
+	// ParseWorkers is the number of goroutines each Task uses for parsing
+	// with order independent parsers, when PrefetchTests is non-zero.
+	ParseWorkers int
+
+	// ArchiveSplits is the number of byte ranges of an indexed archive that
+	// each Task reads concurrently, when parsing with multiple ParseWorkers.
+	ArchiveSplits int
+
+	// ReadAheadRanges is the number of ranged reads of ReadChunkSize bytes
+	// each Task runs concurrently, ahead of reading an archive.  Zero means
+	// each archive is read with a single stream.
+	ReadAheadRanges int
+
+	// ReadChunkSize is the size of each read ahead range, in bytes.
+	ReadChunkSize int64
+
+	// MaxBufferBytes limits the estimated bytes held in each row buffer of
+	// parsers that track row sizes, currently NDT.  When a new row would
+	// exceed it, the buffer is flushed early.  Zero means no limit.
+	MaxBufferBytes int
+
+	// InsertMaxMBPerSec, if non-zero, paces the BigQuery inserts of all
+	// tasks to at most this many MB/sec, backing off on quota errors.  Zero
+	// means inserts are not paced.
+	InsertMaxMBPerSec int
 )
 
 var (
@@ -311,8 +342,67 @@ var (
 	}
 	// There is also a mapping of data types to queue names in
 	// queue_pusher.go
+
+	// Map from data type to the approximate peak worker memory, per byte of
+	// compressed archive, for admission control.  These are conservative
+	// starting points, from the typical compression ratio of each datatype's
+	// archives, and the rows buffered while parsing them.  They should be
+	// tuned with the peak-rss-kB of the parser task benchmarks, and may be
+	// overridden with SetMemoryExpansion, e.g. by the etl_worker
+	// -memory_expansion flag.
+	dataTypeToMemoryExpansion = map[DataType]float64{
+		ANNOTATION: 4,
+		NDT:        6, // web100 snaplogs, with many rows buffered.
+		TCPINFO:    8, // zstd compressed snapshots.
+		SS:         5,
+		PT:         6,
+		SW:         4,
+		NDT5:       4,
+		NDT7:       4,
+	}
 )
 
+// defaultMemoryExpansion is used for data types without a specific factor.
+const defaultMemoryExpansion = 6
+
+// MemoryExpansion returns the approximate peak memory used to process an
+// archive of this data type, per byte of archive.
+func (dt DataType) MemoryExpansion() float64 {
+	if f, ok := dataTypeToMemoryExpansion[dt]; ok {
+		return f
+	}
+	return defaultMemoryExpansion
+}
+
+// SetMemoryExpansion overrides the MemoryExpansion factors of some data
+// types, from a comma separated list of datatype=factor, e.g.
+// "ndt=8,tcpinfo=10".  It must be called before any tasks are admitted.
+func SetMemoryExpansion(spec string) error {
+	if spec == "" {
+		return nil
+	}
+	factors := map[DataType]float64{}
+	for _, kv := range strings.Split(spec, ",") {
+		parts := strings.SplitN(kv, "=", 2)
+		if len(parts) != 2 {
+			return fmt.Errorf("bad memory expansion %q: want datatype=factor", kv)
+		}
+		dt := DataType(strings.TrimSpace(parts[0]))
+		if _, ok := dataTypeToTable[dt]; !ok || dt == INVALID {
+			return fmt.Errorf("bad memory expansion %q: unknown datatype", kv)
+		}
+		f, err := strconv.ParseFloat(strings.TrimSpace(parts[1]), 64)
+		if err != nil || f <= 0 {
+			return fmt.Errorf("bad memory expansion %q: want a positive factor", kv)
+		}
+		factors[dt] = f
+	}
+	for dt, f := range factors {
+		dataTypeToMemoryExpansion[dt] = f
+	}
+	return nil
+}
+
 /*******************************************************************************
 *  TODO: These methods to compute the appropriate project and dataset are ugly.
 *  In not to distant future we need a better solution.
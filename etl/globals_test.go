@@ -358,3 +358,24 @@ func TestDirToTablename(t *testing.T) {
 		t.Errorf("DirToTablename() failed to translate PT dir name correctly.")
 	}
 }
+
+func TestSetMemoryExpansion(t *testing.T) {
+	ndt, pt := etl.NDT.MemoryExpansion(), etl.PT.MemoryExpansion()
+	defer etl.SetMemoryExpansion(fmt.Sprintf("ndt=%v,traceroute=%v", ndt, pt))
+
+	for _, bad := range []string{"ndt", "ndt=0", "ndt=x", "foobar=2", "invalid=2", "ndt=2,foobar=3"} {
+		if err := etl.SetMemoryExpansion(bad); err == nil {
+			t.Errorf("SetMemoryExpansion(%q) should fail", bad)
+		}
+	}
+	// Failures have no effect.
+	if etl.NDT.MemoryExpansion() != ndt {
+		t.Error("NDT changed by a bad spec:", etl.NDT.MemoryExpansion())
+	}
+	if err := etl.SetMemoryExpansion("ndt=12.5, traceroute = 3"); err != nil {
+		t.Fatal(err)
+	}
+	if etl.NDT.MemoryExpansion() != 12.5 || etl.PT.MemoryExpansion() != 3 {
+		t.Error("Bad expansion:", etl.NDT.MemoryExpansion(), etl.PT.MemoryExpansion())
+	}
+}
@@ -59,7 +59,7 @@ type defaultAnnotatorFactory struct{}
 
 // Get implements AnnotatorFactory.Get
 func (ann *defaultAnnotatorFactory) Get(ctx context.Context, dp etl.DataPath) (v2.Annotator, etl.ProcessingError) {
-	return v2.GetAnnotator(etl.BatchAnnotatorURL), nil
+	return row.CachingAnnotator(etl.BatchAnnotatorURL), nil
 }
 
 // DefaultAnnotatorFactory returns the annotation service annotator.
@@ -97,6 +97,18 @@ var (
 			Help: "The current number of errors encountered while attempting to add annotation data.",
 		}, []string{"source"})
 
+	// AnnotationCacheCount counts IPs found in, or missing from, the
+	// annotation cache.
+	// Provides metrics:
+	//    etl_annotator_Cache_Count
+	// Example usage:
+	//    metrics.AnnotationCacheCount.WithLabelValues("ndt", "hit").Add(n)
+	AnnotationCacheCount = promauto.NewCounterVec(
+		prometheus.CounterOpts{
+			Name: "etl_annotator_Cache_Count",
+			Help: "The number of IPs annotated from the cache (hit), or requested from the annotation service (miss).",
+		}, []string{"test_type", "result"})
+
 	// AnnotationWarningCount measures the number of annotation warnings
 	// Provides metrics:
 	//    etl_annotator_Warning_Count
@@ -415,6 +427,27 @@ var (
 		[]string{"table"},
 	)
 
+	// HeldBytesHistogram provides a histogram of the estimated bytes of test
+	// data and rows held by a parser, e.g. by each NDT test group, and by
+	// each buffer of rows when it is flushed.
+	//
+	// Provides metrics:
+	//   etl_held_bytes_bucket{table="...", holder="...", le="..."}
+	//   ...
+	//   etl_held_bytes_sum{table="...", holder="..."}
+	//   etl_held_bytes_count{table="...", holder="..."}
+	// Usage example:
+	//   metrics.HeldBytesHistogram.WithLabelValues(
+	//           "ndt", "group").Observe(bytes)
+	HeldBytesHistogram = promauto.NewHistogramVec(
+		prometheus.HistogramOpts{
+			Name:    "etl_held_bytes",
+			Help:    "Bytes held by parser groups and buffers.",
+			Buckets: prometheus.ExponentialBuckets(1000, 2, 20), // 1kB to about 500MB.
+		},
+		[]string{"table", "holder"},
+	)
+
 	// TODO(dev): fields/row - generalize this metric for any file type.
 	//
 	// DeltaNumFieldsHistogram provides a histogram of snapshot delta field counts.  It is intended primarily for
@@ -1,11 +1,14 @@
 package metrics_test
 
 import (
+	"bytes"
 	"errors"
 	"fmt"
 	"log"
 	"runtime/debug"
+	"strings"
 	"testing"
+	"time"
 
 	"github.com/m-lab/etl/metrics"
 	"github.com/m-lab/go/prometheusx/promtest"
@@ -89,6 +92,7 @@ func TestMetrics(t *testing.T) {
 	metrics.FileCount.WithLabelValues("x", "x")
 	metrics.FileSizeHistogram.WithLabelValues("x", "x", "x")
 	metrics.GCSRetryCount.WithLabelValues("x", "x", "x", "x")
+	metrics.HeldBytesHistogram.WithLabelValues("x", "x")
 	metrics.InsertionHistogram.WithLabelValues("x", "x")
 	metrics.PanicCount.WithLabelValues("x")
 	metrics.PTBitsAwayFromDestV4.WithLabelValues("x")
@@ -99,6 +103,9 @@ func TestMetrics(t *testing.T) {
 	metrics.PTPollutedCount.WithLabelValues("x")
 	metrics.PTTestCount.WithLabelValues("x")
 	metrics.RowSizeHistogram.WithLabelValues("x")
+	metrics.StageBytesRate.WithLabelValues("x", "x")
+	metrics.StageDuration.WithLabelValues("x", "x")
+	metrics.StageRowsRate.WithLabelValues("x", "x")
 	metrics.TaskCount.WithLabelValues("x", "x")
 	metrics.TestCount.WithLabelValues("x", "x", "x")
 	metrics.WarningCount.WithLabelValues("x", "x", "x")
@@ -108,3 +115,37 @@ func TestMetrics(t *testing.T) {
 		t.Log("There are lint errors in the prometheus metrics.")
 	}
 }
+
+func TestTaskStages(t *testing.T) {
+	ts := metrics.NewTaskStages("gs://bucket/archive.tgz", "ndt7")
+	ts.Start()
+	start := time.Now().Add(-time.Second)
+	ts.Observe("ndt7", metrics.StageRead, start, 2000000, 0)
+	ts.Observe("ndt7", metrics.StageCommit, start, 0, 500)
+
+	// A nil TaskStages only records the metrics.
+	var none *metrics.TaskStages
+	none.Observe("ndt7", metrics.StageParse, start, 100, 0)
+
+	status := func() string {
+		buf := &bytes.Buffer{}
+		metrics.WriteTaskStages(buf)
+		return buf.String()
+	}
+	s := status()
+	active := s[:strings.Index(s, "Recently finished")]
+	if !strings.Contains(active, "gs://bucket/archive.tgz") {
+		t.Error("Missing active task", s)
+	}
+	if !strings.Contains(s, "1 in 1.0s, 2.0 MB/s") || !strings.Contains(s, "500 rows/s") {
+		t.Error("Missing stage totals", s)
+	}
+
+	ts.Finish()
+	s = status()
+	active = s[:strings.Index(s, "Recently finished")]
+	if strings.Contains(active, "gs://bucket/archive.tgz") ||
+		!strings.Contains(s, "gs://bucket/archive.tgz") {
+		t.Error("Task should be finished", s)
+	}
+}
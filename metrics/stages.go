@@ -0,0 +1,237 @@
+package metrics
+
+import (
+	"fmt"
+	"html"
+	"io"
+	"math"
+	"sort"
+	"sync"
+	"time"
+
+	"github.com/prometheus/client_golang/prometheus"
+	"github.com/prometheus/client_golang/prometheus/promauto"
+)
+
+// Stages of task processing, used as the stage label of the stage metrics.
+const (
+	StageRead     = "read"     // Reading each test from the archive.
+	StageInflate  = "inflate"  // Decompressing a gzip or zstd test file.
+	StageParse    = "parse"    // Parser.ParseAndInsert.
+	StageAnnotate = "annotate" // Annotating a buffer of rows.
+	StageCommit   = "commit"   // Committing a buffer of rows to the sink.
+)
+
+var (
+	// StageDuration provides a histogram of the time taken by each
+	// operation in each stage of task processing.
+	//
+	// Provides metrics:
+	//   etl_stage_duration_seconds_bucket{table="...", stage="...", le="..."}
+	//   ...
+	//   etl_stage_duration_seconds_sum{table="...", stage="..."}
+	//   etl_stage_duration_seconds_count{table="...", stage="..."}
+	// Usage example:
+	//   start := time.Now()
+	//   // do some stuff.
+	//   metrics.StageDuration.WithLabelValues(
+	//           "ndt", metrics.StageParse).Observe(time.Since(start).Seconds())
+	StageDuration = promauto.NewHistogramVec(
+		prometheus.HistogramOpts{
+			Name:    "etl_stage_duration_seconds",
+			Help:    "Task stage operation time distributions.",
+			Buckets: prometheus.ExponentialBuckets(0.00001, 3.16, 15), // 10us to about 7 minutes.
+		},
+		[]string{"table", "stage"},
+	)
+
+	// StageBytesRate provides a histogram of the data rate of each
+	// operation in each stage of task processing.
+	//
+	// Provides metrics:
+	//   etl_stage_bytes_per_second_bucket{table="...", stage="...", le="..."}
+	//   ...
+	// Usage example:
+	//   metrics.StageBytesRate.WithLabelValues(
+	//           "ndt", metrics.StageRead).Observe(bytes / seconds)
+	StageBytesRate = promauto.NewHistogramVec(
+		prometheus.HistogramOpts{
+			Name:    "etl_stage_bytes_per_second",
+			Help:    "Task stage data rate distributions.",
+			Buckets: prometheus.ExponentialBuckets(1000, 3.16, 14), // 1kB/s to about 3GB/s.
+		},
+		[]string{"table", "stage"},
+	)
+
+	// StageRowsRate provides a histogram of the row rate of each operation
+	// in each stage of task processing.
+	//
+	// Provides metrics:
+	//   etl_stage_rows_per_second_bucket{table="...", stage="...", le="..."}
+	//   ...
+	// Usage example:
+	//   metrics.StageRowsRate.WithLabelValues(
+	//           "ndt", metrics.StageCommit).Observe(rows / seconds)
+	StageRowsRate = promauto.NewHistogramVec(
+		prometheus.HistogramOpts{
+			Name:    "etl_stage_rows_per_second",
+			Help:    "Task stage row rate distributions.",
+			Buckets: prometheus.ExponentialBuckets(1, 3.16, 14), // 1 to about 3M rows/s.
+		},
+		[]string{"table", "stage"},
+	)
+)
+
+// stageTotals accumulates the operations in one stage of a task.
+type stageTotals struct {
+	count int
+	time  time.Duration
+	bytes int64
+	rows  int64
+}
+
+// TaskStages accumulates the time spent in each stage of a single task, for
+// the status page.  A nil *TaskStages records only the stage metrics.
+// TaskStages is threadsafe.
+type TaskStages struct {
+	name  string
+	table string
+
+	lock   sync.Mutex
+	start  time.Time
+	end    time.Time
+	stages map[string]*stageTotals
+}
+
+// NewTaskStages creates a TaskStages for the task name, e.g. the archive
+// path, which writes to table.
+func NewTaskStages(name, table string) *TaskStages {
+	return &TaskStages{name: name, table: table, stages: map[string]*stageTotals{}}
+}
+
+// Observe records an operation in stage, started at start, that processed
+// bytes and rows, either of which may be zero.
+func (ts *TaskStages) Observe(table, stage string, start time.Time, bytes, rows int) {
+	d := time.Since(start)
+	StageDuration.WithLabelValues(table, stage).Observe(d.Seconds())
+	if s := d.Seconds(); s > 0 {
+		if bytes > 0 {
+			StageBytesRate.WithLabelValues(table, stage).Observe(float64(bytes) / s)
+		}
+		if rows > 0 {
+			StageRowsRate.WithLabelValues(table, stage).Observe(float64(rows) / s)
+		}
+	}
+	if ts == nil {
+		return
+	}
+	ts.lock.Lock()
+	defer ts.lock.Unlock()
+	st, ok := ts.stages[stage]
+	if !ok {
+		st = &stageTotals{}
+		ts.stages[stage] = st
+	}
+	st.count++
+	st.time += d
+	st.bytes += int64(bytes)
+	st.rows += int64(rows)
+}
+
+// maxRecentTasks is the number of finished tasks shown on the status page.
+const maxRecentTasks = 10
+
+var (
+	tasksLock   sync.Mutex
+	activeTasks = map[*TaskStages]struct{}{}
+	recentTasks []*TaskStages // Most recently finished last.
+)
+
+// Start records the start of the task, and shows it on the status page.
+func (ts *TaskStages) Start() {
+	ts.lock.Lock()
+	ts.start = time.Now()
+	ts.lock.Unlock()
+	tasksLock.Lock()
+	defer tasksLock.Unlock()
+	activeTasks[ts] = struct{}{}
+}
+
+// Finish records the end of the task, which is then shown with the recently
+// finished tasks.
+func (ts *TaskStages) Finish() {
+	ts.lock.Lock()
+	ts.end = time.Now()
+	ts.lock.Unlock()
+	tasksLock.Lock()
+	defer tasksLock.Unlock()
+	if _, ok := activeTasks[ts]; !ok {
+		return
+	}
+	delete(activeTasks, ts)
+	recentTasks = append(recentTasks, ts)
+	if len(recentTasks) > maxRecentTasks {
+		recentTasks = append(recentTasks[:0], recentTasks[1:]...)
+	}
+}
+
+var statusStages = []string{StageRead, StageInflate, StageParse, StageAnnotate, StageCommit}
+
+// writeRow writes the task's table row.
+func (ts *TaskStages) writeRow(w io.Writer) {
+	ts.lock.Lock()
+	defer ts.lock.Unlock()
+	end := ts.end
+	if end.IsZero() {
+		end = time.Now()
+	}
+	fmt.Fprintf(w, "<tr><td>%s</td><td>%s</td><td>%.1fs</td>",
+		html.EscapeString(ts.name), html.EscapeString(ts.table), end.Sub(ts.start).Seconds())
+	for _, stage := range statusStages {
+		st, ok := ts.stages[stage]
+		if !ok {
+			fmt.Fprintf(w, "<td></td>")
+			continue
+		}
+		fmt.Fprintf(w, "<td>%d in %.1fs", st.count, st.time.Seconds())
+		if s := st.time.Seconds(); s > 0 {
+			if st.bytes > 0 {
+				fmt.Fprintf(w, ", %.1f MB/s", float64(st.bytes)/s/1e6)
+			}
+			if st.rows > 0 {
+				fmt.Fprintf(w, ", %.0f rows/s", math.Round(float64(st.rows)/s))
+			}
+		}
+		fmt.Fprintf(w, "</td>")
+	}
+	fmt.Fprintf(w, "</tr>\n")
+}
+
+// WriteTaskStages writes an HTML summary of the stages of the active and
+// recently finished tasks, for the status page.  Stage times are summed
+// over concurrent goroutines, so may exceed the elapsed time.
+func WriteTaskStages(w io.Writer) {
+	tasksLock.Lock()
+	active := make([]*TaskStages, 0, len(activeTasks))
+	for ts := range activeTasks {
+		active = append(active, ts)
+	}
+	recent := append([]*TaskStages{}, recentTasks...)
+	tasksLock.Unlock()
+	sort.Slice(active, func(i, j int) bool { return active[i].name < active[j].name })
+
+	header := "<tr><th>Task</th><th>Table</th><th>Elapsed</th>"
+	for _, stage := range statusStages {
+		header += "<th>" + stage + "</th>"
+	}
+	header += "</tr>\n"
+	fmt.Fprintf(w, "<p>Active tasks:</p>\n<table>\n%s", header)
+	for _, ts := range active {
+		ts.writeRow(w)
+	}
+	fmt.Fprintf(w, "</table>\n<p>Recently finished tasks:</p>\n<table>\n%s", header)
+	for i := len(recent) - 1; i >= 0; i-- {
+		recent[i].writeRow(w)
+	}
+	fmt.Fprintf(w, "</table>\n")
+}
@@ -63,6 +63,17 @@ func (ap *AnnotationParser) TaskError() error {
 	return nil
 }
 
+// OrderIndependent implements etl.OrderIndependent.  Each test produces a
+// single independent row.
+func (ap *AnnotationParser) OrderIndependent() bool {
+	return true
+}
+
+// Fork implements etl.Forker.
+func (ap *AnnotationParser) Fork() etl.Parser {
+	return &AnnotationParser{Base: ap.Base.Fork(), table: ap.table, suffix: ap.suffix}
+}
+
 // IsParsable returns the canonical test type and whether to parse data.
 func (ap *AnnotationParser) IsParsable(testName string, data []byte) (string, bool) {
 	// Files look like: "<UUID>.json"
@@ -32,11 +32,23 @@ type RowBuffer struct {
 	bufferSize int
 	rows       []interface{} // Actually these are Annotatable, but we cast them later.
 	ann        v2as.Annotator
+
+	maxBytes int // If non-zero, the buffer is also full when it holds this many bytes.
+	bytes    int // Estimated bytes held by the buffered rows.
 }
 
 // AddRow simply inserts a row into the buffer.  Returns error if buffer is full.
 // Not thread-safe.  Should only be called by owning thread.
 func (buf *RowBuffer) AddRow(r interface{}) error {
+	return buf.AddSizedRow(r, 0)
+}
+
+// AddSizedRow inserts a row that holds an estimated size bytes of memory
+// into the buffer.  Returns etl.ErrBufferFull if the buffer is full, either
+// by row count, or because the row would take the buffer over its byte
+// limit.  A single row is always accepted by an empty buffer.
+// Not thread-safe.  Should only be called by owning thread.
+func (buf *RowBuffer) AddSizedRow(r interface{}, size int) error {
 	if !reflect.TypeOf(r).Implements(reflect.TypeOf((*row.Annotatable)(nil)).Elem()) {
 		log.Println(reflect.TypeOf(r), "not Annotatable")
 		return ErrNotAnnotatable
@@ -44,10 +56,26 @@ func (buf *RowBuffer) AddRow(r interface{}) error {
 	for len(buf.rows) > buf.bufferSize-1 {
 		return etl.ErrBufferFull
 	}
+	if buf.maxBytes > 0 && len(buf.rows) > 0 && buf.bytes+size > buf.maxBytes {
+		return etl.ErrBufferFull
+	}
 	buf.rows = append(buf.rows, r)
+	buf.bytes += size
 	return nil
 }
 
+// SetMaxBytes limits the estimated bytes held by buffered rows.  Zero means
+// the buffer is limited only by row count.
+func (buf *RowBuffer) SetMaxBytes(n int) {
+	buf.maxBytes = n
+}
+
+// BufferedBytes returns the estimated bytes held by the buffered rows, as
+// passed to AddSizedRow.
+func (buf *RowBuffer) BufferedBytes() int {
+	return buf.bytes
+}
+
 // NumRowsForTest allows tests to find number of rows in buffer.
 func (buf *RowBuffer) NumRowsForTest() int {
 	return len(buf.rows)
@@ -58,6 +86,7 @@ func (buf *RowBuffer) NumRowsForTest() int {
 func (buf *RowBuffer) TakeRows() []interface{} {
 	res := buf.rows
 	buf.rows = make([]interface{}, 0, buf.bufferSize)
+	buf.bytes = 0
 	return res
 }
 
@@ -198,12 +227,59 @@ func (buf *RowBuffer) Annotate(metricLabel string) error {
 type Base struct {
 	etl.Inserter
 	RowBuffer
+
+	stages *metrics.TaskStages // Records annotation and commit times, if non-nil.
 }
 
 // NewBase creates a new parser.Base.  This will generally be embedded in a type specific parser.
 func NewBase(ins etl.Inserter, bufSize int, ann v2as.Annotator) *Base {
-	buf := RowBuffer{bufSize, make([]interface{}, 0, bufSize), ann}
-	return &Base{ins, buf}
+	buf := RowBuffer{bufferSize: bufSize, rows: make([]interface{}, 0, bufSize), ann: ann}
+	return &Base{Inserter: ins, RowBuffer: buf}
+}
+
+// SetStages sets the TaskStages that record the annotation and commit times
+// of pb.
+func (pb *Base) SetStages(stages *metrics.TaskStages) {
+	pb.stages = stages
+}
+
+// Annotate fetches annotations for all rows in the buffer, and records the
+// annotate stage.
+// Not thread-safe.  Should only be called by owning thread.
+func (pb *Base) Annotate(metricLabel string) error {
+	rows := len(pb.rows)
+	if rows == 0 {
+		return nil
+	}
+	start := time.Now()
+	err := pb.RowBuffer.Annotate(metricLabel)
+	pb.stages.Observe(pb.TableBase(), metrics.StageAnnotate, start, 0, rows)
+	return err
+}
+
+// Put synchronously commits rows to the Inserter, and records the commit
+// stage.
+func (pb *Base) Put(rows []interface{}) error {
+	if len(rows) == 0 {
+		return pb.Inserter.Put(rows)
+	}
+	start := time.Now()
+	err := pb.Inserter.Put(rows)
+	pb.stages.Observe(pb.TableBase(), metrics.StageCommit, start, 0, len(rows))
+	return err
+}
+
+// PutAsync hands rows to the Inserter to commit in the background, and
+// records the commit stage.  PutAsync waits for any earlier commit in
+// progress, so the recorded time is the time the parser waited on commits.
+func (pb *Base) PutAsync(rows []interface{}) {
+	if len(rows) == 0 {
+		pb.Inserter.PutAsync(rows)
+		return
+	}
+	start := time.Now()
+	pb.Inserter.PutAsync(rows)
+	pb.stages.Observe(pb.TableBase(), metrics.StageCommit, start, 0, len(rows))
 }
 
 // TaskError return the task level error, based on failed rows, or any other criteria.
@@ -222,6 +298,7 @@ func (pb *Base) Flush() error {
 // AnnotateAndFlush annotates the rows in the buffer, and synchronously
 // pushes them through Inserter.
 func (pb *Base) AnnotateAndFlush(metricLabel string) error {
+	pb.observeBytes(metricLabel)
 	annErr := pb.Annotate(metricLabel)
 	flushErr := pb.Flush()
 
@@ -234,8 +311,17 @@ func (pb *Base) AnnotateAndFlush(metricLabel string) error {
 // AnnotateAndPutAsync annotates the rows in the buffer (synchronously),
 // and asynchronously pushes them to the Inserter.
 func (pb *Base) AnnotateAndPutAsync(metricLabel string) error {
+	pb.observeBytes(metricLabel)
 	annErr := pb.Annotate(metricLabel)
 	rows := pb.TakeRows()
 	pb.PutAsync(rows)
 	return annErr
 }
+
+// observeBytes records the bytes held by the buffer when it is emptied, for
+// parsers that add sized rows.
+func (pb *Base) observeBytes(metricLabel string) {
+	if pb.bytes > 0 {
+		metrics.HeldBytesHistogram.WithLabelValues(metricLabel, "buffer").Observe(float64(pb.bytes))
+	}
+}
@@ -1,9 +1,11 @@
 package parser_test
 
 import (
+	"bytes"
 	"fmt"
 	"net/http"
 	"net/http/httptest"
+	"strings"
 	"testing"
 	"time"
 
@@ -11,6 +13,7 @@ import (
 	v2as "github.com/m-lab/annotation-service/api/v2"
 
 	"github.com/m-lab/etl/etl"
+	"github.com/m-lab/etl/metrics"
 	"github.com/m-lab/etl/parser"
 	"github.com/m-lab/etl/row"
 )
@@ -117,6 +120,67 @@ func TestBase(t *testing.T) {
 	}
 }
 
+// The legacy Base must record the annotate and commit stages of its task.
+func TestBaseStages(t *testing.T) {
+	ts := httptest.NewServer(http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
+		fmt.Fprint(w, `{"AnnotatorDate":"2018-12-05T00:00:00Z", "Annotations":{}}`)
+	}))
+	defer ts.Close()
+
+	stages := metrics.NewTaskStages("gs://bucket/base-stages.tgz", "test")
+	stages.Start()
+	defer stages.Finish()
+	b := parser.NewBase(&inMemoryInserter{}, 10, v2as.GetAnnotator(ts.URL))
+	b.SetStages(stages)
+	b.AddRow(&Row{"1.2.3.4", "4.3.2.1", nil, nil})
+	if err := b.AnnotateAndFlush("test"); err != nil {
+		t.Fatal(err)
+	}
+
+	buf := &bytes.Buffer{}
+	metrics.WriteTaskStages(buf)
+	for _, line := range strings.Split(buf.String(), "\n") {
+		if !strings.Contains(line, "gs://bucket/base-stages.tgz") {
+			continue
+		}
+		// Only read, inflate and parse should be empty.
+		if n := strings.Count(line, "<td></td>"); n != 3 {
+			t.Errorf("Missing annotate or commit stage: %s", line)
+		}
+		return
+	}
+	t.Error("Missing task", buf.String())
+}
+
+func TestMaxBytes(t *testing.T) {
+	ins := &inMemoryInserter{}
+	b := parser.NewBase(ins, 10, nil)
+	b.SetMaxBytes(1000)
+
+	// A single oversize row is accepted by an empty buffer.
+	if err := b.AddSizedRow(&Row{"1.2.3.4", "4.3.2.1", nil, nil}, 1500); err != nil {
+		t.Error(err)
+	}
+	if err := b.AddSizedRow(&Row{"1.2.3.4", "4.3.2.1", nil, nil}, 100); err != etl.ErrBufferFull {
+		t.Errorf("AddSizedRow() = %v, want %v", err, etl.ErrBufferFull)
+	}
+	b.TakeRows()
+	if b.BufferedBytes() != 0 {
+		t.Errorf("BufferedBytes() = %d, want 0", b.BufferedBytes())
+	}
+	for i := 0; i < 2; i++ {
+		if err := b.AddSizedRow(&Row{"1.2.3.4", "4.3.2.1", nil, nil}, 500); err != nil {
+			t.Error(err)
+		}
+	}
+	if err := b.AddSizedRow(&Row{"1.2.3.4", "4.3.2.1", nil, nil}, 1); err != etl.ErrBufferFull {
+		t.Errorf("AddSizedRow() = %v, want %v", err, etl.ErrBufferFull)
+	}
+	if b.NumRowsForTest() != 2 || b.BufferedBytes() != 1000 {
+		t.Errorf("Buffer holds %d rows, %d bytes, want 2, 1000", b.NumRowsForTest(), b.BufferedBytes())
+	}
+}
+
 func TestAsyncPut(t *testing.T) {
 	ins := &inMemoryInserter{}
 
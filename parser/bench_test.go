@@ -0,0 +1,408 @@
+package parser_test
+
+// End to end benchmarks of task.ProcessAllTests for each datatype, replaying
+// the archives and test files in testdata through a fake annotator and a
+// byte counting sink.
+//
+// Run with:
+//   go test -run=^$ -bench=BenchmarkTask ./parser
+// Each benchmark reports tests/s, MB/s of archive data, allocs/test,
+// rows/test, output bytes/test, and peak-rss-kB.  The peak RSS of the
+// benchmark process only grows, so each datatype's peak RSS is measured by
+// running the test binary again, for one iteration of just that datatype.
+//
+// The allocs/test and rows/test of each datatype are checked against
+// testdata/bench_baseline.json, so that regressions show up as benchmark
+// errors, and changes to the baseline show up in review.  A datatype with
+// no allocs/test or rows/test in the baseline is also an error.  To record
+// a new baseline after an intended change, or for a new datatype:
+//   go test -run=^$ -bench=BenchmarkTask ./parser -update_bench_baseline
+
+import (
+	"archive/tar"
+	"bytes"
+	"compress/gzip"
+	"encoding/json"
+	"errors"
+	"flag"
+	"fmt"
+	"io/ioutil"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"runtime"
+	"strconv"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"testing"
+	"time"
+
+	"cloud.google.com/go/civil"
+
+	"github.com/m-lab/etl/etl"
+	"github.com/m-lab/etl/parser"
+	"github.com/m-lab/etl/row"
+	"github.com/m-lab/etl/storage"
+	"github.com/m-lab/etl/task"
+)
+
+var updateBenchBaseline = flag.Bool("update_bench_baseline", false,
+	"Write the results of BenchmarkTask to "+benchBaselineFile)
+
+const benchBaselineFile = "testdata/bench_baseline.json"
+
+// benchMaxAllocGrowth is the allowed growth of allocs/test over the baseline.
+const benchMaxAllocGrowth = 1.2
+
+// benchCounts counts the rows, and the bytes of encoded rows, written by a
+// benchmark.
+type benchCounts struct {
+	rows  int64
+	bytes int64
+}
+
+func (c *benchCounts) add(rows []interface{}) {
+	n := 0
+	for _, r := range rows {
+		n += row.SizeOf(r)
+	}
+	atomic.AddInt64(&c.rows, int64(len(rows)))
+	atomic.AddInt64(&c.bytes, int64(n))
+}
+
+// benchSink is a row.Sink that counts and discards the encoded rows.
+type benchSink struct {
+	counts *benchCounts
+}
+
+func (s *benchSink) Commit(rows []interface{}, label string) (int, error) {
+	s.counts.add(rows)
+	return len(rows), nil
+}
+func (s *benchSink) AcceptsEncoded() bool { return true }
+func (s *benchSink) Close() error         { return nil }
+
+// benchInserter is an etl.Inserter that counts and discards the rows.  Like
+// the BigQuery inserter, it measures the rows with row.SizeOf, rather than
+// encoding them.
+type benchInserter struct {
+	counts *benchCounts
+	lock   sync.Mutex
+	stats  struct{ accepted, committed int }
+}
+
+func (in *benchInserter) Put(rows []interface{}) error {
+	in.lock.Lock()
+	in.stats.accepted += len(rows)
+	in.stats.committed += len(rows)
+	in.lock.Unlock()
+	in.counts.add(rows)
+	return nil
+}
+func (in *benchInserter) PutAsync(rows []interface{})       { in.Put(rows) }
+func (in *benchInserter) InsertRow(r interface{}) error     { return in.Put([]interface{}{r}) }
+func (in *benchInserter) InsertRows(rs []interface{}) error { return in.Put(rs) }
+func (in *benchInserter) Flush() error                      { return nil }
+func (in *benchInserter) TableBase() string                 { return "bench" }
+func (in *benchInserter) TableSuffix() string               { return "" }
+func (in *benchInserter) FullTableName() string             { return "bench" }
+func (in *benchInserter) Dataset() string                   { return "" }
+func (in *benchInserter) Project() string                   { return "" }
+func (in *benchInserter) RowsInBuffer() int                 { return 0 }
+func (in *benchInserter) Failed() int                       { return 0 }
+func (in *benchInserter) Accepted() int {
+	in.lock.Lock()
+	defer in.lock.Unlock()
+	return in.stats.accepted
+}
+func (in *benchInserter) Committed() int {
+	in.lock.Lock()
+	defer in.lock.Unlock()
+	return in.stats.committed
+}
+
+// fileArchive returns the content of an archive file.
+func fileArchive(fn string) func() ([]byte, error) {
+	return func() ([]byte, error) {
+		return ioutil.ReadFile(fn)
+	}
+}
+
+// dirArchive returns an uncompressed tar archive of the files in dir.
+func dirArchive(dir string) func() ([]byte, error) {
+	return func() ([]byte, error) {
+		files, err := ioutil.ReadDir(dir)
+		if err != nil {
+			return nil, err
+		}
+		buf := &bytes.Buffer{}
+		tw := tar.NewWriter(buf)
+		for _, f := range files {
+			if f.IsDir() {
+				continue
+			}
+			data, err := ioutil.ReadFile(filepath.Join(dir, f.Name()))
+			if err != nil {
+				return nil, err
+			}
+			tw.WriteHeader(&tar.Header{Name: f.Name(), Mode: 0644, Size: int64(len(data)), Typeflag: tar.TypeReg})
+			tw.Write(data)
+		}
+		err = tw.Close()
+		return buf.Bytes(), err
+	}
+}
+
+// switchArchive returns an archive of DISCO switch files.
+func switchArchive() ([]byte, error) {
+	buf := &bytes.Buffer{}
+	tw := tar.NewWriter(buf)
+	for i := 0; i < 100; i++ {
+		name := fmt.Sprintf("2019-01-01T00:%02d:00-to-2019-01-01T00:%02d:10-switch.jsonl", i/2, i/2)
+		tw.WriteHeader(&tar.Header{Name: name, Mode: 0644, Size: int64(len(test_data)), Typeflag: tar.TypeReg})
+		tw.Write(test_data)
+	}
+	err := tw.Close()
+	return buf.Bytes(), err
+}
+
+// benchSource returns a TestSource for an archive, which may be gzipped.
+func benchSource(b *testing.B, archive []byte) etl.TestSource {
+	var tr *tar.Reader
+	if len(archive) > 2 && archive[0] == 0x1f && archive[1] == 0x8b {
+		zr, err := gzip.NewReader(bytes.NewReader(archive))
+		if err != nil {
+			b.Fatal(err)
+		}
+		tr = tar.NewReader(zr)
+	} else {
+		tr = tar.NewReader(bytes.NewReader(archive))
+	}
+	return &storage.GCSSource{TarReader: tr, Closer: nullCloser{}, RetryBaseTime: time.Millisecond,
+		TableBase: "bench", PathDate: civil.Date{Year: 2020, Month: 6, Day: 11}}
+}
+
+type benchCase struct {
+	name    string
+	path    string // Archive URL for the task metadata.
+	archive func() ([]byte, error)
+	parser  func(c *benchCounts) etl.Parser
+}
+
+var benchCases = []benchCase{
+	{"ndt", "gs://fake-archive/ndt/2017/05/09/20170509T000000Z-mlab1-foo01-ndt-0000.tgz",
+		dirArchive("testdata/web100"),
+		func(c *benchCounts) etl.Parser {
+			return parser.NewNDTParser(&benchInserter{counts: c}, newFakeAnnotator(tcpInfoAnno))
+		}},
+	{"ndt5", "gs://fake-archive/ndt/ndt5/2019/08/19/20190819T000000.000000Z-ndt5-mlab1-foo01-ndt.tgz",
+		dirArchive("testdata/NDT5Result"),
+		func(c *benchCounts) etl.Parser {
+			return parser.NewNDT5ResultParser(&benchSink{c}, "ndt5", "", newFakeAnnotator(tcpInfoAnno))
+		}},
+	{"ndt7", "gs://fake-archive/ndt/ndt7/2020/03/18/20200318T000000.000000Z-ndt7-mlab1-foo01-ndt.tgz",
+		dirArchive("testdata/NDT7Result"),
+		func(c *benchCounts) etl.Parser {
+			return parser.NewNDT7ResultParser(&benchSink{c}, "ndt7", "", newFakeAnnotator(tcpInfoAnno))
+		}},
+	{"tcpinfo", "gs://fake-archive/ndt/tcpinfo/2019/05/16/20190516T013026.744845Z-tcpinfo-mlab4-arn02-ndt.tgz",
+		fileArchive("testdata/20190516T013026.744845Z-tcpinfo-mlab4-arn02-ndt.tgz"),
+		func(c *benchCounts) etl.Parser {
+			return parser.NewTCPInfoParser(&benchSink{c}, "tcpinfo", "", newFakeAnnotator(tcpInfoAnno))
+		}},
+	{"pt", "gs://fake-archive/ndt/traceroute/2019/08/25/20190825T000000.000000Z-traceroute-mlab1-foo01-ndt.tgz",
+		dirArchive("testdata/PT"),
+		func(c *benchCounts) etl.Parser {
+			return parser.NewPTParser(&benchInserter{counts: c}, newFakeAnnotator(tcpInfoAnno))
+		}},
+	{"ss", "gs://fake-archive/sidestream/2017/02/03/20170203T000000Z-mlab1-foo01-sidestream-0000.tgz",
+		dirArchive("testdata/sidestream"),
+		func(c *benchCounts) etl.Parser {
+			return parser.NewSSParser(&benchInserter{counts: c}, newFakeAnnotator(tcpInfoAnno))
+		}},
+	{"switch", "gs://fake-archive/utilization/2019/01/01/20190101T000000Z-mlab1-foo01-utilization-0000.tgz",
+		switchArchive,
+		func(c *benchCounts) etl.Parser {
+			return parser.NewDiscoParser(&benchInserter{counts: c})
+		}},
+	{"annotation", "gs://fake-archive/ndt/annotation/2020/03/24/20200324T000000.000000Z-annotation-mlab1-foo01-ndt.tgz",
+		dirArchive("testdata/Annotation"),
+		func(c *benchCounts) etl.Parser {
+			return parser.NewAnnotationParser(&benchSink{c}, "annotation", "", newFakeAnnotator(tcpInfoAnno))
+		}},
+}
+
+// benchResult holds the deterministic results of a benchmark.
+type benchResult struct {
+	AllocsPerTest float64 `json:",omitempty"`
+	RowsPerTest   float64 `json:",omitempty"`
+}
+
+var (
+	benchLock    sync.Mutex
+	benchResults = map[string]benchResult{}
+	benchRSS     = map[string]int64{} // Peak RSS of each case, in kB.
+)
+
+// benchChildEnv is set in the environment of the processes that measure the
+// peak RSS of a single benchmark case.
+const benchChildEnv = "ETL_BENCH_RSS_CHILD"
+
+// benchRSSMarker prefixes the peak RSS printed by a child process.
+const benchRSSMarker = "bench-peak-rss-kB:"
+
+func isBenchChild() bool {
+	return os.Getenv(benchChildEnv) != ""
+}
+
+// peakRSSKB returns the peak resident set size of the process, in kB.  This
+// reads VmHWM, rather than the rusage of the child, as the child's rusage
+// may include the parent's peak from before the exec.
+func peakRSSKB() (int64, error) {
+	data, err := ioutil.ReadFile("/proc/self/status")
+	if err != nil {
+		return 0, err
+	}
+	for _, line := range strings.Split(string(data), "\n") {
+		if strings.HasPrefix(line, "VmHWM:") {
+			kb := strings.TrimSuffix(strings.TrimSpace(strings.TrimPrefix(line, "VmHWM:")), " kB")
+			return strconv.ParseInt(kb, 10, 64)
+		}
+	}
+	return 0, errors.New("no VmHWM in /proc/self/status")
+}
+
+// casePeakRSSKB returns the peak resident set size, in kB, of a new test
+// process that runs a single iteration of the named BenchmarkTask case.
+func casePeakRSSKB(name string) (int64, error) {
+	benchLock.Lock()
+	defer benchLock.Unlock()
+	if rss, ok := benchRSS[name]; ok {
+		return rss, nil
+	}
+	cmd := exec.Command(os.Args[0], "-test.run=^$",
+		"-test.bench=^BenchmarkTask$/^"+name+"$", "-test.benchtime=1x")
+	cmd.Env = append(os.Environ(), benchChildEnv+"=1")
+	out, err := cmd.CombinedOutput()
+	if err != nil {
+		return 0, fmt.Errorf("%v: %s", err, out)
+	}
+	rss := int64(-1)
+	for _, line := range strings.Split(string(out), "\n") {
+		if strings.HasPrefix(line, benchRSSMarker) {
+			rss, err = strconv.ParseInt(strings.TrimSpace(strings.TrimPrefix(line, benchRSSMarker)), 10, 64)
+		}
+	}
+	if err != nil || rss < 0 {
+		return 0, fmt.Errorf("no peak RSS from benchmark process: %v: %s", err, out)
+	}
+	benchRSS[name] = rss
+	return rss, nil
+}
+
+func loadBenchBaseline() map[string]benchResult {
+	baseline := map[string]benchResult{}
+	data, err := ioutil.ReadFile(benchBaselineFile)
+	if err == nil {
+		err = json.Unmarshal(data, &baseline)
+	}
+	if err != nil && !os.IsNotExist(err) {
+		panic(err)
+	}
+	return baseline
+}
+
+// writeBenchBaseline writes the benchmark results to the baseline file, if
+// requested by -update_bench_baseline.
+func writeBenchBaseline() error {
+	benchLock.Lock()
+	defer benchLock.Unlock()
+	if !*updateBenchBaseline || len(benchResults) == 0 {
+		return nil
+	}
+	baseline := loadBenchBaseline()
+	for name, r := range benchResults {
+		baseline[name] = r
+	}
+	data, err := json.MarshalIndent(baseline, "", "  ")
+	if err != nil {
+		return err
+	}
+	return ioutil.WriteFile(benchBaselineFile, append(data, '\n'), 0644)
+}
+
+func BenchmarkTask(b *testing.B) {
+	baseline := loadBenchBaseline()
+	for _, bc := range benchCases {
+		bc := bc
+		b.Run(bc.name, func(b *testing.B) {
+			archive, err := bc.archive()
+			if err != nil {
+				b.Fatal(err)
+			}
+			counts := &benchCounts{}
+			var tests int
+			var before, after runtime.MemStats
+			runtime.ReadMemStats(&before)
+			b.SetBytes(int64(len(archive)))
+			b.ResetTimer()
+			start := time.Now()
+			for i := 0; i < b.N; i++ {
+				tsk := task.NewTask(bc.path, benchSource(b, archive), bc.parser(counts), nullCloser{})
+				n, err := tsk.ProcessAllTests(false)
+				if err != nil {
+					b.Fatal(err)
+				}
+				tests += n
+			}
+			elapsed := time.Since(start)
+			b.StopTimer()
+			runtime.ReadMemStats(&after)
+			if tests == 0 {
+				b.Fatal("No tests in", bc.name)
+			}
+
+			result := benchResult{
+				AllocsPerTest: float64(after.Mallocs-before.Mallocs) / float64(tests),
+				RowsPerTest:   float64(counts.rows) / float64(tests),
+			}
+			b.ReportMetric(float64(tests)/elapsed.Seconds(), "tests/s")
+			b.ReportMetric(result.AllocsPerTest, "allocs/test")
+			b.ReportMetric(result.RowsPerTest, "rows/test")
+			b.ReportMetric(float64(counts.bytes)/float64(tests), "out-B/test")
+			if isBenchChild() {
+				rss, err := peakRSSKB()
+				if err != nil {
+					b.Fatal(err)
+				}
+				fmt.Println(benchRSSMarker, rss)
+			} else {
+				rss, err := casePeakRSSKB(bc.name)
+				if err != nil {
+					b.Fatal(err)
+				}
+				b.ReportMetric(float64(rss), "peak-rss-kB")
+			}
+
+			benchLock.Lock()
+			benchResults[bc.name] = result
+			benchLock.Unlock()
+			if *updateBenchBaseline || isBenchChild() {
+				return
+			}
+			base := baseline[bc.name]
+			if base.AllocsPerTest == 0 || base.RowsPerTest == 0 {
+				b.Errorf("No baseline allocs/test and rows/test for %s, record them with -update_bench_baseline", bc.name)
+			}
+			if base.RowsPerTest != 0 && result.RowsPerTest != base.RowsPerTest {
+				b.Errorf("rows/test changed from baseline %.2f to %.2f",
+					base.RowsPerTest, result.RowsPerTest)
+			}
+			if base.AllocsPerTest != 0 && result.AllocsPerTest > benchMaxAllocGrowth*base.AllocsPerTest {
+				b.Errorf("allocs/test grew from baseline %.1f to %.1f",
+					base.AllocsPerTest, result.AllocsPerTest)
+			}
+		})
+	}
+}
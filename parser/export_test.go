@@ -1,5 +1,11 @@
 package parser
 
+import (
+	"encoding/json"
+
+	"github.com/m-lab/etl/schema"
+)
+
 // This file contains any whitebox tests (with access to package internals), and wrappers
 // to enable blackbox tests to set up environment.
 // See https://golang.org/src/net/http/export_test.go.
@@ -11,3 +17,34 @@ var InitParserVersionForTest = initParserVersion
 // InitParserGitCommitForTest allows test to rerun initParseGitCommit after initializing
 // environement variables.
 var InitParserGitCommitForTest = initParserGitCommit
+
+// SplitLinesForTest returns all lines from a lineIter over data.
+func SplitLinesForTest(data []byte) []string {
+	lines := []string{}
+	for li := newLineIter(data); ; {
+		line, ok := li.Next()
+		if !ok {
+			return lines
+		}
+		lines = append(lines, string(line))
+	}
+}
+
+// DecompressForTest allows tests to decompress tcpinfo files.
+var DecompressForTest = decompress
+
+// SaveTCPInfoZstdDictForTest returns a function that restores the current
+// tcpinfo dictionary, for tests that call SetTCPInfoZstdDict.
+func SaveTCPInfoZstdDictForTest() func() {
+	dd := tcpinfoZstdDict()
+	return func() { zstdDict = dd }
+}
+
+// DecodeTracelbForTest decodes a tracelb line with both the specialized
+// decoder and encoding/json.
+func DecodeTracelbForTest(line []byte) (fast, std []schema.ScamperHop, fastErr, stdErr error) {
+	_, fast, fastErr = decodeTracelb(line)
+	var tracelb TracelbLine
+	stdErr = json.Unmarshal(line, &tracelb)
+	return fast, tracelbHops(&tracelb), fastErr, stdErr
+}
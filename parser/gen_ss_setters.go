@@ -0,0 +1,54 @@
+// +build ignore
+
+// gen_ss_setters generates ss_setters.go, the table of Web100Snap field
+// setters used by the SideStream parser.
+// Run with "go generate" in the parser directory.
+package main
+
+import (
+	"bytes"
+	"fmt"
+	"go/format"
+	"io/ioutil"
+	"log"
+	"reflect"
+
+	"github.com/m-lab/etl/schema"
+)
+
+func main() {
+	buf := &bytes.Buffer{}
+	fmt.Fprintln(buf, "// Code generated by gen_ss_setters.go from schema.Web100Snap; DO NOT EDIT.")
+	fmt.Fprintln(buf)
+	fmt.Fprintln(buf, "package parser")
+	fmt.Fprintln(buf)
+	fmt.Fprintln(buf, `import "github.com/m-lab/etl/schema"`)
+	fmt.Fprintln(buf)
+	fmt.Fprintln(buf, "// snapSetters parses a raw value, and sets the named Web100Snap field.")
+	fmt.Fprintln(buf, "var snapSetters = map[string]snapSetter{")
+	t := reflect.TypeOf(schema.Web100Snap{})
+	for i := 0; i < t.NumField(); i++ {
+		f := t.Field(i)
+		var parse string
+		switch f.Type.Kind() {
+		case reflect.Int64:
+			parse = "parseInt64Bytes(b)"
+		case reflect.Bool:
+			parse = fmt.Sprintf("parseBoolBytes(%q, b)", f.Name)
+		case reflect.String:
+			fmt.Fprintf(buf, "%q: func(s *schema.Web100Snap, b []byte) error { s.%s = string(b); return nil },\n", f.Name, f.Name)
+			continue
+		default:
+			log.Fatalf("Unsupported type %v for %s", f.Type, f.Name)
+		}
+		fmt.Fprintf(buf, "%q: func(s *schema.Web100Snap, b []byte) (err error) { s.%s, err = %s; return },\n", f.Name, f.Name, parse)
+	}
+	fmt.Fprintln(buf, "}")
+	src, err := format.Source(buf.Bytes())
+	if err != nil {
+		log.Fatal(err)
+	}
+	if err := ioutil.WriteFile("ss_setters.go", src, 0644); err != nil {
+		log.Fatal(err)
+	}
+}
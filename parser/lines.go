@@ -0,0 +1,31 @@
+package parser
+
+import "bytes"
+
+// lineIter iterates over the lines of a test file, without copying it.
+// The returned lines share storage with the file content, so they must be
+// copied if they are retained.
+type lineIter struct {
+	rest []byte
+}
+
+// newLineIter returns an iterator over the "\n" terminated lines of data.
+func newLineIter(data []byte) *lineIter {
+	return &lineIter{rest: data}
+}
+
+// Next returns the next line, without its terminator, or false if there are
+// no more lines.  Like strings.Split, a final unterminated line is returned,
+// but an empty one is not.
+func (li *lineIter) Next() ([]byte, bool) {
+	if len(li.rest) == 0 {
+		return nil, false
+	}
+	line := li.rest
+	if eol := bytes.IndexByte(line, '\n'); eol >= 0 {
+		line, li.rest = line[:eol], line[eol+1:]
+	} else {
+		li.rest = nil
+	}
+	return line, true
+}
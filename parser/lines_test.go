@@ -0,0 +1,27 @@
+package parser_test
+
+import (
+	"testing"
+
+	"github.com/go-test/deep"
+
+	"github.com/m-lab/etl/parser"
+)
+
+func TestSplitLines(t *testing.T) {
+	tests := []struct {
+		data string
+		want []string
+	}{
+		{"", []string{}},
+		{"a", []string{"a"}},
+		{"a\n", []string{"a"}},
+		{"a\n\nb", []string{"a", "", "b"}},
+		{"\n\n", []string{"", ""}},
+	}
+	for _, tt := range tests {
+		if diff := deep.Equal(parser.SplitLinesForTest([]byte(tt.data)), tt.want); diff != nil {
+			t.Errorf("%q: %v", tt.data, diff)
+		}
+	}
+}
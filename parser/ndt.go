@@ -14,8 +14,10 @@ package parser
 ******************************************************************************/
 
 import (
+	"bytes"
 	"errors"
 	"fmt"
+	"io"
 	"log"
 	"os"
 	"reflect"
@@ -32,6 +34,7 @@ import (
 	v2as "github.com/m-lab/annotation-service/api/v2"
 	"github.com/m-lab/etl/etl"
 	"github.com/m-lab/etl/metrics"
+	"github.com/m-lab/etl/row"
 	"github.com/m-lab/etl/schema"
 	"github.com/m-lab/etl/web100"
 	"github.com/prometheus/client_golang/prometheus"
@@ -56,6 +59,11 @@ const (
 	// point.
 	minNumSnapshots = 1600 // If fewer than this, then set anomalies.num_snaps
 	maxNumSnapshots = 2800 // If more than this, truncate, and set anomolies.num_snaps
+
+	// ndtRowBytes is a rough estimate of the memory held by the maps of a
+	// single NDT row, excluding the deltas.  The final snapshot alone has
+	// about 130 fields.
+	ndtRowBytes = 16 * 1024
 )
 
 //=========================================================================
@@ -127,6 +135,12 @@ type fileInfoAndData struct {
 	fn   string
 	info TestInfo
 	data []byte
+	done bool // Processed, and data released.
+}
+
+// ready reports whether the test is a gzipped snaplog not yet processed.
+func (t *fileInfoAndData) ready() bool {
+	return t != nil && !t.done && strings.HasSuffix(t.fn, ".gz")
 }
 
 // NDTParser implements the Parser interface for NDT.
@@ -142,6 +156,8 @@ type NDTParser struct {
 	s2c *fileInfoAndData
 
 	metaFile *MetaFileData
+
+	groupPeak int // The most snaplog bytes held at once by the current group.
 }
 
 // NewNDTParser returns a new NDT parser.
@@ -153,10 +169,12 @@ func NewNDTParser(ins etl.Inserter, annotator ...v2as.Annotator) *NDTParser {
 	if len(annotator) > 0 && annotator[0] != nil {
 		ann = annotator[0]
 	} else {
-		ann = v2as.GetAnnotator(etl.BatchAnnotatorURL)
+		ann = row.CachingAnnotator(etl.BatchAnnotatorURL)
 	}
 
-	return &NDTParser{Base: *NewBase(ins, bufSize, ann)}
+	n := &NDTParser{Base: *NewBase(ins, bufSize, ann)}
+	n.SetMaxBytes(etl.MaxBufferBytes)
+	return n
 }
 
 // These functions implement the etl.Parser interface.
@@ -187,6 +205,12 @@ func (n *NDTParser) TableName() string {
 	return n.TableBase()
 }
 
+// RetainsData implements etl.DataRetainer.  Snaplogs are held until the
+// whole test group has arrived.
+func (n *NDTParser) RetainsData() bool {
+	return true
+}
+
 // IsParsable returns the canonical test type and whether to parse data.
 func (n *NDTParser) IsParsable(testName string, data []byte) (string, bool) {
 	info, err := ParseNDTFileName(testName)
@@ -261,7 +285,7 @@ func (n *NDTParser) ParseAndInsert(taskInfo map[string]bigquery.Value, testName
 	switch info.Suffix {
 	case "c2s_snaplog":
 		if n.c2s == nil {
-			n.c2s = &fileInfoAndData{testName, *info, content}
+			n.c2s = &fileInfoAndData{fn: testName, info: *info, data: content}
 		} else {
 			// There are occasional collisions between tests that
 			// have the same timestamp.
@@ -269,7 +293,7 @@ func (n *NDTParser) ParseAndInsert(taskInfo map[string]bigquery.Value, testName
 				// When rsync collects both the original file and
 				// the gzipped file, prefer the zipped file, since
 				// the unzipped file may be incomplete.
-				n.c2s = &fileInfoAndData{testName, *info, content}
+				n.c2s = &fileInfoAndData{fn: testName, info: *info, data: content}
 			} else if n.c2s.fn == (testName + ".gz") {
 				// Unzipped file follows zipped file is unexpected,
 				// but harmless. We just ignore the unzipped file.
@@ -282,7 +306,7 @@ func (n *NDTParser) ParseAndInsert(taskInfo map[string]bigquery.Value, testName
 		}
 	case "s2c_snaplog":
 		if n.s2c == nil {
-			n.s2c = &fileInfoAndData{testName, *info, content}
+			n.s2c = &fileInfoAndData{fn: testName, info: *info, data: content}
 		} else {
 			// There are occasional collisions between tests that
 			// have the same timestamp.
@@ -290,7 +314,7 @@ func (n *NDTParser) ParseAndInsert(taskInfo map[string]bigquery.Value, testName
 				// When rsync collects both the original file and
 				// the gzipped file, prefer the zipped file, since
 				// the unzipped file may be incomplete.
-				n.s2c = &fileInfoAndData{testName, *info, content}
+				n.s2c = &fileInfoAndData{fn: testName, info: *info, data: content}
 			} else if n.s2c.fn == (testName + ".gz") {
 				// Unzipped file follows zipped file is unexpected,
 				// but harmless. We just ignore the unzipped file.
@@ -314,9 +338,44 @@ func (n *NDTParser) ParseAndInsert(taskInfo map[string]bigquery.Value, testName
 		return errors.New("Unknown test suffix: " + info.Suffix)
 	}
 
+	if held := n.heldBytes(); held > n.groupPeak {
+		n.groupPeak = held
+	}
+	n.processReady()
 	return nil
 }
 
+// heldBytes returns the bytes of snaplog data held by the current group.
+func (n *NDTParser) heldBytes() int {
+	held := 0
+	if n.s2c != nil {
+		held += len(n.s2c.data)
+	}
+	if n.c2s != nil {
+		held += len(n.c2s.data)
+	}
+	return held
+}
+
+// processReady processes the snaplogs of the current group as soon as the
+// meta file is known, rather than at the end of the group, so that their
+// data is released early.  An uncompressed snaplog may still be replaced by
+// the gzipped file that follows it in the archive, so it waits for the end
+// of the group.
+func (n *NDTParser) processReady() {
+	if n.metaFile == nil {
+		return
+	}
+	if n.s2c.ready() {
+		n.processTest(n.s2c, "s2c")
+		n.s2c.data, n.s2c.done = nil, true
+	}
+	if n.c2s.ready() {
+		n.processTest(n.c2s, "c2s")
+		n.c2s.data, n.c2s.done = nil, true
+	}
+}
+
 func (n *NDTParser) reportAnomalies() {
 	// Report all groups that are missing files.
 	tag := ""
@@ -349,11 +408,14 @@ func (n *NDTParser) reportAnomalies() {
 // processGroup processes tests in the current timestamp grouping.
 func (n *NDTParser) processGroup() {
 	n.reportAnomalies()
-	// Now process the tests, with or without meta file.
-	if n.s2c != nil {
+	if n.groupPeak > 0 {
+		metrics.HeldBytesHistogram.WithLabelValues(n.TableName(), "group").Observe(float64(n.groupPeak))
+	}
+	// Now process any remaining tests, with or without meta file.
+	if n.s2c != nil && !n.s2c.done {
 		n.processTest(n.s2c, "s2c")
 	}
-	if n.c2s != nil {
+	if n.c2s != nil && !n.c2s.done {
 		n.processTest(n.c2s, "c2s")
 	}
 
@@ -362,6 +424,7 @@ func (n *NDTParser) processGroup() {
 	n.s2c = nil
 	n.c2s = nil
 	n.metaFile = nil
+	n.groupPeak = 0
 }
 
 // processTest digests a single s2c or c2s test, and writes a row to the Inserter.
@@ -395,69 +458,92 @@ func (n *NDTParser) processTest(test *fileInfoAndData, testType string) {
 	n.getAndInsertValues(test, testType)
 }
 
-func (n *NDTParser) getDeltas(snaplog *web100.SnapLog, testType string) ([]schema.Web100ValueMap, int) {
-	deltas := []schema.Web100ValueMap{}
+// deltaConstantFields are fields that do not change during a test, so they
+// are omitted from the deltas.
+var deltaConstantFields = []string{
+	"TimeStamps", "StartTimeStamp", "StartTimeUsec",
+	"LocalAddress", "LocalAddressType", "LocalPort",
+	"RemAddress", "RemPort", "SACK"}
+
+// getDeltas reads up to maxNumSnapshots snapshots from snaps, and returns
+// the deltas between them.  It returns nil if the snapshots are corrupt.
+func (n *NDTParser) getDeltas(snaps *web100.SnapReader, testType string) (*web100.Columns, int) {
 	deltaFieldCount := 0
 	if etl.OmitDeltas {
-		return deltas, deltaFieldCount
+		return web100.NewColumns(snaps.Header(), 0, 0), deltaFieldCount
 	}
+	// Proper sizing avoids reallocation.  Most snaplogs have a few hundred
+	// deltas of about 10 fields each.
+	deltas := web100.NewColumns(snaps.Header(), 256, 2560)
+	// Omit the constant fields.
+	deltas.Omit(deltaConstantFields...)
+
 	snapshotCount := 0
-	last := &web100.Snapshot{}
-	for count := 0; count < snaplog.SnapCount() && count < maxNumSnapshots; count++ {
-		snap, err := snaplog.Snapshot(count)
+	// last may be many snapshots behind, so it is copied out of the reader.
+	last := web100.Snapshot{}
+	lastBuf := make([]byte, snaps.Header().SnapshotNumBytes())
+	for count := 0; count < maxNumSnapshots; count++ {
+		snap, err := snaps.Next()
+		if err == io.EOF || err == web100.ErrTruncated {
+			break
+		}
 		if err != nil {
 			// TODO - refine label and maybe write a log?
 			metrics.TestCount.WithLabelValues(
 				n.TableName(), testType, "snapshot failure").Inc()
 			return nil, 0
 		}
-		// Proper sizing avoids evacuate, saving about 20%, excluding BQ code.
-		delta := schema.EmptySnap10()
-		snap.SnapshotDeltas(last, delta)
+		deltas.StartRow()
+		err = snap.SnapshotDeltasTo(&last, deltas)
 		if err != nil {
 			metrics.ErrorCount.WithLabelValues(
 				n.TableName(), testType, "snapValues failure").Inc()
 			return nil, 0
 		}
 
-		// Delete the constant fields.
-		delete(delta, "TimeStamps")
-		delete(delta, "StartTimeStamp")
-		delete(delta, "StartTimeUsec")
-		delete(delta, "LocalAddress")
-		delete(delta, "LocalAddressType")
-		delete(delta, "LocalPort")
-		delete(delta, "RemAddress")
-		delete(delta, "RemPort")
-		delete(delta, "SACK")
+		row := deltas.NumRows() - 1
 		// Now ignore delta if the only field that changed is duration.
-		if len(delta) == 1 {
-			_, ok := delta["Duration"]
-			if ok {
+		if deltas.RowLen(row) == 1 {
+			if _, ok := deltas.RowInt64(row, "Duration"); ok {
+				deltas.DropRow()
 				continue
 			}
 		}
-		delta["snapshot_num"] = count
-		delta["delta_index"] = snapshotCount
+		deltas.SetInt64("snapshot_num", int64(count))
+		deltas.SetInt64("delta_index", int64(snapshotCount))
 		snapshotCount++
 		metrics.DeltaNumFieldsHistogram.WithLabelValues(n.TableName()).
-			Observe(float64(len(delta)))
+			Observe(float64(deltas.RowLen(row)))
 
-		deltaFieldCount += len(delta)
-		deltas = append(deltas, delta)
-		last = &snap
+		deltaFieldCount += deltas.RowLen(row)
+		last = snap.Clone(lastBuf)
 	}
 
-	if len(deltas) > 0 {
+	if deltas.NumRows() > 0 {
 		// We tag some of the deltas with specific tags, to make them easy
 		// to find.  is_last is the first, but more will be added as we work
 		// out the most useful tags.
-		deltas[len(deltas)-1]["is_last"] = true
+		deltas.SetBool("is_last", true)
 	}
 
 	return deltas, deltaFieldCount
 }
 
+// finalSnapshot returns the last snapshot, or the snapshot at index
+// maxNumSnapshots for longer logs, continuing from wherever getDeltas stopped.
+func finalSnapshot(snaps *web100.SnapReader) (web100.Snapshot, error) {
+	for snaps.Count() <= maxNumSnapshots {
+		_, err := snaps.Next()
+		if err == io.EOF || err == web100.ErrTruncated {
+			break
+		}
+		if err != nil {
+			return web100.Snapshot{}, err
+		}
+	}
+	return snaps.Last()
+}
+
 func (n *NDTParser) getAndInsertValues(test *fileInfoAndData, testType string) {
 	// Extract the values from the last snapshot.
 	metrics.WorkerState.WithLabelValues(n.TableName(), "ndt-parse").Inc()
@@ -468,8 +554,11 @@ func (n *NDTParser) getAndInsertValues(test *fileInfoAndData, testType string) {
 			n.TableName(), testType, "uncompressed file").Inc()
 	}
 
-	// Large allocation here.
-	snaplog, err := web100.NewSnapLog(test.data)
+	// The snapshots are processed in a single pass, so only the header and
+	// the two most recent snapshot records are held by the reader.  The
+	// whole decompressed snaplog is still held in test.data, though, until
+	// its test group is processed.
+	snaps, err := web100.NewSnapReader(bytes.NewReader(test.data))
 	if err != nil {
 		metrics.ErrorCount.WithLabelValues(
 			n.TableName(), testType, "snaplog failure").Inc()
@@ -477,32 +566,14 @@ func (n *NDTParser) getAndInsertValues(test *fileInfoAndData, testType string) {
 			test.fn, n.taskFileName, err)
 		return
 	}
+	snaplog := snaps.Header()
 
-	valid := true
-	err = snaplog.ValidateSnapshots()
-	if err != nil {
-		log.Printf("ValidateSnapshots failed for %s, when processing: %s (%s)\n",
-			test.fn, n.taskFileName, err)
-		metrics.WarningCount.WithLabelValues(
-			n.TableName(), testType, "validate failed").Inc()
-		// If ValidateSnapshots returns error, it generally means that there
-		// is a problem with the last snapshot, typically a truncated file.
-		// In most cases, there are still many valid snapshots.
-		valid = false
-	}
-
-	var deltas []schema.Web100ValueMap
-	deltaFieldCount := 0
-	deltas, deltaFieldCount = n.getDeltas(snaplog, testType)
+	deltas, deltaFieldCount := n.getDeltas(snaps, testType)
 	if deltas == nil {
 		// There was some kind of major failure parsing snapshots.
 		return
 	}
-	final := snaplog.SnapCount() - 1
-	if final > maxNumSnapshots {
-		final = maxNumSnapshots
-	}
-	snap, err := snaplog.Snapshot(final)
+	snap, err := finalSnapshot(snaps)
 	if err != nil {
 		metrics.ErrorCount.WithLabelValues(
 			n.TableName(), testType, "final snapshot failure").Inc()
@@ -522,6 +593,21 @@ func (n *NDTParser) getAndInsertValues(test *fileInfoAndData, testType string) {
 		return
 	}
 
+	// The final snapshot must be decoded before draining the reader.
+	valid := true
+	err = snaps.Drain()
+	if err != nil {
+		log.Printf("ValidateSnapshots failed for %s, when processing: %s (%s)\n",
+			test.fn, n.taskFileName, err)
+		metrics.WarningCount.WithLabelValues(
+			n.TableName(), testType, "validate failed").Inc()
+		// If validation fails, it generally means that there
+		// is a problem with the last snapshot, typically a truncated file.
+		// In most cases, there are still many valid snapshots.
+		valid = false
+	}
+	snapCount := snaps.Count()
+
 	// TODO(prod) Write a row with this data, even if the snapshot parsing fails?
 	nestedConnSpec := make(schema.Web100ValueMap, 6)
 	snaplog.ConnectionSpecValues(nestedConnSpec)
@@ -534,8 +620,8 @@ func (n *NDTParser) getAndInsertValues(test *fileInfoAndData, testType string) {
 	results["id"] = ndtWeb100SyntheticUUID(test.fn)
 	results["test_id"] = test.fn
 	results["task_filename"] = n.taskFileName
-	if snaplog.SnapCount() > maxNumSnapshots || snaplog.SnapCount() < minNumSnapshots {
-		results["anomalies"].(schema.Web100ValueMap)["num_snaps"] = snaplog.SnapCount()
+	if snapCount > maxNumSnapshots || snapCount < minNumSnapshots {
+		results["anomalies"].(schema.Web100ValueMap)["num_snaps"] = snapCount
 	}
 	if !valid {
 		results["anomalies"].(schema.Web100ValueMap)["snaplog_error"] = true
@@ -544,17 +630,27 @@ func (n *NDTParser) getAndInsertValues(test *fileInfoAndData, testType string) {
 	if NDTEstimateBW {
 		// This is not terribly useful as is.  Intended as a place holder for code
 		// we are working on in parallel.
+		// These need random access to the whole log.
 		congEvents := make(schema.Web100ValueMap, 10)
-		snapNums, snapErr := snaplog.ChangeIndices("SmoothedRTT")
+		// Both fields are decoded in a single pass over the log.
+		fullLog, snapErr := web100.NewSnapLog(test.data)
+		var ints *web100.IntMatrix
+		if snapErr == nil {
+			ints, snapErr = fullLog.DecodeInts("SmoothedRTT", "HCThruOctetsAcked")
+		}
 		if snapErr != nil {
 			log.Println(snapErr)
 		} else {
+			snapNums := ints.ChangeIndices("SmoothedRTT")
 			congEvents["indices"] = snapNums
-			congEvents["smoothedRTT"] = snaplog.SliceIntField("SmoothedRTT", snapNums)
-			congEvents["thruOctetsAcked"] = snaplog.SliceIntField("HCThruOctetsAcked", snapNums)
+			congEvents["smoothedRTT"] = ints.Slice("SmoothedRTT", snapNums)
+			congEvents["thruOctetsAcked"] = ints.Slice("HCThruOctetsAcked", snapNums)
 			results["slices"] = congEvents
 		}
 	}
+	// Release the snaplog before the row is buffered, which may wait for
+	// annotation.
+	test.data = nil
 
 	// This is the timestamp parsed from the filename.
 	lt, err := test.info.Timestamp.MarshalText()
@@ -618,12 +714,15 @@ func (n *NDTParser) getAndInsertValues(test *fileInfoAndData, testType string) {
 	// TODO - estimate the size of the json (or fields) to allow more rows per request,
 	// but avoid going over the 10MB limit.
 	// Add row to buffer, possibly flushing buffer if it is full.
+	// The buffer may also be full because of the memory held by its rows,
+	// mostly in the deltas.
 	ndtTest := NDTTest{results}
-	err = n.Base.AddRow(ndtTest)
+	size := ndtRowBytes + deltas.SizeBytes()
+	err = n.Base.AddSizedRow(ndtTest, size)
 	if err == etl.ErrBufferFull {
 		// Ignore annotation errors.  They are counted and logged elsewhere.
 		n.Base.AnnotateAndPutAsync(n.TableBase())
-		err = n.Base.AddRow(ndtTest)
+		err = n.Base.AddSizedRow(ndtTest, size)
 	}
 	if err != nil {
 		metrics.ErrorCount.WithLabelValues(
@@ -35,7 +35,7 @@ type NDT7ResultParser struct {
 func NewNDT7ResultParser(sink row.Sink, table, suffix string, ann v2as.Annotator) etl.Parser {
 	bufSize := etl.NDT7.BQBufferSize()
 	if ann == nil {
-		ann = v2as.GetAnnotator(etl.BatchAnnotatorURL)
+		ann = row.CachingAnnotator(etl.BatchAnnotatorURL)
 	}
 
 	return &NDT7ResultParser{
@@ -58,6 +58,17 @@ func (dp *NDT7ResultParser) TaskError() error {
 	return nil
 }
 
+// OrderIndependent implements etl.OrderIndependent.  Each test produces a
+// single independent row.
+func (dp *NDT7ResultParser) OrderIndependent() bool {
+	return true
+}
+
+// Fork implements etl.Forker.
+func (dp *NDT7ResultParser) Fork() etl.Parser {
+	return &NDT7ResultParser{Base: dp.Base.Fork(), table: dp.table, suffix: dp.suffix}
+}
+
 // IsParsable returns the canonical test type and whether to parse data.
 func (dp *NDT7ResultParser) IsParsable(testName string, data []byte) (string, bool) {
 	// Files look like:
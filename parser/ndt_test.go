@@ -1,6 +1,7 @@
 package parser_test
 
 import (
+	"encoding/json"
 	"fmt"
 	"io/ioutil"
 	"net/http"
@@ -237,6 +238,17 @@ func TestNDTParser(t *testing.T) {
 		t.Errorf("Missing expected values:")
 		t.Errorf(pretty.Sprint(expectedValues))
 	}
+
+	// The size estimate must include the deltas, which are web100.Columns.
+	for _, r := range ins.data {
+		j, err := json.Marshal(r)
+		if err != nil {
+			t.Fatal(err)
+		}
+		if n := row.SizeOf(r); n < len(j) || n > 2*len(j) {
+			t.Errorf("SizeOf() = %d, want about %d", n, len(j))
+		}
+	}
 }
 
 func TestNDTTaskError(t *testing.T) {
@@ -171,6 +171,10 @@ func TestPlumbing(t *testing.T) {
 }
 
 func TestMain(m *testing.M) {
+	if isBenchChild() {
+		// The parent process has unpacked the files, and removes them.
+		os.Exit(m.Run())
+	}
 	p := pipe.Script(
 		"unpacking testdata files",
 		pipe.Exec("tar", "-C", "testdata", "-xvf", "testdata/pt-files.tar.gz"),
@@ -182,6 +186,10 @@ func TestMain(m *testing.M) {
 		log.Fatal(err)
 	}
 	exitCode := m.Run()
+	if err := writeBenchBaseline(); err != nil {
+		log.Println(err)
+		exitCode = 1
+	}
 	for _, dir := range []string{"testdata/PT", "testdata/web100", "testdata/sidestream"} {
 		os.RemoveAll(dir)
 	}
@@ -4,6 +4,7 @@ package parser
 // The format of legacy test file can be found at https://paris-traceroute.net/.
 
 import (
+	"bytes"
 	"encoding/json"
 	"errors"
 	"fmt"
@@ -20,6 +21,7 @@ import (
 	v2as "github.com/m-lab/annotation-service/api/v2"
 	"github.com/m-lab/etl/etl"
 	"github.com/m-lab/etl/metrics"
+	"github.com/m-lab/etl/row"
 	"github.com/m-lab/etl/schema"
 )
 
@@ -197,16 +199,16 @@ func ParseJSONL(testName string, rawContent []byte, tableName string, taskFilena
 	var tracelb TracelbLine
 	var cycleStop CyclestopLine
 
-	jsonStrings := strings.Split(string(rawContent[:]), "\n")
+	jsonLines := bytes.Split(rawContent, []byte("\n"))
 
-	if len(jsonStrings) != 5 {
+	if len(jsonLines) != 5 {
 		log.Println("Invalid test", taskFilename, "  ", testName)
-		log.Println(len(jsonStrings))
+		log.Println(len(jsonLines))
 		return schema.PTTest{}, errors.New("Invalid test")
 	}
 
 	// Parse the first line for meta info.
-	err = json.Unmarshal([]byte(jsonStrings[0]), &meta)
+	err = json.Unmarshal(jsonLines[0], &meta)
 	if err != nil {
 		metrics.ErrorCount.WithLabelValues(
 			tableName, "pt", "corrupted json content").Inc()
@@ -219,7 +221,7 @@ func ParseJSONL(testName string, rawContent []byte, tableName string, taskFilena
 	resultFromCache = meta.CachedResult
 
 	// Some early stage tests only has UUID field in this meta line.
-	err = json.Unmarshal([]byte(jsonStrings[1]), &cycleStart)
+	err = json.Unmarshal(jsonLines[1], &cycleStart)
 	if err != nil {
 		metrics.ErrorCount.WithLabelValues(
 			tableName, "pt", "corrupted json content").Inc()
@@ -228,60 +230,32 @@ func ParseJSONL(testName string, rawContent []byte, tableName string, taskFilena
 		return schema.PTTest{}, err
 	}
 
-	// Parse the line in struct
-	err = json.Unmarshal([]byte(jsonStrings[2]), &tracelb)
+	// Parse the line in struct.
+	tracelb, hops, err = decodeTracelb(jsonLines[2])
 	if err != nil {
-		// Some early stage scamper output has JSON grammar errors that can be fixed by
-		// extra reprocessing using jsonnett
-		// TODO: this is a hack. We should see if this can be simplified.
-		vm := jsonnet.MakeVM()
-		output, err := vm.EvaluateSnippet("file", jsonStrings[2])
-		err = json.Unmarshal([]byte(output), &tracelb)
+		// Fall back to encoding/json for anything decodeTracelb does not handle.
+		tracelb = TracelbLine{}
+		err = json.Unmarshal(jsonLines[2], &tracelb)
 		if err != nil {
-			// fail and return here.
-			metrics.ErrorCount.WithLabelValues(
-				tableName, "pt", "corrupted json content").Inc()
-			metrics.TestCount.WithLabelValues(
-				tableName, "pt", "corrupted json content").Inc()
-			return schema.PTTest{}, err
-		}
-	}
-	for i, _ := range tracelb.Nodes {
-		oneNode := &tracelb.Nodes[i]
-		var links []schema.HopLink
-		if len(oneNode.Links) == 0 {
-			hops = append(hops, schema.ScamperHop{
-				Source: schema.HopIP{IP: oneNode.Addr, Hostname: oneNode.Name},
-				Linkc:  oneNode.Linkc,
-			})
-			continue
-		}
-		if len(oneNode.Links) != 1 {
-			continue
-		}
-		// Links is an array containing a single array of HopProbes.
-		for _, oneLink := range oneNode.Links[0] {
-			var probes []schema.HopProbe
-			var ttl int64
-			for _, oneProbe := range oneLink.Probes {
-				var rtt []float64
-				for _, oneReply := range oneProbe.Replies {
-					rtt = append(rtt, oneReply.Rtt)
-				}
-				probes = append(probes, schema.HopProbe{Flowid: int64(oneProbe.Flowid), Rtt: rtt})
-				ttl = int64(oneProbe.Ttl)
+			// Some early stage scamper output has JSON grammar errors that can be fixed by
+			// extra reprocessing using jsonnett
+			// TODO: this is a hack. We should see if this can be simplified.
+			vm := jsonnet.MakeVM()
+			output, err := vm.EvaluateSnippet("file", string(jsonLines[2]))
+			err = json.Unmarshal([]byte(output), &tracelb)
+			if err != nil {
+				// fail and return here.
+				metrics.ErrorCount.WithLabelValues(
+					tableName, "pt", "corrupted json content").Inc()
+				metrics.TestCount.WithLabelValues(
+					tableName, "pt", "corrupted json content").Inc()
+				return schema.PTTest{}, err
 			}
-			links = append(links, schema.HopLink{HopDstIP: oneLink.Addr, TTL: ttl, Probes: probes})
 		}
-		hops = append(hops, schema.ScamperHop{
-			Source: schema.HopIP{IP: oneNode.Addr, Hostname: oneNode.Name},
-			Linkc:  oneNode.Linkc,
-			Links:  links,
-		})
-
+		hops = tracelbHops(&tracelb)
 	}
 
-	err = json.Unmarshal([]byte(jsonStrings[3]), &cycleStop)
+	err = json.Unmarshal(jsonLines[3], &cycleStop)
 	if err != nil {
 		metrics.ErrorCount.WithLabelValues(
 			tableName, "pt", "corrupted json content").Inc()
@@ -364,7 +338,7 @@ func NewPTParser(ins etl.Inserter, ann ...v2as.Annotator) *PTParser {
 	if len(ann) > 0 && ann[0] != nil {
 		annotator = ann[0]
 	} else {
-		annotator = v2as.GetAnnotator(etl.BatchAnnotatorURL)
+		annotator = row.CachingAnnotator(etl.BatchAnnotatorURL)
 	}
 	return &PTParser{Base: *NewBase(ins, bufSize, annotator)}
 }
@@ -191,6 +191,39 @@ func TestParseJSONLComplex(t *testing.T) {
 	}
 }
 
+func TestDecodeTracelb(t *testing.T) {
+	tests := []struct {
+		line     string
+		fallback bool
+	}{
+		{line: `{"type":"tracelb","version":"0.1","src":"1.2.3.4","dst":"5.6.7.8","start":{"sec":1,"usec":2},` +
+			`"probe_size":60,"probec":0,"nodes":[{"addr":"1.2.3.4","name":"a\u00e9","q_ttl":1,"linkc":1,` +
+			`"links":[[{"addr":"2.3.4.5","probes":[{"tx":{"sec":1,"usec":3},"replyc":1,"ttl":2,"attempt":0,` +
+			`"flowid":1,"replies":[{"rx":{"sec":1,"usec":4},"ttl":63,"rtt":0.5,"icmp_type":11}]}]}]]},` +
+			`{"addr":"2.3.4.5","linkc":0},{"addr":"3.4.5.6","links":[[],[]]}]}`},
+		{line: `{"NODES":[{"Addr":"1.2.3.4","links":[null]},null],"extra":[1,{"x":null}]}`},
+		{line: `{"nodes":[{"links":[[{"probes":[{"ttl":1.5}]}]]}]}`, fallback: true},
+		{line: `{"nodes":[{"addr":"a"}],"nodes":[{}]}`, fallback: true},
+		{line: `{"nodes":[],}`, fallback: true},
+	}
+	for _, tt := range tests {
+		fast, std, fastErr, stdErr := parser.DecodeTracelbForTest([]byte(tt.line))
+		if (fastErr != nil) != tt.fallback {
+			t.Errorf("%s: got error %v, want fallback %v", tt.line, fastErr, tt.fallback)
+			continue
+		}
+		if fastErr != nil {
+			continue
+		}
+		if stdErr != nil {
+			t.Errorf("%s: encoding/json failed: %v", tt.line, stdErr)
+		}
+		if diff := deep.Equal(fast, std); diff != nil {
+			t.Errorf("%s: %v", tt.line, diff)
+		}
+	}
+}
+
 func TestParseFirstLine(t *testing.T) {
 	line := "traceroute [(64.86.132.76:33461) -> (98.162.212.214:53849)], protocol icmp, algo exhaustive, duration 19 s"
 	protocol, dest_ip, server_ip, err := parser.ParseFirstLine(line)
@@ -0,0 +1,559 @@
+package parser
+
+// Decoder for the scamper tracelb line.
+//   The tracelb record holds every node, link, probe and reply of the
+//   traceroute, and decoding it with encoding/json dominates the PT parsing
+//   time.  decodeTracelb makes a single pass over the raw bytes, and builds
+//   the schema.ScamperHop values directly, without the intermediate
+//   ScamperNode records.
+//
+//   It must produce exactly what json.Unmarshal into TracelbLine followed by
+//   tracelbHops produces.  So key matching is case insensitive, null leaves
+//   a value unchanged, fields that are not used must still have valid types,
+//   and integers must be integers.  Anything it does not handle returns an
+//   error, and the caller falls back to encoding/json.  That includes
+//   malformed JSON, and repeated array keys, which encoding/json merges
+//   into the earlier elements.
+
+import (
+	"bytes"
+	"encoding/json"
+	"errors"
+	"strconv"
+	"unicode/utf8"
+
+	"github.com/m-lab/etl/schema"
+)
+
+var errTracelbSyntax = errors.New("unsupported tracelb json")
+
+// tracelbDecoder scans a single JSON value.
+type tracelbDecoder struct {
+	data []byte
+	pos  int
+}
+
+// peek skips whitespace, and returns the next byte, or 0 at the end.
+func (d *tracelbDecoder) peek() byte {
+	for ; d.pos < len(d.data); d.pos++ {
+		switch c := d.data[d.pos]; c {
+		case ' ', '\t', '\n', '\r':
+		default:
+			return c
+		}
+	}
+	return 0
+}
+
+func (d *tracelbDecoder) expect(c byte) error {
+	if d.peek() != c {
+		return errTracelbSyntax
+	}
+	d.pos++
+	return nil
+}
+
+// literal consumes lit, e.g. "null", if it is next.
+func (d *tracelbDecoder) literal(lit string) bool {
+	if d.peek() == lit[0] && bytes.HasPrefix(d.data[d.pos:], []byte(lit)) {
+		d.pos += len(lit)
+		return true
+	}
+	return false
+}
+
+// rawString returns the contents of the next string, and whether it needs
+// unescaping.
+func (d *tracelbDecoder) rawString() ([]byte, bool, error) {
+	if err := d.expect('"'); err != nil {
+		return nil, false, err
+	}
+	start := d.pos
+	plain := true
+	for d.pos < len(d.data) {
+		c := d.data[d.pos]
+		switch {
+		case c == '"':
+			s := d.data[start:d.pos]
+			d.pos++
+			return s, !plain || !utf8.Valid(s), nil
+		case c == '\\':
+			plain = false
+			if !d.escape() {
+				return nil, false, errTracelbSyntax
+			}
+		case c < 0x20:
+			return nil, false, errTracelbSyntax
+		default:
+			d.pos++
+		}
+	}
+	return nil, false, errTracelbSyntax
+}
+
+// escape validates and skips the escape sequence at pos.
+func (d *tracelbDecoder) escape() bool {
+	if d.pos+1 >= len(d.data) {
+		return false
+	}
+	switch d.data[d.pos+1] {
+	case '"', '\\', '/', 'b', 'f', 'n', 'r', 't':
+		d.pos += 2
+		return true
+	case 'u':
+		if d.pos+6 > len(d.data) {
+			return false
+		}
+		for _, c := range d.data[d.pos+2 : d.pos+6] {
+			if !('0' <= c && c <= '9' || 'a' <= c && c <= 'f' || 'A' <= c && c <= 'F') {
+				return false
+			}
+		}
+		d.pos += 6
+		return true
+	}
+	return false
+}
+
+// str decodes the next string.  Escaped strings and invalid UTF-8 are
+// rare, and are left to encoding/json.
+func (d *tracelbDecoder) str() (string, error) {
+	start := d.pos
+	s, escaped, err := d.rawString()
+	if err != nil || !escaped {
+		return string(s), err
+	}
+	var out string
+	err = json.Unmarshal(d.data[start:d.pos], &out)
+	return out, err
+}
+
+// optString decodes a string field, which is unchanged if null.
+func (d *tracelbDecoder) optString(s *string) error {
+	if d.literal("null") {
+		return nil
+	}
+	v, err := d.str()
+	if err == nil {
+		*s = v
+	}
+	return err
+}
+
+// number returns the next number literal, if it is valid JSON.
+func (d *tracelbDecoder) number() ([]byte, error) {
+	d.peek()
+	start := d.pos
+	digits := func() int {
+		n := 0
+		for ; d.pos < len(d.data) && '0' <= d.data[d.pos] && d.data[d.pos] <= '9'; d.pos++ {
+			n++
+		}
+		return n
+	}
+	if d.pos < len(d.data) && d.data[d.pos] == '-' {
+		d.pos++
+	}
+	if d.pos < len(d.data) && d.data[d.pos] == '0' {
+		d.pos++
+	} else if digits() == 0 {
+		return nil, errTracelbSyntax
+	}
+	if d.pos < len(d.data) && d.data[d.pos] == '.' {
+		d.pos++
+		if digits() == 0 {
+			return nil, errTracelbSyntax
+		}
+	}
+	if d.pos < len(d.data) && (d.data[d.pos] == 'e' || d.data[d.pos] == 'E') {
+		d.pos++
+		if d.pos < len(d.data) && (d.data[d.pos] == '+' || d.data[d.pos] == '-') {
+			d.pos++
+		}
+		if digits() == 0 {
+			return nil, errTracelbSyntax
+		}
+	}
+	return d.data[start:d.pos], nil
+}
+
+// optFloat decodes a float64 field, which is unchanged if null.
+func (d *tracelbDecoder) optFloat(f *float64) error {
+	if d.literal("null") {
+		return nil
+	}
+	b, err := d.number()
+	if err != nil {
+		return err
+	}
+	v, err := strconv.ParseFloat(string(b), 64)
+	if err == nil {
+		*f = v
+	}
+	return err
+}
+
+// optInt decodes an integer field, which is unchanged if null.  Like
+// encoding/json, a fraction or exponent is an error.
+func (d *tracelbDecoder) optInt(i *int64) error {
+	if d.literal("null") {
+		return nil
+	}
+	b, err := d.number()
+	if err != nil {
+		return err
+	}
+	v, err := parseInt64Bytes(b)
+	if err == nil {
+		*i = v
+	}
+	return err
+}
+
+// skip validates and skips the next value, of any type.
+func (d *tracelbDecoder) skip() error {
+	switch d.peek() {
+	case '{':
+		return d.object(func(key []byte) error { return d.skip() })
+	case '[':
+		return d.array(d.skip)
+	case '"':
+		_, _, err := d.rawString()
+		return err
+	case 't', 'f', 'n':
+		if d.literal("true") || d.literal("false") || d.literal("null") {
+			return nil
+		}
+		return errTracelbSyntax
+	default:
+		_, err := d.number()
+		return err
+	}
+}
+
+// object decodes an object, calling field to decode the value of each key.
+// A null object is ignored.
+func (d *tracelbDecoder) object(field func(key []byte) error) error {
+	if d.literal("null") {
+		return nil
+	}
+	if err := d.expect('{'); err != nil {
+		return err
+	}
+	if d.peek() == '}' {
+		d.pos++
+		return nil
+	}
+	for {
+		key, escaped, err := d.rawString()
+		if err != nil {
+			return err
+		}
+		if escaped || !isASCII(key) {
+			// encoding/json also folds some non-ASCII keys.
+			return errTracelbSyntax
+		}
+		if err := d.expect(':'); err != nil {
+			return err
+		}
+		if err := field(key); err != nil {
+			return err
+		}
+		switch d.peek() {
+		case ',':
+			d.pos++
+		case '}':
+			d.pos++
+			return nil
+		default:
+			return errTracelbSyntax
+		}
+	}
+}
+
+// array decodes an array, calling elem to decode each element.  The caller
+// must handle null.
+func (d *tracelbDecoder) array(elem func() error) error {
+	if err := d.expect('['); err != nil {
+		return err
+	}
+	if d.peek() == ']' {
+		d.pos++
+		return nil
+	}
+	for {
+		if err := elem(); err != nil {
+			return err
+		}
+		switch d.peek() {
+		case ',':
+			d.pos++
+		case ']':
+			d.pos++
+			return nil
+		default:
+			return errTracelbSyntax
+		}
+	}
+}
+
+func isASCII(b []byte) bool {
+	for _, c := range b {
+		if c >= utf8.RuneSelf {
+			return false
+		}
+	}
+	return true
+}
+
+// is reports whether key matches name, ignoring case like encoding/json.
+func is(key []byte, name string) bool {
+	return len(key) == len(name) && bytes.EqualFold(key, []byte(name))
+}
+
+// timestamp validates a TS object.
+func (d *tracelbDecoder) timestamp() error {
+	return d.object(func(key []byte) error {
+		var i int64
+		if is(key, "sec") || is(key, "usec") {
+			return d.optInt(&i)
+		}
+		return d.skip()
+	})
+}
+
+// reply decodes a Reply, and returns its rtt.
+func (d *tracelbDecoder) reply() (float64, error) {
+	var rtt float64
+	err := d.object(func(key []byte) error {
+		var i int64
+		switch {
+		case is(key, "rtt"):
+			return d.optFloat(&rtt)
+		case is(key, "rx"):
+			return d.timestamp()
+		case is(key, "ttl"), is(key, "icmp_type"), is(key, "icmp_code"),
+			is(key, "icmp_q_tos"), is(key, "icmp_q_ttl"):
+			return d.optInt(&i)
+		}
+		return d.skip()
+	})
+	return rtt, err
+}
+
+// probe decodes a Probe, and returns it with its ttl.
+func (d *tracelbDecoder) probe() (schema.HopProbe, int64, error) {
+	var hp schema.HopProbe
+	var ttl int64
+	seen := false
+	err := d.object(func(key []byte) error {
+		var i int64
+		switch {
+		case is(key, "flowid"):
+			return d.optInt(&hp.Flowid)
+		case is(key, "ttl"):
+			return d.optInt(&ttl)
+		case is(key, "replies"):
+			if seen {
+				return errTracelbSyntax
+			}
+			seen = true
+			if d.literal("null") {
+				return nil
+			}
+			return d.array(func() error {
+				rtt, err := d.reply()
+				hp.Rtt = append(hp.Rtt, rtt)
+				return err
+			})
+		case is(key, "tx"):
+			return d.timestamp()
+		case is(key, "replyc"), is(key, "attempt"):
+			return d.optInt(&i)
+		}
+		return d.skip()
+	})
+	return hp, ttl, err
+}
+
+// link decodes a ScamperLink into a HopLink.  The TTL is that of the last
+// probe.
+func (d *tracelbDecoder) link() (schema.HopLink, error) {
+	var hl schema.HopLink
+	seen := false
+	err := d.object(func(key []byte) error {
+		switch {
+		case is(key, "addr"):
+			return d.optString(&hl.HopDstIP)
+		case is(key, "probes"):
+			if seen {
+				return errTracelbSyntax
+			}
+			seen = true
+			if d.literal("null") {
+				return nil
+			}
+			return d.array(func() error {
+				hp, ttl, err := d.probe()
+				hl.Probes = append(hl.Probes, hp)
+				hl.TTL = ttl
+				return err
+			})
+		}
+		return d.skip()
+	})
+	return hl, err
+}
+
+// node decodes a ScamperNode into a ScamperHop, and reports whether the
+// hop should be kept.
+func (d *tracelbDecoder) node() (schema.ScamperHop, bool, error) {
+	var hop schema.ScamperHop
+	var groups [][]schema.HopLink
+	seen := false
+	err := d.object(func(key []byte) error {
+		var i int64
+		switch {
+		case is(key, "addr"):
+			return d.optString(&hop.Source.IP)
+		case is(key, "name"):
+			return d.optString(&hop.Source.Hostname)
+		case is(key, "linkc"):
+			return d.optInt(&hop.Linkc)
+		case is(key, "q_ttl"):
+			return d.optInt(&i)
+		case is(key, "links"):
+			if seen {
+				return errTracelbSyntax
+			}
+			seen = true
+			if d.literal("null") {
+				return nil
+			}
+			return d.array(func() error {
+				var links []schema.HopLink
+				groups = append(groups, nil)
+				if d.literal("null") {
+					return nil
+				}
+				err := d.array(func() error {
+					hl, err := d.link()
+					links = append(links, hl)
+					return err
+				})
+				groups[len(groups)-1] = links
+				return err
+			})
+		}
+		return d.skip()
+	})
+	// Links is an array containing a single array of links.  Nodes with
+	// several arrays are dropped.
+	switch len(groups) {
+	case 0:
+		return hop, true, err
+	case 1:
+		hop.Links = groups[0]
+		return hop, true, err
+	}
+	return hop, false, err
+}
+
+// decodeTracelb decodes the tracelb line.  The returned TracelbLine has
+// only the fields used by ParseJSONL, and no Nodes, as the nodes are
+// returned as hops.
+func decodeTracelb(line []byte) (TracelbLine, []schema.ScamperHop, error) {
+	d := &tracelbDecoder{data: line}
+	var tracelb TracelbLine
+	var hops []schema.ScamperHop
+	seen := false
+	if d.peek() != '{' {
+		// A top level null is valid, but only for encoding/json.
+		return tracelb, nil, errTracelbSyntax
+	}
+	err := d.object(func(key []byte) error {
+		var f float64
+		switch {
+		case is(key, "nodes"):
+			if seen {
+				return errTracelbSyntax
+			}
+			seen = true
+			if d.literal("null") {
+				return nil
+			}
+			return d.array(func() error {
+				hop, keep, err := d.node()
+				if keep {
+					hops = append(hops, hop)
+				}
+				return err
+			})
+		case is(key, "version"):
+			return d.optString(&tracelb.Version)
+		case is(key, "src"):
+			return d.optString(&tracelb.Src)
+		case is(key, "dst"):
+			return d.optString(&tracelb.Dst)
+		case is(key, "probe_size"):
+			return d.optFloat(&tracelb.Probe_size)
+		case is(key, "probec"):
+			return d.optFloat(&tracelb.Probec)
+		case is(key, "type"), is(key, "method"):
+			var s string
+			return d.optString(&s)
+		case is(key, "start"):
+			return d.timestamp()
+		case is(key, "userid"), is(key, "firsthop"), is(key, "attempts"),
+			is(key, "confidence"), is(key, "tos"), is(key, "gaplint"),
+			is(key, "wait_timeout"), is(key, "wait_probe"), is(key, "probec_max"),
+			is(key, "nodec"), is(key, "linkc"):
+			return d.optFloat(&f)
+		}
+		return d.skip()
+	})
+	if err == nil && d.peek() != 0 {
+		err = errTracelbSyntax
+	}
+	return tracelb, hops, err
+}
+
+// tracelbHops converts the nodes of a tracelb record decoded by
+// encoding/json to hops.
+func tracelbHops(tracelb *TracelbLine) []schema.ScamperHop {
+	var hops []schema.ScamperHop
+	for i := range tracelb.Nodes {
+		oneNode := &tracelb.Nodes[i]
+		var links []schema.HopLink
+		if len(oneNode.Links) == 0 {
+			hops = append(hops, schema.ScamperHop{
+				Source: schema.HopIP{IP: oneNode.Addr, Hostname: oneNode.Name},
+				Linkc:  oneNode.Linkc,
+			})
+			continue
+		}
+		if len(oneNode.Links) != 1 {
+			continue
+		}
+		// Links is an array containing a single array of HopProbes.
+		for _, oneLink := range oneNode.Links[0] {
+			var probes []schema.HopProbe
+			var ttl int64
+			for _, oneProbe := range oneLink.Probes {
+				var rtt []float64
+				for _, oneReply := range oneProbe.Replies {
+					rtt = append(rtt, oneReply.Rtt)
+				}
+				probes = append(probes, schema.HopProbe{Flowid: int64(oneProbe.Flowid), Rtt: rtt})
+				ttl = int64(oneProbe.Ttl)
+			}
+			links = append(links, schema.HopLink{HopDstIP: oneLink.Addr, TTL: ttl, Probes: probes})
+		}
+		hops = append(hops, schema.ScamperHop{
+			Source: schema.HopIP{IP: oneNode.Addr, Hostname: oneNode.Name},
+			Linkc:  oneNode.Linkc,
+			Links:  links,
+		})
+	}
+	return hops
+}
@@ -4,8 +4,8 @@ import (
 	"bytes"
 	"errors"
 	"log"
+	"math"
 	"path/filepath"
-	"reflect"
 	"strconv"
 	"strings"
 	"time"
@@ -16,6 +16,7 @@ import (
 
 	"github.com/m-lab/etl/etl"
 	"github.com/m-lab/etl/metrics"
+	"github.com/m-lab/etl/row"
 	"github.com/m-lab/etl/schema"
 	"github.com/m-lab/etl/web100"
 )
@@ -36,7 +37,7 @@ func NewSSParser(ins etl.Inserter, ann v2as.Annotator) *SSParser {
 // TODO get rid of this hack.
 func NewDefaultSSParser(ins etl.Inserter) *SSParser {
 	bufSize := etl.SS.BQBufferSize()
-	return &SSParser{*NewBase(ins, bufSize, v2as.GetAnnotator(etl.BatchAnnotatorURL))}
+	return &SSParser{*NewBase(ins, bufSize, row.CachingAnnotator(etl.BatchAnnotatorURL))}
 }
 
 // ExtractLogtimeFromFilename extracts the log time.
@@ -170,6 +171,51 @@ func ParseOneLine(snapshot string, varNames []string) (map[string]string, error)
 	return ssValue, nil
 }
 
+// snapSetter parses a raw value, and sets a Web100Snap field.
+type snapSetter func(*schema.Web100Snap, []byte) error
+
+//go:generate go run gen_ss_setters.go
+
+// parseInt64Bytes is strconv.ParseInt(string(b), 10, 64), without the
+// string conversion.
+func parseInt64Bytes(b []byte) (int64, error) {
+	neg := false
+	digits := b
+	if len(digits) > 0 && (digits[0] == '-' || digits[0] == '+') {
+		neg = digits[0] == '-'
+		digits = digits[1:]
+	}
+	if len(digits) == 0 || len(digits) > 19 {
+		// Too long values may still be valid with leading zeros.
+		return strconv.ParseInt(string(b), 10, 64)
+	}
+	var n uint64
+	for _, c := range digits {
+		if c < '0' || c > '9' {
+			return 0, &strconv.NumError{Func: "ParseInt", Num: string(b), Err: strconv.ErrSyntax}
+		}
+		n = n*10 + uint64(c-'0')
+	}
+	if !neg && n > math.MaxInt64 || neg && n > -math.MinInt64 {
+		return strconv.ParseInt(string(b), 10, 64)
+	}
+	if neg {
+		return -int64(n), nil
+	}
+	return int64(n), nil
+}
+
+// parseBoolBytes parses a "0" or "1" value of the named field.
+func parseBoolBytes(name string, b []byte) (bool, error) {
+	switch string(b) {
+	case "0":
+		return false, nil
+	case "1":
+		return true, nil
+	}
+	return false, errors.New("Cannot parse field " + name + " into a valie bool value.")
+}
+
 // PopulateSnap fills in the snapshot data.
 func PopulateSnap(ssValue map[string]string) (schema.Web100Snap, error) {
 	var snap = &schema.Web100Snap{}
@@ -185,34 +231,15 @@ func PopulateSnap(ssValue map[string]string) (schema.Web100Snap, error) {
 	}
 
 	// Process every other snap key.
-	for key := range ssValue {
+	for key, value := range ssValue {
 		// Skip cid and PollTime. They are SideStream-specific fields, not web100 variables.
-		if key == "cid" || key == "PollTime" {
-			continue
-		}
 		// Skip StartTimeUsec because this is not part of the Web100Snap struct.
-		if key == "StartTimeUsec" {
+		set, ok := snapSetters[key]
+		if !ok {
 			continue
 		}
-		x := reflect.ValueOf(snap).Elem().FieldByName(key)
-
-		switch x.Type().String() {
-		case "int64":
-			value, err := strconv.ParseInt(ssValue[key], 10, 64)
-			if err != nil {
-				return *snap, err
-			}
-			x.SetInt(value)
-		case "string":
-			x.Set(reflect.ValueOf(ssValue[key]))
-		case "bool":
-			if ssValue[key] == "0" {
-				x.Set(reflect.ValueOf(false))
-			} else if ssValue[key] == "1" {
-				x.Set(reflect.ValueOf(true))
-			} else {
-				return *snap, errors.New("Cannot parse field " + key + " into a valie bool value.")
-			}
+		if err := set(snap, []byte(value)); err != nil {
+			return *snap, err
 		}
 	}
 	// Combine the StartTimeStamp and StartTimeUsec values.
@@ -222,6 +249,140 @@ func PopulateSnap(ssValue map[string]string) (schema.Web100Snap, error) {
 	return *snap, nil
 }
 
+// ssLayout is a K-header compiled to setters indexed by column position.
+type ssLayout struct {
+	setters       []snapSetter // Setter for each column, or nil to ignore it.
+	startTimeUsec int          // Column of StartTimeUsec, or -1.
+	localAddress  int          // Columns of the connection spec fields, or -1.
+	localPort     int
+	remAddress    int
+	remPort       int
+}
+
+// compileKHeader parses the K-header, and resolves the setter for each column.
+func compileKHeader(header string) (*ssLayout, error) {
+	varNames, err := ParseKHeader(header)
+	if err != nil {
+		return nil, err
+	}
+	l := &ssLayout{setters: make([]snapSetter, len(varNames)),
+		startTimeUsec: -1, localAddress: -1, localPort: -1, remAddress: -1, remPort: -1}
+	for i, name := range varNames {
+		// Like a map, the last of any duplicate columns wins.
+		switch name {
+		case "StartTimeUsec":
+			l.startTimeUsec = i
+		case "LocalAddress":
+			l.localAddress = i
+		case "LocalPort":
+			l.localPort = i
+		case "RemAddress":
+			l.remAddress = i
+		case "RemPort":
+			l.remPort = i
+		}
+		// Columns without setters, e.g. cid and PollTime, are ignored.
+		l.setters[i] = snapSetters[name]
+	}
+	return l, nil
+}
+
+// splitLine splits a "C:" line into fields, reusing the storage of fields.
+// The fields share storage with line, and the columns are fields[1:].
+func (l *ssLayout) splitLine(line []byte, fields [][]byte) ([][]byte, error) {
+	fields = fields[:0]
+	for {
+		i := bytes.IndexByte(line, ' ')
+		if i < 0 {
+			fields = append(fields, line)
+			break
+		}
+		fields = append(fields, line[:i])
+		line = line[i+1:]
+	}
+	if string(fields[0]) != "C:" || len(fields) != len(l.setters)+1 {
+		return fields, errors.New("corrupted content")
+	}
+	return fields, nil
+}
+
+// column returns the value of column i, or nil if i is negative.
+func column(fields [][]byte, i int) []byte {
+	if i < 0 {
+		return nil
+	}
+	return fields[i]
+}
+
+// populateSnap sets the snapshot fields from the columns of a line.
+// This must produce the same values as PopulateSnap.
+func (l *ssLayout) populateSnap(fields [][]byte, snap *schema.Web100Snap) error {
+	for i, set := range l.setters {
+		if set == nil {
+			continue
+		}
+		if err := set(snap, fields[i]); err != nil {
+			return err
+		}
+	}
+	var startTimeUsec int64
+	if l.startTimeUsec >= 0 {
+		value, err := parseInt64Bytes(fields[l.startTimeUsec])
+		if err == nil {
+			startTimeUsec = value
+		}
+	}
+	// Combine the StartTimeStamp and StartTimeUsec values.
+	snap.StartTimeStamp = snap.StartTimeStamp*1000000 + startTimeUsec
+	return nil
+}
+
+// pack builds the sidestream row from the columns of a line.
+// This must produce the same row as PackDataIntoSchema.
+func (l *ssLayout) pack(fields [][]byte, logTime time.Time, testName string) (schema.SS, error) {
+	localPort, err := parseInt64Bytes(column(fields, l.localPort))
+	if err != nil {
+		return schema.SS{}, err
+	}
+	remotePort, err := parseInt64Bytes(column(fields, l.remPort))
+	if err != nil {
+		return schema.SS{}, err
+	}
+	ssTest := schema.SS{
+		TestID:  testName,
+		LogTime: logTime.Unix(),
+		Type:    int64(1),
+		Project: int64(2),
+	}
+	web100Log := &ssTest.Web100_log_entry
+	web100Log.LogTime = logTime.Unix() // TODO: Should use timestamp, not integer
+	web100Log.Version = "unknown"
+	web100Log.Group_name = "read"
+	if err := l.populateSnap(fields, &web100Log.Snap); err != nil {
+		return schema.SS{}, err
+	}
+	snap := &web100Log.Snap
+	snap.LocalAddress = NormalizeIP(string(column(fields, l.localAddress)))
+	snap.RemAddress = NormalizeIP(string(column(fields, l.remAddress)))
+	web100Log.Connection_spec = schema.Web100ConnectionSpecification{
+		Local_ip:    snap.LocalAddress,
+		Local_af:    web100.ParseIPFamily(snap.LocalAddress),
+		Local_port:  localPort,
+		Remote_ip:   snap.RemAddress,
+		Remote_port: remotePort,
+	}
+
+	// Create a synthetic UUID for joining with annotations.
+	ssTest.ID = ssSyntheticUUID(
+		testName,
+		snap.StartTimeStamp,
+		web100Log.Connection_spec.Local_ip,
+		web100Log.Connection_spec.Local_port,
+		web100Log.Connection_spec.Remote_ip,
+		web100Log.Connection_spec.Remote_port)
+	return ssTest, nil
+}
+
 // IsParsable returns the canonical test type and whether to parse data.
 func (ss *SSParser) IsParsable(testName string, data []byte) (string, bool) {
 	if strings.HasSuffix(testName, ".web100") {
@@ -244,43 +405,50 @@ func (ss *SSParser) ParseAndInsert(meta map[string]bigquery.Value, testName stri
 	if err != nil {
 		return err
 	}
-	testContent := strings.Split(string(rawContent[:]), "\n")
-	if len(testContent) < 2 {
+	// Lines are split in place, so memory use does not depend on the file
+	// size, and rows are buffered as each line is parsed.
+	if bytes.IndexByte(rawContent, '\n') < 0 {
 		return errors.New("empty test file")
 	}
-	varNames, err := ParseKHeader(testContent[0])
+	lines := newLineIter(rawContent)
+	header, _ := lines.Next()
+	layout, err := compileKHeader(string(header))
 	if err != nil {
 		metrics.ErrorCount.WithLabelValues(
 			ss.TableName(), "ss", "corrupted header").Inc()
 		return err
 	}
-	for _, oneLine := range testContent[1:] {
-		oneLine = strings.TrimSuffix(oneLine, "\n")
-
+	var fields [][]byte
+	for oneLine, ok := lines.Next(); ok; oneLine, ok = lines.Next() {
 		if len(oneLine) == 0 {
 			continue
 		}
-		ssValue, err := ParseOneLine(oneLine, varNames)
+		fields, err = layout.splitLine(oneLine, fields)
 		if err != nil {
+			log.Printf("corrupted content:")
+			log.Printf("%s", oneLine)
 			metrics.TestCount.WithLabelValues(
 				ss.TableName(), "ss", "corrupted content").Inc()
 			continue
 		}
-		err = web100.ValidateIP(ssValue["LocalAddress"])
+		cols := fields[1:]
+		localAddress := string(column(cols, layout.localAddress))
+		err = web100.ValidateIP(localAddress)
 		if err != nil {
 			metrics.TestCount.WithLabelValues(
 				ss.TableName(), "ss", "Invalid server IP").Inc()
-			log.Printf("Invalid server IP address: %s with error: %s\n", ssValue["LocalAddress"], err)
+			log.Printf("Invalid server IP address: %s with error: %s\n", localAddress, err)
 			continue
 		}
-		err = web100.ValidateIP(ssValue["RemAddress"])
+		remAddress := string(column(cols, layout.remAddress))
+		err = web100.ValidateIP(remAddress)
 		if err != nil {
 			metrics.TestCount.WithLabelValues(
 				ss.TableName(), "ss", "Invalid client IP").Inc()
-			log.Printf("Invalid client IP address: %s with error: %s", ssValue["RemAddress"], err)
+			log.Printf("Invalid client IP address: %s with error: %s", remAddress, err)
 			continue
 		}
-		ssTest, err := PackDataIntoSchema(ssValue, logTime, testName)
+		ssTest, err := layout.pack(cols, logTime, testName)
 		if err != nil {
 			metrics.TestCount.WithLabelValues(
 				ss.TableName(), "ss", "corrupted data").Inc()
@@ -0,0 +1,198 @@
+// Code generated by gen_ss_setters.go from schema.Web100Snap; DO NOT EDIT.
+
+package parser
+
+import "github.com/m-lab/etl/schema"
+
+// snapSetters parses a raw value, and sets the named Web100Snap field.
+var snapSetters = map[string]snapSetter{
+	"AbruptTimeouts":   func(s *schema.Web100Snap, b []byte) (err error) { s.AbruptTimeouts, err = parseInt64Bytes(b); return },
+	"ActiveOpen":       func(s *schema.Web100Snap, b []byte) (err error) { s.ActiveOpen, err = parseInt64Bytes(b); return },
+	"CERcvd":           func(s *schema.Web100Snap, b []byte) (err error) { s.CERcvd, err = parseInt64Bytes(b); return },
+	"CongAvoid":        func(s *schema.Web100Snap, b []byte) (err error) { s.CongAvoid, err = parseInt64Bytes(b); return },
+	"CongOverCount":    func(s *schema.Web100Snap, b []byte) (err error) { s.CongOverCount, err = parseInt64Bytes(b); return },
+	"CongSignals":      func(s *schema.Web100Snap, b []byte) (err error) { s.CongSignals, err = parseInt64Bytes(b); return },
+	"CountRTT":         func(s *schema.Web100Snap, b []byte) (err error) { s.CountRTT, err = parseInt64Bytes(b); return },
+	"CurAppRQueue":     func(s *schema.Web100Snap, b []byte) (err error) { s.CurAppRQueue, err = parseInt64Bytes(b); return },
+	"CurAppWQueue":     func(s *schema.Web100Snap, b []byte) (err error) { s.CurAppWQueue, err = parseInt64Bytes(b); return },
+	"CurCwnd":          func(s *schema.Web100Snap, b []byte) (err error) { s.CurCwnd, err = parseInt64Bytes(b); return },
+	"CurMSS":           func(s *schema.Web100Snap, b []byte) (err error) { s.CurMSS, err = parseInt64Bytes(b); return },
+	"CurRTO":           func(s *schema.Web100Snap, b []byte) (err error) { s.CurRTO, err = parseInt64Bytes(b); return },
+	"CurReasmQueue":    func(s *schema.Web100Snap, b []byte) (err error) { s.CurReasmQueue, err = parseInt64Bytes(b); return },
+	"CurRetxQueue":     func(s *schema.Web100Snap, b []byte) (err error) { s.CurRetxQueue, err = parseInt64Bytes(b); return },
+	"CurRwinRcvd":      func(s *schema.Web100Snap, b []byte) (err error) { s.CurRwinRcvd, err = parseInt64Bytes(b); return },
+	"CurRwinSent":      func(s *schema.Web100Snap, b []byte) (err error) { s.CurRwinSent, err = parseInt64Bytes(b); return },
+	"CurSsthresh":      func(s *schema.Web100Snap, b []byte) (err error) { s.CurSsthresh, err = parseInt64Bytes(b); return },
+	"CurTimeoutCount":  func(s *schema.Web100Snap, b []byte) (err error) { s.CurTimeoutCount, err = parseInt64Bytes(b); return },
+	"DSACKDups":        func(s *schema.Web100Snap, b []byte) (err error) { s.DSACKDups, err = parseInt64Bytes(b); return },
+	"DataOctetsIn":     func(s *schema.Web100Snap, b []byte) (err error) { s.DataOctetsIn, err = parseInt64Bytes(b); return },
+	"DataOctetsOut":    func(s *schema.Web100Snap, b []byte) (err error) { s.DataOctetsOut, err = parseInt64Bytes(b); return },
+	"DataSegsIn":       func(s *schema.Web100Snap, b []byte) (err error) { s.DataSegsIn, err = parseInt64Bytes(b); return },
+	"DataSegsOut":      func(s *schema.Web100Snap, b []byte) (err error) { s.DataSegsOut, err = parseInt64Bytes(b); return },
+	"DupAckEpisodes":   func(s *schema.Web100Snap, b []byte) (err error) { s.DupAckEpisodes, err = parseInt64Bytes(b); return },
+	"DupAcksIn":        func(s *schema.Web100Snap, b []byte) (err error) { s.DupAcksIn, err = parseInt64Bytes(b); return },
+	"DupAcksOut":       func(s *schema.Web100Snap, b []byte) (err error) { s.DupAcksOut, err = parseInt64Bytes(b); return },
+	"Duration":         func(s *schema.Web100Snap, b []byte) (err error) { s.Duration, err = parseInt64Bytes(b); return },
+	"ECESent":          func(s *schema.Web100Snap, b []byte) (err error) { s.ECESent, err = parseInt64Bytes(b); return },
+	"ECN":              func(s *schema.Web100Snap, b []byte) (err error) { s.ECN, err = parseInt64Bytes(b); return },
+	"ECNNonceRcvd":     func(s *schema.Web100Snap, b []byte) (err error) { s.ECNNonceRcvd, err = parseInt64Bytes(b); return },
+	"ECNsignals":       func(s *schema.Web100Snap, b []byte) (err error) { s.ECNsignals, err = parseInt64Bytes(b); return },
+	"ElapsedMicroSecs": func(s *schema.Web100Snap, b []byte) (err error) { s.ElapsedMicroSecs, err = parseInt64Bytes(b); return },
+	"ElapsedSecs":      func(s *schema.Web100Snap, b []byte) (err error) { s.ElapsedSecs, err = parseInt64Bytes(b); return },
+	"FastRetran":       func(s *schema.Web100Snap, b []byte) (err error) { s.FastRetran, err = parseInt64Bytes(b); return },
+	"HCDataOctetsIn":   func(s *schema.Web100Snap, b []byte) (err error) { s.HCDataOctetsIn, err = parseInt64Bytes(b); return },
+	"HCDataOctetsOut":  func(s *schema.Web100Snap, b []byte) (err error) { s.HCDataOctetsOut, err = parseInt64Bytes(b); return },
+	"HCSumRTT":         func(s *schema.Web100Snap, b []byte) (err error) { s.HCSumRTT, err = parseInt64Bytes(b); return },
+	"HCThruOctetsAcked": func(s *schema.Web100Snap, b []byte) (err error) {
+		s.HCThruOctetsAcked, err = parseInt64Bytes(b)
+		return
+	},
+	"HCThruOctetsReceived": func(s *schema.Web100Snap, b []byte) (err error) {
+		s.HCThruOctetsReceived, err = parseInt64Bytes(b)
+		return
+	},
+	"InRecovery":       func(s *schema.Web100Snap, b []byte) (err error) { s.InRecovery, err = parseInt64Bytes(b); return },
+	"IpTosIn":          func(s *schema.Web100Snap, b []byte) (err error) { s.IpTosIn, err = parseInt64Bytes(b); return },
+	"IpTosOut":         func(s *schema.Web100Snap, b []byte) (err error) { s.IpTosOut, err = parseInt64Bytes(b); return },
+	"IpTtl":            func(s *schema.Web100Snap, b []byte) (err error) { s.IpTtl, err = parseInt64Bytes(b); return },
+	"LimCwnd":          func(s *schema.Web100Snap, b []byte) (err error) { s.LimCwnd, err = parseInt64Bytes(b); return },
+	"LimMSS":           func(s *schema.Web100Snap, b []byte) (err error) { s.LimMSS, err = parseInt64Bytes(b); return },
+	"LimRwin":          func(s *schema.Web100Snap, b []byte) (err error) { s.LimRwin, err = parseInt64Bytes(b); return },
+	"LimSsthresh":      func(s *schema.Web100Snap, b []byte) (err error) { s.LimSsthresh, err = parseInt64Bytes(b); return },
+	"LocalAddress":     func(s *schema.Web100Snap, b []byte) error { s.LocalAddress = string(b); return nil },
+	"LocalAddressType": func(s *schema.Web100Snap, b []byte) (err error) { s.LocalAddressType, err = parseInt64Bytes(b); return },
+	"LocalPort":        func(s *schema.Web100Snap, b []byte) (err error) { s.LocalPort, err = parseInt64Bytes(b); return },
+	"MSSRcvd":          func(s *schema.Web100Snap, b []byte) (err error) { s.MSSRcvd, err = parseInt64Bytes(b); return },
+	"MSSSent":          func(s *schema.Web100Snap, b []byte) (err error) { s.MSSSent, err = parseInt64Bytes(b); return },
+	"MaxAppRQueue":     func(s *schema.Web100Snap, b []byte) (err error) { s.MaxAppRQueue, err = parseInt64Bytes(b); return },
+	"MaxAppWQueue":     func(s *schema.Web100Snap, b []byte) (err error) { s.MaxAppWQueue, err = parseInt64Bytes(b); return },
+	"MaxCaCwnd":        func(s *schema.Web100Snap, b []byte) (err error) { s.MaxCaCwnd, err = parseInt64Bytes(b); return },
+	"MaxMSS":           func(s *schema.Web100Snap, b []byte) (err error) { s.MaxMSS, err = parseInt64Bytes(b); return },
+	"MaxPipeSize":      func(s *schema.Web100Snap, b []byte) (err error) { s.MaxPipeSize, err = parseInt64Bytes(b); return },
+	"MaxRTO":           func(s *schema.Web100Snap, b []byte) (err error) { s.MaxRTO, err = parseInt64Bytes(b); return },
+	"MaxRTT":           func(s *schema.Web100Snap, b []byte) (err error) { s.MaxRTT, err = parseInt64Bytes(b); return },
+	"MaxReasmQueue":    func(s *schema.Web100Snap, b []byte) (err error) { s.MaxReasmQueue, err = parseInt64Bytes(b); return },
+	"MaxRetxQueue":     func(s *schema.Web100Snap, b []byte) (err error) { s.MaxRetxQueue, err = parseInt64Bytes(b); return },
+	"MaxRwinRcvd":      func(s *schema.Web100Snap, b []byte) (err error) { s.MaxRwinRcvd, err = parseInt64Bytes(b); return },
+	"MaxRwinSent":      func(s *schema.Web100Snap, b []byte) (err error) { s.MaxRwinSent, err = parseInt64Bytes(b); return },
+	"MaxSsCwnd":        func(s *schema.Web100Snap, b []byte) (err error) { s.MaxSsCwnd, err = parseInt64Bytes(b); return },
+	"MaxSsthresh":      func(s *schema.Web100Snap, b []byte) (err error) { s.MaxSsthresh, err = parseInt64Bytes(b); return },
+	"MinMSS":           func(s *schema.Web100Snap, b []byte) (err error) { s.MinMSS, err = parseInt64Bytes(b); return },
+	"MinRTO":           func(s *schema.Web100Snap, b []byte) (err error) { s.MinRTO, err = parseInt64Bytes(b); return },
+	"MinRTT":           func(s *schema.Web100Snap, b []byte) (err error) { s.MinRTT, err = parseInt64Bytes(b); return },
+	"MinRwinRcvd":      func(s *schema.Web100Snap, b []byte) (err error) { s.MinRwinRcvd, err = parseInt64Bytes(b); return },
+	"MinRwinSent":      func(s *schema.Web100Snap, b []byte) (err error) { s.MinRwinSent, err = parseInt64Bytes(b); return },
+	"MinSsthresh":      func(s *schema.Web100Snap, b []byte) (err error) { s.MinSsthresh, err = parseInt64Bytes(b); return },
+	"Nagle":            func(s *schema.Web100Snap, b []byte) (err error) { s.Nagle, err = parseInt64Bytes(b); return },
+	"NonRecovDA":       func(s *schema.Web100Snap, b []byte) (err error) { s.NonRecovDA, err = parseInt64Bytes(b); return },
+	"NonRecovDAEpisodes": func(s *schema.Web100Snap, b []byte) (err error) {
+		s.NonRecovDAEpisodes, err = parseInt64Bytes(b)
+		return
+	},
+	"OctetsRetrans":    func(s *schema.Web100Snap, b []byte) (err error) { s.OctetsRetrans, err = parseInt64Bytes(b); return },
+	"OtherReductions":  func(s *schema.Web100Snap, b []byte) (err error) { s.OtherReductions, err = parseInt64Bytes(b); return },
+	"PipeSize":         func(s *schema.Web100Snap, b []byte) (err error) { s.PipeSize, err = parseInt64Bytes(b); return },
+	"PostCongCountRTT": func(s *schema.Web100Snap, b []byte) (err error) { s.PostCongCountRTT, err = parseInt64Bytes(b); return },
+	"PostCongSumRTT":   func(s *schema.Web100Snap, b []byte) (err error) { s.PostCongSumRTT, err = parseInt64Bytes(b); return },
+	"PreCongSumCwnd":   func(s *schema.Web100Snap, b []byte) (err error) { s.PreCongSumCwnd, err = parseInt64Bytes(b); return },
+	"PreCongSumRTT":    func(s *schema.Web100Snap, b []byte) (err error) { s.PreCongSumRTT, err = parseInt64Bytes(b); return },
+	"QuenchRcvd":       func(s *schema.Web100Snap, b []byte) (err error) { s.QuenchRcvd, err = parseInt64Bytes(b); return },
+	"RTTVar":           func(s *schema.Web100Snap, b []byte) (err error) { s.RTTVar, err = parseInt64Bytes(b); return },
+	"RcvNxt":           func(s *schema.Web100Snap, b []byte) (err error) { s.RcvNxt, err = parseInt64Bytes(b); return },
+	"RcvRTT":           func(s *schema.Web100Snap, b []byte) (err error) { s.RcvRTT, err = parseInt64Bytes(b); return },
+	"RcvWindScale":     func(s *schema.Web100Snap, b []byte) (err error) { s.RcvWindScale, err = parseInt64Bytes(b); return },
+	"RecInitial":       func(s *schema.Web100Snap, b []byte) (err error) { s.RecInitial, err = parseInt64Bytes(b); return },
+	"RemAddress":       func(s *schema.Web100Snap, b []byte) error { s.RemAddress = string(b); return nil },
+	"RemPort":          func(s *schema.Web100Snap, b []byte) (err error) { s.RemPort, err = parseInt64Bytes(b); return },
+	"RetranThresh":     func(s *schema.Web100Snap, b []byte) (err error) { s.RetranThresh, err = parseInt64Bytes(b); return },
+	"SACK":             func(s *schema.Web100Snap, b []byte) (err error) { s.SACK, err = parseInt64Bytes(b); return },
+	"SACKBlocksRcvd":   func(s *schema.Web100Snap, b []byte) (err error) { s.SACKBlocksRcvd, err = parseInt64Bytes(b); return },
+	"SACKsRcvd":        func(s *schema.Web100Snap, b []byte) (err error) { s.SACKsRcvd, err = parseInt64Bytes(b); return },
+	"SampleRTT":        func(s *schema.Web100Snap, b []byte) (err error) { s.SampleRTT, err = parseInt64Bytes(b); return },
+	"SegsIn":           func(s *schema.Web100Snap, b []byte) (err error) { s.SegsIn, err = parseInt64Bytes(b); return },
+	"SegsOut":          func(s *schema.Web100Snap, b []byte) (err error) { s.SegsOut, err = parseInt64Bytes(b); return },
+	"SegsRetrans":      func(s *schema.Web100Snap, b []byte) (err error) { s.SegsRetrans, err = parseInt64Bytes(b); return },
+	"SendStall":        func(s *schema.Web100Snap, b []byte) (err error) { s.SendStall, err = parseInt64Bytes(b); return },
+	"SlowStart":        func(s *schema.Web100Snap, b []byte) (err error) { s.SlowStart, err = parseInt64Bytes(b); return },
+	"SmoothedRTT":      func(s *schema.Web100Snap, b []byte) (err error) { s.SmoothedRTT, err = parseInt64Bytes(b); return },
+	"SndInitial":       func(s *schema.Web100Snap, b []byte) (err error) { s.SndInitial, err = parseInt64Bytes(b); return },
+	"SndLimBytesCwnd":  func(s *schema.Web100Snap, b []byte) (err error) { s.SndLimBytesCwnd, err = parseInt64Bytes(b); return },
+	"SndLimBytesRwin":  func(s *schema.Web100Snap, b []byte) (err error) { s.SndLimBytesRwin, err = parseInt64Bytes(b); return },
+	"SndLimBytesSender": func(s *schema.Web100Snap, b []byte) (err error) {
+		s.SndLimBytesSender, err = parseInt64Bytes(b)
+		return
+	},
+	"SndLimTimeCwnd":  func(s *schema.Web100Snap, b []byte) (err error) { s.SndLimTimeCwnd, err = parseInt64Bytes(b); return },
+	"SndLimTimeRwin":  func(s *schema.Web100Snap, b []byte) (err error) { s.SndLimTimeRwin, err = parseInt64Bytes(b); return },
+	"SndLimTimeSnd":   func(s *schema.Web100Snap, b []byte) (err error) { s.SndLimTimeSnd, err = parseInt64Bytes(b); return },
+	"SndLimTransCwnd": func(s *schema.Web100Snap, b []byte) (err error) { s.SndLimTransCwnd, err = parseInt64Bytes(b); return },
+	"SndLimTransRwin": func(s *schema.Web100Snap, b []byte) (err error) { s.SndLimTransRwin, err = parseInt64Bytes(b); return },
+	"SndLimTransSnd":  func(s *schema.Web100Snap, b []byte) (err error) { s.SndLimTransSnd, err = parseInt64Bytes(b); return },
+	"SndMax":          func(s *schema.Web100Snap, b []byte) (err error) { s.SndMax, err = parseInt64Bytes(b); return },
+	"SndNxt":          func(s *schema.Web100Snap, b []byte) (err error) { s.SndNxt, err = parseInt64Bytes(b); return },
+	"SndUna":          func(s *schema.Web100Snap, b []byte) (err error) { s.SndUna, err = parseInt64Bytes(b); return },
+	"SndWindScale":    func(s *schema.Web100Snap, b []byte) (err error) { s.SndWindScale, err = parseInt64Bytes(b); return },
+	"SoftErrorReason": func(s *schema.Web100Snap, b []byte) (err error) { s.SoftErrorReason, err = parseInt64Bytes(b); return },
+	"SoftErrors":      func(s *schema.Web100Snap, b []byte) (err error) { s.SoftErrors, err = parseInt64Bytes(b); return },
+	"SpuriousFrDetected": func(s *schema.Web100Snap, b []byte) (err error) {
+		s.SpuriousFrDetected, err = parseInt64Bytes(b)
+		return
+	},
+	"SpuriousRtoDetected": func(s *schema.Web100Snap, b []byte) (err error) {
+		s.SpuriousRtoDetected, err = parseInt64Bytes(b)
+		return
+	},
+	"StartTimeStamp": func(s *schema.Web100Snap, b []byte) (err error) { s.StartTimeStamp, err = parseInt64Bytes(b); return },
+	"State":          func(s *schema.Web100Snap, b []byte) (err error) { s.State, err = parseInt64Bytes(b); return },
+	"SubsequentTimeouts": func(s *schema.Web100Snap, b []byte) (err error) {
+		s.SubsequentTimeouts, err = parseInt64Bytes(b)
+		return
+	},
+	"SumOctetsReordered": func(s *schema.Web100Snap, b []byte) (err error) {
+		s.SumOctetsReordered, err = parseInt64Bytes(b)
+		return
+	},
+	"SumRTT":          func(s *schema.Web100Snap, b []byte) (err error) { s.SumRTT, err = parseInt64Bytes(b); return },
+	"ThruOctetsAcked": func(s *schema.Web100Snap, b []byte) (err error) { s.ThruOctetsAcked, err = parseInt64Bytes(b); return },
+	"ThruOctetsReceived": func(s *schema.Web100Snap, b []byte) (err error) {
+		s.ThruOctetsReceived, err = parseInt64Bytes(b)
+		return
+	},
+	"TimeStamps": func(s *schema.Web100Snap, b []byte) (err error) { s.TimeStamps, err = parseInt64Bytes(b); return },
+	"TimeStampRcvd": func(s *schema.Web100Snap, b []byte) (err error) {
+		s.TimeStampRcvd, err = parseBoolBytes("TimeStampRcvd", b)
+		return
+	},
+	"TimeStampSent": func(s *schema.Web100Snap, b []byte) (err error) {
+		s.TimeStampSent, err = parseBoolBytes("TimeStampSent", b)
+		return
+	},
+	"Timeouts":        func(s *schema.Web100Snap, b []byte) (err error) { s.Timeouts, err = parseInt64Bytes(b); return },
+	"WAD_CwndAdjust":  func(s *schema.Web100Snap, b []byte) (err error) { s.WAD_CwndAdjust, err = parseInt64Bytes(b); return },
+	"WAD_IFQ":         func(s *schema.Web100Snap, b []byte) (err error) { s.WAD_IFQ, err = parseInt64Bytes(b); return },
+	"WAD_MaxBurst":    func(s *schema.Web100Snap, b []byte) (err error) { s.WAD_MaxBurst, err = parseInt64Bytes(b); return },
+	"WAD_MaxSsthresh": func(s *schema.Web100Snap, b []byte) (err error) { s.WAD_MaxSsthresh, err = parseInt64Bytes(b); return },
+	"WAD_NoAI":        func(s *schema.Web100Snap, b []byte) (err error) { s.WAD_NoAI, err = parseInt64Bytes(b); return },
+	"WillSendSACK":    func(s *schema.Web100Snap, b []byte) (err error) { s.WillSendSACK, err = parseInt64Bytes(b); return },
+	"WillUseSACK":     func(s *schema.Web100Snap, b []byte) (err error) { s.WillUseSACK, err = parseInt64Bytes(b); return },
+	"WinScaleRcvd":    func(s *schema.Web100Snap, b []byte) (err error) { s.WinScaleRcvd, err = parseInt64Bytes(b); return },
+	"WinScaleSent":    func(s *schema.Web100Snap, b []byte) (err error) { s.WinScaleSent, err = parseInt64Bytes(b); return },
+	"X_OtherReductionsCM": func(s *schema.Web100Snap, b []byte) (err error) {
+		s.X_OtherReductionsCM, err = parseInt64Bytes(b)
+		return
+	},
+	"X_OtherReductionsCV": func(s *schema.Web100Snap, b []byte) (err error) {
+		s.X_OtherReductionsCV, err = parseInt64Bytes(b)
+		return
+	},
+	"X_Rcvbuf":       func(s *schema.Web100Snap, b []byte) (err error) { s.X_Rcvbuf, err = parseInt64Bytes(b); return },
+	"X_Sndbuf":       func(s *schema.Web100Snap, b []byte) (err error) { s.X_Sndbuf, err = parseInt64Bytes(b); return },
+	"X_dbg1":         func(s *schema.Web100Snap, b []byte) (err error) { s.X_dbg1, err = parseInt64Bytes(b); return },
+	"X_dbg2":         func(s *schema.Web100Snap, b []byte) (err error) { s.X_dbg2, err = parseInt64Bytes(b); return },
+	"X_dbg3":         func(s *schema.Web100Snap, b []byte) (err error) { s.X_dbg3, err = parseInt64Bytes(b); return },
+	"X_dbg4":         func(s *schema.Web100Snap, b []byte) (err error) { s.X_dbg4, err = parseInt64Bytes(b); return },
+	"X_rcv_ssthresh": func(s *schema.Web100Snap, b []byte) (err error) { s.X_rcv_ssthresh, err = parseInt64Bytes(b); return },
+	"X_wnd_clamp":    func(s *schema.Web100Snap, b []byte) (err error) { s.X_wnd_clamp, err = parseInt64Bytes(b); return },
+	"ZeroRwinRcvd":   func(s *schema.Web100Snap, b []byte) (err error) { s.ZeroRwinRcvd, err = parseInt64Bytes(b); return },
+	"ZeroRwinSent":   func(s *schema.Web100Snap, b []byte) (err error) { s.ZeroRwinSent, err = parseInt64Bytes(b); return },
+}
@@ -5,6 +5,7 @@ import (
 	"io/ioutil"
 	"net/http"
 	"net/http/httptest"
+	"reflect"
 	"testing"
 	"time"
 
@@ -53,6 +54,31 @@ func TestPopulateSnap(t *testing.T) {
 	}
 }
 
+// The generated setter table must cover every Web100Snap field.
+func TestPopulateSnapAllFields(t *testing.T) {
+	ssValue := map[string]string{}
+	st := reflect.TypeOf(schema.Web100Snap{})
+	for i := 0; i < st.NumField(); i++ {
+		ssValue[st.Field(i).Name] = "1"
+	}
+	snap, err := parser.PopulateSnap(ssValue)
+	if err != nil {
+		t.Fatal(err)
+	}
+	sv := reflect.ValueOf(snap)
+	for i := 0; i < st.NumField(); i++ {
+		if sv.Field(i).IsZero() {
+			t.Error("Field not set:", st.Field(i).Name)
+		}
+	}
+	if _, err := parser.PopulateSnap(map[string]string{"CERcvd": "x"}); err == nil {
+		t.Error("Expected error for bad int64")
+	}
+	if _, err := parser.PopulateSnap(map[string]string{"TimeStampRcvd": "2"}); err == nil {
+		t.Error("Expected error for bad bool")
+	}
+}
+
 func TestParseOneLine(t *testing.T) {
 	header := "K: cid PollTime LocalAddress LocalPort RemAddress RemPort State SACKEnabled TimestampsEnabled NagleEnabled ECNEnabled SndWinScale RcvWinScale ActiveOpen MSSRcvd WinScaleRcvd WinScaleSent PktsOut DataPktsOut DataBytesOut PktsIn DataPktsIn DataBytesIn SndUna SndNxt SndMax ThruBytesAcked SndISS RcvNxt ThruBytesReceived RecvISS StartTimeSec StartTimeUsec Duration SndLimTransSender SndLimBytesSender SndLimTimeSender SndLimTransCwnd SndLimBytesCwnd SndLimTimeCwnd SndLimTransRwin SndLimBytesRwin SndLimTimeRwin SlowStart CongAvoid CongestionSignals OtherReductions X_OtherReductionsCV X_OtherReductionsCM CongestionOverCount CurCwnd MaxCwnd CurSsthresh LimCwnd MaxSsthresh MinSsthresh FastRetran Timeouts SubsequentTimeouts CurTimeoutCount AbruptTimeouts PktsRetrans BytesRetrans DupAcksIn SACKsRcvd SACKBlocksRcvd PreCongSumCwnd PreCongSumRTT PostCongSumRTT PostCongCountRTT ECERcvd SendStall QuenchRcvd RetranThresh NonRecovDA AckAfterFR DSACKDups SampleRTT SmoothedRTT RTTVar MaxRTT MinRTT SumRTT CountRTT CurRTO MaxRTO MinRTO CurMSS MaxMSS MinMSS X_Sndbuf X_Rcvbuf CurRetxQueue MaxRetxQueue CurAppWQueue MaxAppWQueue CurRwinSent MaxRwinSent MinRwinSent LimRwin DupAcksOut CurReasmQueue MaxReasmQueue CurAppRQueue MaxAppRQueue X_rcv_ssthresh X_wnd_clamp X_dbg1 X_dbg2 X_dbg3 X_dbg4 CurRwinRcvd MaxRwinRcvd MinRwinRcvd LocalAddressType X_RcvRTT WAD_IFQ WAD_MaxBurst WAD_MaxSsthresh WAD_NoAI WAD_CwndAdjust"
 	var_names, err := parser.ParseKHeader(header)
@@ -16,8 +16,11 @@ Notes:
 import (
 	"bytes"
 	"io"
+	"io/ioutil"
 	"log"
+	"os"
 	"strings"
+	"sync"
 	"time"
 
 	"cloud.google.com/go/bigquery"
@@ -39,6 +42,65 @@ type TCPInfoParser struct {
 	*row.Base
 	table  string
 	suffix string
+
+	// arena holds the decoded snapshots for the current test, and is reused
+	// for each test, so it must not be referenced by any row.  It saves only
+	// growing the slice: snapshot.Decode cannot decode into a Snapshot, so
+	// it still allocates each Snapshot and its LinuxTCPInfo.
+	arena []snapshot.Snapshot
+	// zbuf is the decompression buffer, also reused for each test.
+	zbuf []byte
+}
+
+var (
+	zstdDictOnce sync.Once
+	zstdDict     *gozstd.DDict
+)
+
+// SetTCPInfoZstdDict sets the dictionary for decompressing tcpinfo files.
+// By default, the dictionary is read from the file named by the
+// TCPINFO_ZSTD_DICT environment variable, if it is set.  Files compressed
+// without the dictionary are still decompressed correctly.  It must be
+// called before any files are parsed.
+func SetTCPInfoZstdDict(dict []byte) error {
+	dd, err := gozstd.NewDDict(dict)
+	if err != nil {
+		return err
+	}
+	zstdDictOnce.Do(func() {})
+	zstdDict = dd
+	return nil
+}
+
+func tcpinfoZstdDict() *gozstd.DDict {
+	zstdDictOnce.Do(func() {
+		fn := os.Getenv("TCPINFO_ZSTD_DICT")
+		if fn == "" {
+			return
+		}
+		dict, err := ioutil.ReadFile(fn)
+		if err == nil {
+			zstdDict, err = gozstd.NewDDict(dict)
+		}
+		if err != nil {
+			log.Println("Ignoring TCPINFO_ZSTD_DICT:", err)
+		}
+	})
+	return zstdDict
+}
+
+// decompress appends the decompressed src to dst.  gozstd pools its
+// decompression contexts, so this is safe and cheap to call concurrently
+// from each parser fork.
+func decompress(dst, src []byte) ([]byte, error) {
+	if dd := tcpinfoZstdDict(); dd != nil {
+		out, err := gozstd.DecompressDict(dst, src, dd)
+		if err == nil {
+			return out, nil
+		}
+		// The file may have been compressed with a different dictionary.
+	}
+	return gozstd.Decompress(dst, src)
 }
 
 // RowsInBuffer returns the count of rows currently in the buffer.
@@ -88,6 +150,17 @@ func (p *TCPInfoParser) Flush() error {
 	return p.Base.Flush()
 }
 
+// OrderIndependent implements etl.OrderIndependent.  Each test produces a
+// single independent row.
+func (p *TCPInfoParser) OrderIndependent() bool {
+	return true
+}
+
+// Fork implements etl.Forker.
+func (p *TCPInfoParser) Fork() etl.Parser {
+	return &TCPInfoParser{Base: p.Base.Fork(), table: p.table, suffix: p.suffix}
+}
+
 // IsParsable returns the canonical test type and whether to parse data.
 func (p *TCPInfoParser) IsParsable(testName string, data []byte) (string, bool) {
 	if strings.HasSuffix(testName, "jsonl.zst") {
@@ -96,16 +169,33 @@ func (p *TCPInfoParser) IsParsable(testName string, data []byte) (string, bool)
 	return "", false
 }
 
-func thinSnaps(orig []*snapshot.Snapshot) []*snapshot.Snapshot {
-	n := len(orig)
-	out := make([]*snapshot.Snapshot, 0, 1+n/10)
-	for i := 0; i < n; i += 10 {
-		out = append(out, orig[i])
+// snapChanged reports whether any of the TCP state, loss, or congestion
+// control fields differ between a and b.
+func snapChanged(a, b *snapshot.Snapshot) bool {
+	if a.CongestionAlgorithm != b.CongestionAlgorithm || (a.TCPInfo == nil) != (b.TCPInfo == nil) {
+		return true
+	}
+	if a.TCPInfo == nil {
+		return false
 	}
-	if n%10 != 0 {
-		out = append(out, orig[n-1])
+	x, y := a.TCPInfo, b.TCPInfo
+	return x.State != y.State || x.CAState != y.CAState ||
+		x.Retransmits != y.Retransmits || x.TotalRetrans != y.TotalRetrans ||
+		x.SndSsThresh != y.SndSsThresh
+}
+
+// changeIndices returns the indices of the first and last snapshots, and of
+// every snapshot that changed since the one before it.  Like web100
+// SnapLog.ChangeIndices, this selects the interesting parts of the series.
+func changeIndices(snaps []snapshot.Snapshot) []int {
+	n := len(snaps)
+	result := make([]int, 0, 100)
+	for i := 0; i < n; i++ {
+		if i == 0 || i == n-1 || snapChanged(&snaps[i-1], &snaps[i]) {
+			result = append(result, i)
+		}
 	}
-	return out
+	return result
 }
 
 // ParseAndInsert extracts all ArchivalRecords from the rawContent and inserts into a single row.
@@ -117,11 +207,16 @@ func (p *TCPInfoParser) ParseAndInsert(fileMetadata map[string]bigquery.Value, t
 
 	if strings.HasSuffix(testName, "zst") {
 		var err error
-		rawContent, err = gozstd.Decompress(nil, rawContent)
+		// The buffer is reused, as nothing references rawContent once the
+		// snapshots are decoded.
+		start := time.Now()
+		rawContent, err = decompress(p.zbuf[:0], rawContent)
+		p.ObserveStage(metrics.StageInflate, start, len(rawContent), 0)
 		if err != nil {
 			metrics.TestCount.WithLabelValues(p.TableName(), "tcpinfo", "zstd error").Inc()
 			return err
 		}
+		p.zbuf = rawContent
 	}
 
 	// This contains metadata and all snapshots from a single connection.
@@ -134,7 +229,7 @@ func (p *TCPInfoParser) ParseAndInsert(fileMetadata map[string]bigquery.Value, t
 
 	var err error
 	var rec *netlink.ArchivalRecord
-	snaps := make([]*snapshot.Snapshot, 0, 2000)
+	snaps := p.arena[:0]
 	testMetadata := netlink.Metadata{}
 	for rec, err = ar.Next(); err != io.EOF; rec, err = ar.Next() {
 		if err != nil {
@@ -149,9 +244,10 @@ func (p *TCPInfoParser) ParseAndInsert(fileMetadata map[string]bigquery.Value, t
 			testMetadata = *snapMetadata
 		}
 		if snap.Observed != 0 {
-			snaps = append(snaps, snap)
+			snaps = append(snaps, *snap)
 		}
 	}
+	p.arena = snaps
 
 	if err != io.EOF {
 		log.Println(err)
@@ -171,9 +267,14 @@ func (p *TCPInfoParser) ParseAndInsert(fileMetadata map[string]bigquery.Value, t
 	}
 
 	row := schema.TCPRow{}
-	// TODO - restore full snapshots, or implement smarter filtering.
-	row.Snapshots = thinSnaps(snaps)
-	row.FinalSnapshot = snaps[len(snaps)-1]
+	// The full series is in SnapshotDeltas, so Snapshots need only include
+	// the changes.  Row snapshots are copied out of the arena.
+	row.SnapshotDeltas = schema.EncodeSnapshotDeltas(snaps)
+	for _, i := range changeIndices(snaps) {
+		snap := snaps[i]
+		row.Snapshots = append(row.Snapshots, &snap)
+	}
+	row.FinalSnapshot = row.Snapshots[len(row.Snapshots)-1]
 	if row.FinalSnapshot.InetDiagMsg != nil {
 		row.SockID = row.FinalSnapshot.InetDiagMsg.ID.GetSockID()
 	}
@@ -209,7 +310,7 @@ func (p *TCPInfoParser) ParseAndInsert(fileMetadata map[string]bigquery.Value, t
 func NewTCPInfoParser(sink row.Sink, table, suffix string, ann v2as.Annotator) *TCPInfoParser {
 	bufSize := etl.TCPINFO.BQBufferSize()
 	if ann == nil {
-		ann = v2as.GetAnnotator(etl.BatchAnnotatorURL)
+		ann = row.CachingAnnotator(etl.BatchAnnotatorURL)
 	}
 
 	return &TCPInfoParser{
@@ -2,6 +2,7 @@ package parser_test
 
 import (
 	"archive/tar"
+	"bytes"
 	"compress/gzip"
 	"context"
 	"encoding/json"
@@ -9,11 +10,13 @@ import (
 	"io"
 	"os"
 	"path/filepath"
+	"reflect"
 	"strings"
 	"testing"
 	"time"
 
 	"github.com/go-test/deep"
+	"github.com/valyala/gozstd"
 
 	v2 "github.com/m-lab/annotation-service/api/v2"
 
@@ -25,6 +28,8 @@ import (
 	"github.com/m-lab/etl/schema"
 	"github.com/m-lab/etl/storage"
 	"github.com/m-lab/etl/task"
+	"github.com/m-lab/tcp-info/netlink"
+	"github.com/m-lab/tcp-info/snapshot"
 )
 
 func assertTCPInfoParser(in *parser.TCPInfoParser) {
@@ -246,8 +251,22 @@ func TestTCPParser(t *testing.T) {
 		t.Error("Incorrect duration calculation", duration)
 	}
 
-	if totalSnaps != 1588 {
-		t.Error("expected 1588 (thinned) snapshots, got", totalSnaps)
+	// Every snapshot is in SnapshotDeltas, and Snapshots are sampled from them.
+	deltaSnaps := 0
+	for _, r := range ins.data {
+		row, _ := r.(*schema.TCPRow)
+		all, err := schema.DecodeSnapshotDeltas(row.SnapshotDeltas, nil)
+		if err != nil {
+			t.Fatal(err)
+		}
+		if len(all) < len(row.Snapshots) || !all[len(all)-1].Timestamp.Equal(row.FinalSnapshot.Timestamp) {
+			t.Error("SnapshotDeltas do not match FinalSnapshot", len(all), len(row.Snapshots))
+		}
+		deltaSnaps += len(all)
+	}
+	t.Log("Sampled", totalSnaps, "of", deltaSnaps, "snapshots")
+	if totalSnaps < 362 || int(totalSnaps) > deltaSnaps {
+		t.Error("Bad snapshot sampling", totalSnaps, deltaSnaps)
 	}
 
 	// Verify the client and server annotations match.
@@ -263,6 +282,89 @@ func TestTCPParser(t *testing.T) {
 	}
 }
 
+// Every snapshot in the testdata archive must survive SnapshotDeltas intact.
+func TestSnapshotDeltasRoundTrip(t *testing.T) {
+	src, err := fileSource("testdata/20190516T013026.744845Z-tcpinfo-mlab4-arn02-ndt.tgz")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer src.Close()
+	files, total := 0, 0
+	for {
+		name, data, err := src.NextTest(100 * 1000 * 1000)
+		if err == io.EOF {
+			break
+		}
+		if err != nil {
+			t.Fatal(err)
+		}
+		if !strings.HasSuffix(name, ".zst") {
+			continue
+		}
+		raw, err := gozstd.Decompress(nil, data)
+		if err != nil {
+			t.Fatal(name, err)
+		}
+		snaps := []snapshot.Snapshot{}
+		ar := netlink.NewArchiveReader(bytes.NewReader(raw))
+		for rec, err := ar.Next(); err != io.EOF; rec, err = ar.Next() {
+			if err != nil {
+				t.Fatal(name, err)
+			}
+			_, snap, err := snapshot.Decode(rec)
+			if err != nil {
+				t.Fatal(name, err)
+			}
+			// Deltas are decoded in UTC.
+			snap.Timestamp = snap.Timestamp.UTC()
+			snaps = append(snaps, *snap)
+		}
+		got, err := schema.DecodeSnapshotDeltas(schema.EncodeSnapshotDeltas(snaps), nil)
+		if err != nil {
+			t.Fatal(name, err)
+		}
+		if len(got) != len(snaps) {
+			t.Fatal(name, "decoded", len(got), "of", len(snaps), "snapshots")
+		}
+		for i := range snaps {
+			if !reflect.DeepEqual(got[i], snaps[i]) {
+				t.Fatalf("%s snapshot %d does not match: %s", name, i, deep.Equal(got[i], snaps[i]))
+			}
+		}
+		files++
+		total += len(snaps)
+	}
+	if files != 364 {
+		t.Error("Expected 364 files, got", files)
+	}
+	t.Log("Round tripped", total, "snapshots")
+}
+
+func TestDecompressDict(t *testing.T) {
+	data := []byte(strings.Repeat(`{"Timestamp":"2019-05-16T01:30:26Z","Observed":1}`+"\n", 50))
+	dict := []byte(strings.Repeat(`{"Timestamp":"2019-05-16T01:30:26Z","Observed":`, 20))
+	cd, err := gozstd.NewCDict(dict)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer cd.Release()
+	withDict := gozstd.CompressDict(nil, data, cd)
+	plain := gozstd.Compress(nil, data)
+
+	t.Cleanup(parser.SaveTCPInfoZstdDictForTest())
+	if err := parser.SetTCPInfoZstdDict(dict); err != nil {
+		t.Fatal(err)
+	}
+	buf := make([]byte, 0, 10)
+	for _, compressed := range [][]byte{withDict, plain} {
+		out, err := parser.DecompressForTest(buf[:0], compressed)
+		if err != nil || string(out) != string(data) {
+			t.Error("Bad decompression", err)
+		}
+		buf = out
+	}
+}
+
 // This is a subset of TestTCPParser, but simpler, so might be useful.
 func TestTCPTask(t *testing.T) {
 	// Inject fake inserter and annotator
@@ -0,0 +1,204 @@
+package row
+
+import (
+	"container/list"
+	"context"
+	"sync"
+	"time"
+
+	"github.com/m-lab/annotation-service/api"
+	v2as "github.com/m-lab/annotation-service/api/v2"
+
+	"github.com/m-lab/etl/metrics"
+)
+
+// Annotation caching.
+//   Each flushed buffer makes one GetAnnotations request for client IPs, and
+//   another for server IPs.  The server IPs are nearly always the same few
+//   machine addresses for an entire archive, and client IPs repeat heavily
+//   across tests and tasks, so most requests are redundant.  AnnotationCache
+//   caches annotations by (IP, date) across all parsers in the process, and
+//   coalesces concurrent requests for the same IPs, so that only IPs not
+//   already cached or in flight are requested.
+
+// DefaultAnnotationCacheSize is the number of (IP, date) entries held by the
+// process wide caches returned by CachingAnnotator.
+const DefaultAnnotationCacheSize = 50000
+
+type cacheKey struct {
+	ip  string
+	day int64 // Days since the epoch, UTC.
+}
+
+type cacheEntry struct {
+	key cacheKey
+	ann *api.Annotations // nil if the service had no annotation for the IP.
+}
+
+// flight is a pending request for a set of keys.
+type flight struct {
+	done chan struct{} // Closed when the request completes.
+	err  error
+}
+
+// AnnotationCache is a v2as.Annotator that caches the annotations returned
+// by another Annotator, in a bounded LRU cache.
+// AnnotationCache is THREAD-SAFE.
+type AnnotationCache struct {
+	v2   v2as.Annotator
+	size int
+
+	lock     sync.Mutex
+	entries  map[cacheKey]*list.Element
+	lru      *list.List // Of *cacheEntry, most recently used first.
+	inFlight map[cacheKey]*flight
+}
+
+// NewAnnotationCache returns an AnnotationCache holding up to size entries
+// from ann.
+func NewAnnotationCache(ann v2as.Annotator, size int) *AnnotationCache {
+	return &AnnotationCache{
+		v2:       ann,
+		size:     size,
+		entries:  make(map[cacheKey]*list.Element, size),
+		lru:      list.New(),
+		inFlight: make(map[cacheKey]*flight),
+	}
+}
+
+var cachingAnnotators = struct {
+	lock  sync.Mutex
+	cache map[string]*AnnotationCache
+}{cache: make(map[string]*AnnotationCache, 1)}
+
+// CachingAnnotator returns the process wide AnnotationCache for the
+// annotation service at url, creating it if necessary.
+func CachingAnnotator(url string) v2as.Annotator {
+	cachingAnnotators.lock.Lock()
+	defer cachingAnnotators.lock.Unlock()
+	c, ok := cachingAnnotators.cache[url]
+	if !ok {
+		c = NewAnnotationCache(v2as.GetAnnotator(url), DefaultAnnotationCacheSize)
+		cachingAnnotators.cache[url] = c
+	}
+	return c
+}
+
+// lookup finds the cached annotations for ips, adding them to result. IPs
+// that are in flight for another request are returned as flights to wait
+// for, and others are returned as misses, and marked in flight for f.
+// MUST hold the lock.
+func (c *AnnotationCache) lookup(day int64, ips []string, result map[string]*api.Annotations, f *flight) ([]string, []*flight) {
+	var misses []string
+	var waits []*flight
+	for _, ip := range ips {
+		key := cacheKey{ip, day}
+		if _, ok := result[ip]; ok {
+			continue
+		}
+		if e, ok := c.entries[key]; ok {
+			c.lru.MoveToFront(e)
+			if ann := e.Value.(*cacheEntry).ann; ann != nil {
+				result[ip] = ann
+			}
+			continue
+		}
+		if other, ok := c.inFlight[key]; ok {
+			if other != f {
+				waits = append(waits, other)
+			}
+			continue
+		}
+		c.inFlight[key] = f
+		misses = append(misses, ip)
+	}
+	return misses, waits
+}
+
+// add caches the annotation for key, evicting the least recently used entry
+// if the cache is full.  MUST hold the lock.
+func (c *AnnotationCache) add(key cacheKey, ann *api.Annotations) {
+	if e, ok := c.entries[key]; ok {
+		e.Value.(*cacheEntry).ann = ann
+		c.lru.MoveToFront(e)
+		return
+	}
+	if c.lru.Len() >= c.size {
+		oldest := c.lru.Back()
+		delete(c.entries, oldest.Value.(*cacheEntry).key)
+		c.lru.Remove(oldest)
+	}
+	c.entries[key] = c.lru.PushFront(&cacheEntry{key, ann})
+}
+
+// GetAnnotations implements v2as.Annotator.  Only IPs that are neither
+// cached nor already requested by a concurrent call are sent to the
+// underlying Annotator.  Errors are not cached.
+func (c *AnnotationCache) GetAnnotations(ctx context.Context, date time.Time, ips []string, info ...string) (*v2as.Response, error) {
+	day := date.Unix() / (24 * 60 * 60)
+	result := make(map[string]*api.Annotations, len(ips))
+	fetched := 0
+	for {
+		f := &flight{done: make(chan struct{})}
+		c.lock.Lock()
+		misses, waits := c.lookup(day, ips, result, f)
+		c.lock.Unlock()
+
+		if len(misses) > 0 {
+			fetched += len(misses)
+			if err := c.fetch(ctx, date, day, misses, info, result, f); err != nil {
+				return nil, err
+			}
+		}
+		if len(waits) == 0 {
+			break
+		}
+		// Wait for the IPs requested by concurrent calls.  They are usually
+		// cached by the next lookup, but may have been evicted, in which
+		// case they are requested again.
+		for _, w := range waits {
+			select {
+			case <-w.done:
+			case <-ctx.Done():
+				return nil, ctx.Err()
+			}
+			if w.err != nil {
+				return nil, w.err
+			}
+		}
+	}
+
+	label := "annotation"
+	if len(info) > 0 {
+		label = info[0]
+	}
+	metrics.AnnotationCacheCount.WithLabelValues(label, "hit").Add(float64(len(ips) - fetched))
+	metrics.AnnotationCacheCount.WithLabelValues(label, "miss").Add(float64(fetched))
+	return &v2as.Response{AnnotatorDate: date, Annotations: result}, nil
+}
+
+// fetch requests the misses, which must be in flight for f, from the
+// underlying Annotator, caches the results, and completes f.
+func (c *AnnotationCache) fetch(ctx context.Context, date time.Time, day int64, misses []string, info []string, result map[string]*api.Annotations, f *flight) error {
+	response, err := c.v2.GetAnnotations(ctx, date, misses, info...)
+	if err == nil && response.Annotations == nil {
+		err = ErrAnnotationError
+	}
+	c.lock.Lock()
+	for _, ip := range misses {
+		key := cacheKey{ip, day}
+		delete(c.inFlight, key)
+		if err != nil {
+			continue
+		}
+		ann := response.Annotations[ip]
+		c.add(key, ann)
+		if ann != nil {
+			result[ip] = ann
+		}
+	}
+	c.lock.Unlock()
+	f.err = err
+	close(f.done)
+	return err
+}
@@ -0,0 +1,120 @@
+package row_test
+
+import (
+	"context"
+	"errors"
+	"sort"
+	"strings"
+	"sync"
+	"testing"
+	"time"
+
+	"github.com/m-lab/annotation-service/api"
+	v2as "github.com/m-lab/annotation-service/api/v2"
+
+	"github.com/m-lab/etl/row"
+)
+
+// countingAnnotator records each request, and annotates every IP except
+// "unknown".
+type countingAnnotator struct {
+	lock     sync.Mutex
+	requests []string
+	wait     chan struct{} // If not nil, requests block until closed.
+	err      error
+}
+
+func (ca *countingAnnotator) GetAnnotations(ctx context.Context, date time.Time, ips []string, info ...string) (*v2as.Response, error) {
+	if ca.wait != nil {
+		<-ca.wait
+	}
+	sorted := append([]string{}, ips...)
+	sort.Strings(sorted)
+	ca.lock.Lock()
+	ca.requests = append(ca.requests, strings.Join(sorted, ","))
+	ca.lock.Unlock()
+	if ca.err != nil {
+		return nil, ca.err
+	}
+	m := make(map[string]*api.Annotations, len(ips))
+	for _, ip := range ips {
+		if ip != "unknown" {
+			m[ip] = &api.Annotations{Geo: &api.GeolocationIP{City: ip}}
+		}
+	}
+	return &v2as.Response{AnnotatorDate: date, Annotations: m}, nil
+}
+
+func (ca *countingAnnotator) Requests() []string {
+	ca.lock.Lock()
+	defer ca.lock.Unlock()
+	return append([]string{}, ca.requests...)
+}
+
+func TestAnnotationCache(t *testing.T) {
+	ca := &countingAnnotator{}
+	c := row.NewAnnotationCache(ca, 3)
+	day1 := time.Date(2020, 1, 2, 3, 4, 5, 0, time.UTC)
+	day2 := day1.Add(24 * time.Hour)
+
+	resp, err := c.GetAnnotations(context.Background(), day1, []string{"a", "b", "unknown"}, "test")
+	if err != nil {
+		t.Fatal(err)
+	}
+	if len(resp.Annotations) != 2 || resp.Annotations["a"].Geo.City != "a" {
+		t.Error("Bad annotations", resp.Annotations)
+	}
+	// Same day, later in the day.  Only "c" should be requested, and the
+	// missing "unknown" annotation should also be cached.
+	resp, err = c.GetAnnotations(context.Background(), day1.Add(time.Hour), []string{"b", "unknown", "c"}, "test")
+	if err != nil {
+		t.Fatal(err)
+	}
+	if len(resp.Annotations) != 2 || resp.Annotations["c"] == nil {
+		t.Error("Bad annotations", resp.Annotations)
+	}
+	// A different day is a different key, and evicts the oldest entries.
+	c.GetAnnotations(context.Background(), day2, []string{"a"}, "test")
+	c.GetAnnotations(context.Background(), day1, []string{"a"}, "test")
+
+	want := []string{"a,b,unknown", "c", "a", "a"}
+	got := ca.Requests()
+	if strings.Join(got, " ") != strings.Join(want, " ") {
+		t.Errorf("Requests = %v, want %v", got, want)
+	}
+
+	// Errors are not cached.
+	ca.err = errors.New("failed")
+	if _, err := c.GetAnnotations(context.Background(), day1, []string{"x"}, "test"); err == nil {
+		t.Error("Expected error")
+	}
+	ca.err = nil
+	if resp, err := c.GetAnnotations(context.Background(), day1, []string{"x"}, "test"); err != nil || resp.Annotations["x"] == nil {
+		t.Error("Expected annotation", err)
+	}
+}
+
+func TestAnnotationCacheCoalescing(t *testing.T) {
+	ca := &countingAnnotator{wait: make(chan struct{})}
+	c := row.NewAnnotationCache(ca, 100)
+	day := time.Date(2020, 1, 2, 3, 4, 5, 0, time.UTC)
+
+	wg := sync.WaitGroup{}
+	for i := 0; i < 10; i++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			resp, err := c.GetAnnotations(context.Background(), day, []string{"server"}, "test")
+			if err != nil || resp.Annotations["server"] == nil {
+				t.Error("Bad response", err)
+			}
+		}()
+	}
+	// Give the goroutines time to start waiting.
+	time.Sleep(50 * time.Millisecond)
+	close(ca.wait)
+	wg.Wait()
+	if got := ca.Requests(); len(got) != 1 {
+		t.Errorf("Requests = %v, want 1 request", got)
+	}
+}
@@ -0,0 +1,80 @@
+package row
+
+import (
+	"encoding/json"
+)
+
+// Encoded is a row that has already been JSON encoded.  Encoding each row
+// once, rather than in each Sink, lets the size be known without encoding
+// again, e.g. for metrics.
+//
+// Encoded implements json.Marshaler and Sizer.
+type Encoded struct {
+	Row  interface{} // The original row.
+	JSON []byte      // The JSON encoding of Row, without a trailing newline.
+}
+
+// MarshalJSON implements json.Marshaler.
+func (e *Encoded) MarshalJSON() ([]byte, error) {
+	return e.JSON, nil
+}
+
+// Size implements Sizer.
+func (e *Encoded) Size() int {
+	return len(e.JSON)
+}
+
+// EncodedSink is an optional Sink interface, for sinks that write the JSON
+// encoding of rows.  If AcceptsEncoded returns true, Base passes each row to
+// Commit as an *Encoded.  Sinks that encode rows differently, such as the
+// BigQuery client, which uses the bigquery struct tags, should not
+// implement this.
+type EncodedSink interface {
+	AcceptsEncoded() bool
+}
+
+// Encode returns a slice of *Encoded rows.  Rows that are already *Encoded
+// are not encoded again.
+func Encode(rows []interface{}) ([]interface{}, error) {
+	out := make([]interface{}, len(rows))
+	// One backing array for all the Encoded structs.
+	encoded := make([]Encoded, len(rows))
+	for i := range rows {
+		if e, ok := rows[i].(*Encoded); ok {
+			out[i] = e
+			continue
+		}
+		j, err := json.Marshal(rows[i])
+		if err != nil {
+			return nil, err
+		}
+		encoded[i] = Encoded{Row: rows[i], JSON: j}
+		out[i] = &encoded[i]
+	}
+	return out, nil
+}
+
+// Unwrap returns rows with any *Encoded rows replaced by the original rows,
+// for sinks that do their own encoding.  It returns rows itself if there
+// are no *Encoded rows.
+func Unwrap(rows []interface{}) []interface{} {
+	var out []interface{}
+	for i := range rows {
+		e, ok := rows[i].(*Encoded)
+		if !ok {
+			if out != nil {
+				out[i] = rows[i]
+			}
+			continue
+		}
+		if out == nil {
+			out = make([]interface{}, len(rows))
+			copy(out, rows[:i])
+		}
+		out[i] = e.Row
+	}
+	if out == nil {
+		return rows
+	}
+	return out
+}
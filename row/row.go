@@ -8,6 +8,7 @@ import (
 	"errors"
 	"io"
 	"log"
+	"reflect"
 	"sync"
 	"time"
 
@@ -113,13 +114,38 @@ type Sink interface {
 	io.Closer
 }
 
+// BatchLimiter is an optional Sink interface, for sinks that limit the
+// encoded size of each Commit, e.g. the BigQuery insert payload limit.
+type BatchLimiter interface {
+	// MaxBatchBytes returns the target maximum encoded size of a Commit.
+	MaxBatchBytes() int
+}
+
+// Sizer is an optional interface for rows that know their encoded size.
+// The size of rows that do not implement Sizer is estimated from their
+// values, without encoding them.
+type Sizer interface {
+	Size() int
+}
+
+// SizeOf returns the encoded size of a row, or an upper estimate of the
+// size of its JSON encoding if it is not a Sizer.
+func SizeOf(row interface{}) int {
+	if s, ok := row.(Sizer); ok {
+		return s.Size()
+	}
+	return estimateSize(reflect.ValueOf(row))
+}
+
 // Buffer provides all basic functionality generally needed for buffering, annotating, and inserting
 // rows that implement Annotatable.
 // Buffer functions are THREAD-SAFE
 type Buffer struct {
-	lock sync.Mutex
-	size int // Number of rows before starting new buffer.
-	rows []interface{}
+	lock     sync.Mutex
+	size     int // Number of rows before starting new buffer.
+	maxBytes int // Encoded bytes before starting new buffer, or 0 for no limit.
+	bytes    int // Encoded bytes in rows, if maxBytes > 0.
+	rows     []interface{}
 }
 
 // NewBuffer returns a new buffer of the desired size.
@@ -127,19 +153,34 @@ func NewBuffer(size int) *Buffer {
 	return &Buffer{size: size, rows: make([]interface{}, 0, size)}
 }
 
+// NewSizedBuffer returns a new buffer limited to size rows, and to maxBytes of
+// encoded rows.
+func NewSizedBuffer(size int, maxBytes int) *Buffer {
+	return &Buffer{size: size, maxBytes: maxBytes, rows: make([]interface{}, 0, size)}
+}
+
 // Append appends a row to the buffer.
 // If buffer is full, this returns the buffered rows, and saves provided row
 // in new buffer.  Client MUST handle the returned rows.
+// The buffer is full if it holds size rows, or if adding the row would
+// exceed maxBytes.
 func (buf *Buffer) Append(row interface{}) []interface{} {
+	rowBytes := 0
+	if buf.maxBytes > 0 {
+		// Measure outside the lock, as this may walk a large row.
+		rowBytes = SizeOf(row)
+	}
 	buf.lock.Lock()
 	defer buf.lock.Unlock()
-	if len(buf.rows) < buf.size {
+	if len(buf.rows) < buf.size && (buf.maxBytes == 0 || len(buf.rows) == 0 || buf.bytes+rowBytes <= buf.maxBytes) {
 		buf.rows = append(buf.rows, row)
+		buf.bytes += rowBytes
 		return nil
 	}
 	rows := buf.rows
 	buf.rows = make([]interface{}, 0, buf.size)
 	buf.rows = append(buf.rows, row)
+	buf.bytes = rowBytes
 
 	return rows
 }
@@ -150,6 +191,7 @@ func (buf *Buffer) Reset() []interface{} {
 	defer buf.lock.Unlock()
 	res := buf.rows
 	buf.rows = make([]interface{}, 0, buf.size)
+	buf.bytes = 0
 	return res
 }
 
@@ -157,14 +199,16 @@ type annotator struct {
 	v2 v2as.Annotator
 }
 
+// serverAnnotations fetches the annotations for the server IPs of rows.
+// It returns nil, nil if there are no server IPs.
 // label is used to label metrics and errors in GetAnnotations
-func (ann *annotator) annotateServers(rows []interface{}, label string) error {
+func (ann *annotator) serverAnnotations(rows []interface{}, label string) (map[string]*api.Annotations, error) {
 	serverIPs := make(map[string]struct{})
 	logTime := time.Time{}
 	for i := range rows {
 		r, ok := rows[i].(Annotatable)
 		if !ok {
-			return ErrNotAnnotatable
+			return nil, ErrNotAnnotatable
 		}
 
 		// Only ask for the IP if it is non-empty.
@@ -183,23 +227,28 @@ func (ann *annotator) annotateServers(rows []interface{}, label string) error {
 		ipSlice = append(ipSlice, ip)
 	}
 	if len(ipSlice) == 0 {
-		return nil
+		return nil, nil
 	}
 	response, err := ann.v2.GetAnnotations(context.Background(), logTime, ipSlice, label)
 	if err != nil {
 		log.Println("error in server GetAnnotations: ", err)
 		metrics.AnnotationErrorCount.With(prometheus.
 			Labels{"source": "Server IP: RPC err in GetAnnotations."}).Inc()
-		return err
+		return nil, err
 	}
 	annMap := response.Annotations
 	if annMap == nil {
 		log.Println("empty server annotation response")
 		metrics.AnnotationErrorCount.With(prometheus.
 			Labels{"source": "Server IP: empty response"}).Inc()
-		return ErrAnnotationError
+		return nil, ErrAnnotationError
 	}
+	return annMap, nil
+}
 
+// annotateServers applies the server annotations to rows.
+func annotateServers(rows []interface{}, annMap map[string]*api.Annotations) error {
+	var err error
 	for i := range rows {
 		r, ok := rows[i].(Annotatable)
 		if !ok {
@@ -220,14 +269,15 @@ func (ann *annotator) annotateServers(rows []interface{}, label string) error {
 
 var logEmptyAnn = logx.NewLogEvery(nil, 60*time.Second)
 
+// clientAnnotations fetches the annotations for the client IPs of rows.
 // label is used to label metrics and errors in GetAnnotations
-func (ann *annotator) annotateClients(rows []interface{}, label string) error {
+func (ann *annotator) clientAnnotations(rows []interface{}, label string) (map[string]*api.Annotations, error) {
 	ipSlice := make([]string, 0, 2*len(rows)) // This may be inadequate, but its a reasonable start.
 	logTime := time.Time{}
 	for i := range rows {
 		r, ok := rows[i].(Annotatable)
 		if !ok {
-			return ErrNotAnnotatable
+			return nil, ErrNotAnnotatable
 		}
 		ipSlice = append(ipSlice, r.GetClientIPs()...)
 		if (logTime == time.Time{}) {
@@ -240,22 +290,27 @@ func (ann *annotator) annotateClients(rows []interface{}, label string) error {
 		log.Println("error in client GetAnnotations: ", err)
 		metrics.AnnotationErrorCount.With(prometheus.
 			Labels{"source": "Client IP: RPC err in GetAnnotations."}).Inc()
-		return err
+		return nil, err
 	}
 	annMap := response.Annotations
 	if annMap == nil {
 		logEmptyAnn.Println("empty client annotation response")
 		metrics.AnnotationErrorCount.With(prometheus.
 			Labels{"source": "Client IP: empty response"}).Inc()
-		return ErrAnnotationError
+		return nil, ErrAnnotationError
 	}
+	return annMap, nil
+}
 
+// annotateClients applies the client annotations to rows.
+func annotateClients(rows []interface{}, annMap map[string]*api.Annotations) error {
+	var err error
 	for i := range rows {
 		r, ok := rows[i].(Annotatable)
 		if !ok {
 			err = ErrNotAnnotatable
 		} else {
-			// Will not error because we check for nil annMap above.
+			// Will not error because annMap is not nil.
 			r.AnnotateClients(annMap)
 		}
 	}
@@ -263,7 +318,9 @@ func (ann *annotator) annotateClients(rows []interface{}, label string) error {
 	return err
 }
 
-// Annotate fetches and applies annotations for all rows
+// Annotate fetches and applies annotations for all rows.
+// The client and server annotations are fetched concurrently, but applied
+// sequentially, as the row methods need not be thread-safe.
 func (ann *annotator) Annotate(rows []interface{}, metricLabel string) error {
 	metrics.WorkerState.WithLabelValues(metricLabel, "annotate").Inc()
 	defer metrics.WorkerState.WithLabelValues(metricLabel, "annotate").Dec()
@@ -275,9 +332,23 @@ func (ann *annotator) Annotate(rows []interface{}, metricLabel string) error {
 		metrics.AnnotationTimeSummary.With(prometheus.Labels{"test_type": label}).Observe(float64(time.Since(start).Nanoseconds()))
 	}(metricLabel, time.Now())
 
-	// TODO Consider doing these in parallel?
-	clientErr := ann.annotateClients(rows, metricLabel)
-	serverErr := ann.annotateServers(rows, metricLabel)
+	var serverMap map[string]*api.Annotations
+	var serverErr error
+	wg := sync.WaitGroup{}
+	wg.Add(1)
+	go func() {
+		defer wg.Done()
+		serverMap, serverErr = ann.serverAnnotations(rows, metricLabel)
+	}()
+	clientMap, clientErr := ann.clientAnnotations(rows, metricLabel)
+	wg.Wait()
+
+	if clientErr == nil {
+		clientErr = annotateClients(rows, clientMap)
+	}
+	if serverErr == nil && serverMap != nil {
+		serverErr = annotateServers(rows, serverMap)
+	}
 
 	if clientErr != nil {
 		return clientErr
@@ -290,21 +361,70 @@ func (ann *annotator) Annotate(rows []interface{}, metricLabel string) error {
 	return nil
 }
 
+// MaxPendingCommits is the maximum number of full buffers that each Base
+// (or fork) annotates and commits in the background.  When this many are
+// pending, Put blocks.
+const MaxPendingCommits = 2
+
 // Base provides common parser functionality.
-// Base is NOT THREAD-SAFE
+// Put and Flush are THREAD-SAFE, as the Buffer and stats are locked, and
+// Sinks must be threadsafe.  This allows order independent parsers to
+// parse tests concurrently.
+//
+// When Put fills the buffer, the rows are annotated and committed in the
+// background, so the parser can continue while the previous buffer is
+// being annotated or uploaded.  Buffers are committed to the Sink in the
+// order they were filled.
 type Base struct {
 	sink  Sink
 	ann   annotator
 	buf   *Buffer
 	label string // Used in metrics and errors.
 
-	stats ActiveStats
+	stats  *ActiveStats        // Shared with any forks.
+	stages *metrics.TaskStages // Shared with any forks.  May be nil.
+
+	pending chan struct{} // Tokens for background commits.
+	lock    sync.Mutex    // Protects last and err.
+	last    chan struct{} // Closed when the latest submitted buffer is committed.
+	err     error         // First background commit error, not yet returned.
 }
 
 // NewBase creates a new Base.  This will generally be embedded in a type specific parser.
+// If the sink is a BatchLimiter, the buffer is also limited by encoded size.
 func NewBase(label string, sink Sink, bufSize int, ann v2as.Annotator) *Base {
 	buf := NewBuffer(bufSize)
-	return &Base{sink: sink, ann: annotator{ann}, buf: buf, label: label}
+	if bl, ok := sink.(BatchLimiter); ok {
+		buf = NewSizedBuffer(bufSize, bl.MaxBatchBytes())
+	}
+	return newBase(label, sink, buf, annotator{ann}, &ActiveStats{})
+}
+
+func newBase(label string, sink Sink, buf *Buffer, ann annotator, stats *ActiveStats) *Base {
+	return &Base{sink: sink, ann: ann, buf: buf, label: label, stats: stats,
+		pending: make(chan struct{}, MaxPendingCommits)}
+}
+
+// Fork returns a new Base, with its own buffer, that commits to the same
+// Sink and updates the same stats as pb.  Forks allow several goroutines to
+// buffer, annotate, and commit rows without contending for a single buffer.
+// Each fork must be flushed separately.
+func (pb *Base) Fork() *Base {
+	fork := newBase(pb.label, pb.sink, NewSizedBuffer(pb.buf.size, pb.buf.maxBytes), pb.ann, pb.stats)
+	fork.stages = pb.stages
+	return fork
+}
+
+// SetStages sets the TaskStages that record the annotation and commit times
+// of pb and of its subsequent forks.
+func (pb *Base) SetStages(stages *metrics.TaskStages) {
+	pb.stages = stages
+}
+
+// ObserveStage records an operation in a stage of the task, e.g. a
+// parser's decompression.  See metrics.TaskStages.Observe.
+func (pb *Base) ObserveStage(stage string, start time.Time, bytes, rows int) {
+	pb.stages.Observe(pb.label, stage, start, bytes, rows)
 }
 
 // GetStats returns the buffer/sink stats.
@@ -319,15 +439,58 @@ func (pb *Base) TaskError() error {
 
 var logAnnError = logx.NewLogEvery(nil, 60*time.Second)
 
-func (pb *Base) commit(rows []interface{}) error {
+// prepare annotates the rows, and encodes them if the sink accepts encoded
+// rows.
+func (pb *Base) prepare(rows []interface{}) ([]interface{}, error) {
+	start := time.Now()
 	err := pb.ann.Annotate(rows, pb.label)
+	pb.ObserveStage(metrics.StageAnnotate, start, 0, len(rows))
 	if err != nil {
 		logAnnError.Println("annotation: ", err)
 	}
 
-	// TODO do we need these to be done in order.
+	// Encode rows here, once they are complete, so that the encoding is done
+	// by the committing goroutine rather than serialized in the Sink.
+	if es, ok := pb.sink.(EncodedSink); ok && es.AcceptsEncoded() {
+		encoded, err := Encode(rows)
+		if err != nil {
+			metrics.BackendFailureCount.WithLabelValues(
+				pb.label, "encoding error").Inc()
+			pb.stats.Done(len(rows), err)
+			return nil, err
+		}
+		rows = encoded
+	}
+	return rows, nil
+}
+
+// sequence returns the channel closed when the previously submitted rows
+// have been committed, and a new channel that the caller MUST close when
+// its own rows have been committed.
+func (pb *Base) sequence() (prev chan struct{}, done chan struct{}) {
+	pb.lock.Lock()
+	defer pb.lock.Unlock()
+	prev = pb.last
+	done = make(chan struct{})
+	pb.last = done
+	return prev, done
+}
+
+// commit annotates rows, and then commits them once prev is closed.
+// Annotation is overlapped with any earlier commits still in progress.
+func (pb *Base) commit(prev chan struct{}, rows []interface{}) error {
+	rows, err := pb.prepare(rows)
+	if prev != nil {
+		<-prev
+	}
+	if err != nil {
+		return err
+	}
+
 	// This is synchronous, blocking, and thread safe.
+	start := time.Now()
 	done, err := pb.sink.Commit(rows, pb.label)
+	pb.ObserveStage(metrics.StageCommit, start, 0, done)
 	if done > 0 {
 		pb.stats.Done(done, nil)
 	}
@@ -338,19 +501,63 @@ func (pb *Base) commit(rows []interface{}) error {
 	return err
 }
 
-// Flush synchronously flushes any pending rows.
+// commitAsync annotates and commits rows in the background.  It blocks
+// while MaxPendingCommits commits are already pending.
+func (pb *Base) commitAsync(rows []interface{}) {
+	pb.pending <- struct{}{}
+	prev, done := pb.sequence()
+	go func() {
+		defer func() { <-pb.pending }()
+		defer close(done)
+		if err := pb.commit(prev, rows); err != nil {
+			// Note that error is likely associated with buffered rows, not the current
+			// row.
+			// When using GCS output, this may result in a corrupted json file.
+			// In that event, the test count may become meaningless.
+			metrics.TestCount.WithLabelValues(pb.label, pb.label, "error").Inc()
+			metrics.ErrorCount.WithLabelValues(
+				pb.label, "", "put error").Inc()
+			pb.lock.Lock()
+			if pb.err == nil {
+				pb.err = err
+			}
+			pb.lock.Unlock()
+		}
+	}()
+}
+
+// takeErr returns and clears any background commit error.
+func (pb *Base) takeErr() error {
+	pb.lock.Lock()
+	defer pb.lock.Unlock()
+	err := pb.err
+	pb.err = nil
+	return err
+}
+
+// Flush synchronously flushes any pending rows, and waits for any
+// background commits to complete.  It returns the error from committing
+// the pending rows, or else any unreported error from a background commit.
 func (pb *Base) Flush() error {
 	rows := pb.buf.Reset()
 	pb.stats.MoveToPending(len(rows))
-	return pb.commit(rows)
+	prev, done := pb.sequence()
+	err := pb.commit(prev, rows)
+	close(done)
+	if asyncErr := pb.takeErr(); err == nil {
+		err = asyncErr
+	}
+	return err
 }
 
 // Put adds a row to the buffer.
 // Iff the buffer is already full the prior buffered rows are
-// annotated and committed to the Sink.
+// annotated and committed to the Sink in the background.
+// The returned error is from an earlier background commit, and is likely
+// associated with earlier rows, not the current row.
 // NOTE: There is no guarantee about ordering of writes resulting from
-// sequential calls to Put.  However, once a block of rows is submitted
-// to pb.commit, it should be written in the same order to the Sink.
+// sequential calls to Put.  However, blocks of rows are committed to the
+// Sink in the order the buffer was filled.
 // TODO improve Annotatable architecture.
 func (pb *Base) Put(row Annotatable) error {
 	rows := pb.buf.Append(row)
@@ -358,19 +565,9 @@ func (pb *Base) Put(row Annotatable) error {
 
 	if rows != nil {
 		pb.stats.MoveToPending(len(rows))
-		err := pb.commit(rows)
-		if err != nil {
-			// Note that error is likely associated with buffered rows, not the current
-			// row.
-			// When using GCS output, this may result in a corrupted json file.
-			// In that event, the test count may become meaningless.
-			metrics.TestCount.WithLabelValues(pb.label, pb.label, "error").Inc()
-			metrics.ErrorCount.WithLabelValues(
-				pb.label, "", "put error").Inc()
-			return err
-		}
+		pb.commitAsync(rows)
 	}
-	return nil
+	return pb.takeErr()
 }
 
 // NullAnnotator satisfies the Annotatable interface without actually doing
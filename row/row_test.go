@@ -1,9 +1,15 @@
 package row_test
 
 import (
+	"context"
+	"encoding/json"
+	"errors"
 	"fmt"
+	"io/ioutil"
 	"net/http"
 	"net/http/httptest"
+	"strings"
+	"sync"
 	"testing"
 	"time"
 
@@ -83,15 +89,20 @@ func TestBase(t *testing.T) {
 	r2 := `{"AnnotatorDate":"2018-12-05T00:00:00Z",
 					  "Annotations":{"4.3.2.1":{"Geo":{"postal_code":"10584"}}}}`
 
+	var lock sync.Mutex
 	callCount := 0
 	ts := httptest.NewServer(http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
-		// HACKY - depends on order in which client and server are annotated
-		if callCount == 0 {
+		// Client and server are annotated concurrently, so respond based on
+		// the requested IPs.
+		body, _ := ioutil.ReadAll(r.Body)
+		if strings.Contains(string(body), "1.2.3.4") {
 			fmt.Fprint(w, r1)
 		} else {
 			fmt.Fprint(w, r2)
 		}
+		lock.Lock()
 		callCount++
+		lock.Unlock()
 	}))
 	defer func() {
 		ts.Close()
@@ -103,11 +114,15 @@ func TestBase(t *testing.T) {
 
 	// Add a row with empty server IP
 	b.Put(&Row{"1.2.3.4", "", nil, nil})
+	lock.Lock()
 	if callCount != 0 {
 		t.Error("Callcount should be 0:", callCount)
 	}
+	lock.Unlock()
 
 	b.Flush()
+	lock.Lock()
+	defer lock.Unlock()
 	if callCount != 2 {
 		t.Error("Callcount should be 2:", callCount)
 	}
@@ -137,15 +152,20 @@ func TestAsyncPut(t *testing.T) {
 	r2 := `{"AnnotatorDate":"2018-12-05T00:00:00Z",
 					  "Annotations":{"4.3.2.1":{"Geo":{"postal_code":"10584"}}}}`
 
+	var lock sync.Mutex
 	callCount := 0
 	ts := httptest.NewServer(http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
-		// HACKY - depends on order in which client and server are annotated
-		if callCount == 0 {
+		// Client and server are annotated concurrently, so respond based on
+		// the requested IPs.
+		body, _ := ioutil.ReadAll(r.Body)
+		if strings.Contains(string(body), "1.2.3.4") {
 			fmt.Fprint(w, r1)
 		} else {
 			fmt.Fprint(w, r2)
 		}
+		lock.Lock()
 		callCount++
+		lock.Unlock()
 	}))
 	defer func() {
 		ts.Close()
@@ -185,3 +205,202 @@ func TestAsyncPut(t *testing.T) {
 func assertBQInserterIsSink(in row.Sink) {
 	func(in row.Sink) {}(&bq.BQInserter{})
 }
+
+type emptyAnnotator struct{}
+
+func (ann *emptyAnnotator) GetAnnotations(ctx context.Context, date time.Time, ips []string, info ...string) (*v2as.Response, error) {
+	return &v2as.Response{AnnotatorDate: time.Now(), Annotations: map[string]*api.Annotations{}}, nil
+}
+
+func TestFork(t *testing.T) {
+	ins := &inMemorySink{}
+	b := row.NewBase("test", ins, 10, &emptyAnnotator{})
+	f := b.Fork()
+
+	b.Put(&Row{"1.2.3.4", "4.3.2.1", nil, nil})
+	f.Put(&Row{"1.2.3.4", "4.3.2.1", nil, nil})
+	f.Put(&Row{"1.2.3.4", "4.3.2.1", nil, nil})
+	if b.GetStats().Buffered != 3 {
+		t.Errorf("Expected 3 merged buffered rows, got %d", b.GetStats().Buffered)
+	}
+	b.Flush()
+	if len(ins.data) != 1 {
+		t.Errorf("Fork rows should not be flushed by the original: %d", len(ins.data))
+	}
+	f.Flush()
+	if len(ins.data) != 3 || b.GetStats().Committed != 3 {
+		t.Errorf("Expected 3 committed rows, got %d, %d", len(ins.data), b.GetStats().Committed)
+	}
+}
+
+type sizedRow struct {
+	Row
+	size int
+}
+
+func (r *sizedRow) Size() int { return r.size }
+
+func TestSizedBuffer(t *testing.T) {
+	buf := row.NewSizedBuffer(10, 1000)
+	if rows := buf.Append(&sizedRow{size: 600}); rows != nil {
+		t.Fatal("Unexpected flush")
+	}
+	if rows := buf.Append(&sizedRow{size: 300}); rows != nil {
+		t.Fatal("Unexpected flush")
+	}
+	// Exceeds the byte budget.
+	if rows := buf.Append(&sizedRow{size: 200}); len(rows) != 2 {
+		t.Fatal("Expected 2 rows: ", len(rows))
+	}
+	// A single oversize row is still accepted.
+	if rows := buf.Append(&sizedRow{size: 5000}); len(rows) != 1 {
+		t.Fatal("Expected 1 row: ", len(rows))
+	}
+	if rows := buf.Reset(); len(rows) != 1 {
+		t.Fatal("Expected 1 row: ", len(rows))
+	}
+	// The row count limit still applies.
+	for i := 0; i < 10; i++ {
+		if rows := buf.Append(&sizedRow{size: 1}); rows != nil {
+			t.Fatal("Unexpected flush")
+		}
+	}
+	if rows := buf.Append(&sizedRow{size: 1}); len(rows) != 10 {
+		t.Fatal("Expected 10 rows: ", len(rows))
+	}
+}
+
+type estimatedInner struct {
+	Port  int64
+	Flags []string
+}
+
+type estimatedRow struct {
+	estimatedInner
+	ID      string            `json:"id"`
+	Omitted string            `json:"-"`
+	Time    time.Time         `json:"time"`
+	IP      []byte            `json:"ip,omitempty"`
+	Count   uint32            `json:"count"`
+	Neg     int               `json:"neg"`
+	RTT     float64           `json:"rtt"`
+	Inner   *estimatedInner   `json:"inner"`
+	Nil     *estimatedInner   `json:"nil"`
+	Labels  map[string]string `json:"labels"`
+	private int
+}
+
+func TestSizeOfEstimate(t *testing.T) {
+	r := &estimatedRow{
+		estimatedInner: estimatedInner{Port: 443, Flags: []string{"a", "bc"}},
+		ID:             "ndt-abcdef_1234",
+		Omitted:        strings.Repeat("x", 1000),
+		Time:           time.Date(2021, 1, 2, 3, 4, 5, 6, time.UTC),
+		IP:             []byte{192, 168, 0, 1},
+		Count:          12345,
+		Neg:            -42,
+		RTT:            0.125,
+		Inner:          &estimatedInner{Port: 80},
+		Labels:         map[string]string{"k": "v"},
+	}
+	j, err := json.Marshal(r)
+	if err != nil {
+		t.Fatal(err)
+	}
+	// The estimate must not be less than the encoding, but should be close.
+	if n := row.SizeOf(r); n < len(j) || n > 2*len(j) {
+		t.Errorf("SizeOf() = %d, want about %d: %s", n, len(j), j)
+	}
+	if n := row.SizeOf(&sizedRow{size: 7}); n != 7 {
+		t.Errorf("SizeOf(Sizer) = %d, want 7", n)
+	}
+}
+
+type jsonRow struct {
+	Row
+	Name string `json:"name"`
+}
+
+type encodedSink struct {
+	inMemorySink
+}
+
+func (es *encodedSink) AcceptsEncoded() bool { return true }
+
+func TestEncodedCommit(t *testing.T) {
+	es := &encodedSink{}
+	b := row.NewBase("test", es, 10, &emptyAnnotator{})
+	b.Put(&jsonRow{Name: "foo"})
+	b.Put(&jsonRow{Name: "bar"})
+	b.Flush()
+	if len(es.data) != 2 {
+		t.Fatal("Expected 2 rows: ", len(es.data))
+	}
+	e, ok := es.data[1].(*row.Encoded)
+	if !ok {
+		t.Fatalf("Expected *row.Encoded, got %T", es.data[1])
+	}
+	if string(e.JSON) != `{"name":"bar"}` || e.Size() != len(e.JSON) {
+		t.Error("Bad encoding: ", string(e.JSON))
+	}
+	rows := row.Unwrap(es.data)
+	if rows[0].(*jsonRow).Name != "foo" {
+		t.Error("Unwrap failed")
+	}
+}
+
+// blockingSink blocks each Commit until release is closed, and may fail.
+type blockingSink struct {
+	inMemorySink
+	release chan struct{}
+	err     error
+}
+
+func (bs *blockingSink) Commit(data []interface{}, label string) (int, error) {
+	<-bs.release
+	if bs.err != nil {
+		return 0, bs.err
+	}
+	return bs.inMemorySink.Commit(data, label)
+}
+
+func TestPutDoesNotWaitForCommit(t *testing.T) {
+	bs := &blockingSink{release: make(chan struct{})}
+	b := row.NewBase("test", bs, 1, &emptyAnnotator{})
+	// Each Put after the first fills the buffer, and MaxPendingCommits
+	// commits may proceed in the background.
+	for i := 0; i <= row.MaxPendingCommits; i++ {
+		if err := b.Put(&Row{fmt.Sprint(i), "", nil, nil}); err != nil {
+			t.Fatal(err)
+		}
+	}
+	if b.GetStats().Committed != 0 {
+		t.Error("Nothing should be committed yet")
+	}
+	close(bs.release)
+	if err := b.Flush(); err != nil {
+		t.Fatal(err)
+	}
+	if len(bs.data) != row.MaxPendingCommits+1 {
+		t.Fatal("Expected all rows committed: ", len(bs.data))
+	}
+	// Buffers are committed in order.
+	for i := range bs.data {
+		if bs.data[i].(*Row).client != fmt.Sprint(i) {
+			t.Error("Out of order: ", i, bs.data[i].(*Row).client)
+		}
+	}
+
+	// Background errors are reported by a later call.
+	bs = &blockingSink{release: make(chan struct{}), err: errors.New("failed")}
+	close(bs.release)
+	b = row.NewBase("test", bs, 1, &emptyAnnotator{})
+	b.Put(&Row{"1", "", nil, nil})
+	putErr := b.Put(&Row{"2", "", nil, nil})
+	if err := b.Flush(); err == nil && putErr == nil {
+		t.Error("Expected error")
+	}
+	if b.GetStats().Failed != 2 {
+		t.Error("Expected 2 failed rows: ", b.GetStats().Failed)
+	}
+}
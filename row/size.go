@@ -0,0 +1,208 @@
+package row
+
+import (
+	"encoding/json"
+	"reflect"
+	"strings"
+	"sync"
+	"time"
+)
+
+// Size estimates.
+//   Buffers for sinks with a BatchLimiter measure every row, but the
+//   BigQuery client encodes rows itself, so JSON encoding each row just to
+//   measure it would double the encoding work.  Instead, rows that are not
+//   Sizers are measured by walking their values, and adding up the length
+//   of the JSON encoding of each field.  The estimate errs on the high side,
+//   e.g. it ignores omitempty, and counts []byte, such as net.IP, as base64.
+//   Nested values that are Sizers, such as web100.Columns, report their own
+//   size, and other json.Marshalers are encoded.
+
+var (
+	timeType      = reflect.TypeOf(time.Time{})
+	sizerType     = reflect.TypeOf((*Sizer)(nil)).Elem()
+	marshalerType = reflect.TypeOf((*json.Marshaler)(nil)).Elem()
+)
+
+// maxTimeLen is the length of a quoted RFC 3339 time with nanoseconds.
+const maxTimeLen = len(`"2006-01-02T15:04:05.999999999+07:00"`)
+
+// sizeField describes how a struct field is encoded, for estimating sizes.
+type sizeField struct {
+	index   int
+	nameLen int  // Length of the quoted key and colon, or 0 for embedded structs.
+	inline  bool // Embedded struct fields are encoded in the outer object.
+}
+
+// sizeFields caches the []sizeField for each struct type.
+var sizeFields sync.Map
+
+// fieldsOf returns the encoded fields of the struct type t.
+func fieldsOf(t reflect.Type) []sizeField {
+	if f, ok := sizeFields.Load(t); ok {
+		return f.([]sizeField)
+	}
+	fields := make([]sizeField, 0, t.NumField())
+	for i := 0; i < t.NumField(); i++ {
+		sf := t.Field(i)
+		tag := sf.Tag.Get("json")
+		if tag == "-" {
+			continue
+		}
+		name := tag
+		if comma := strings.IndexByte(tag, ','); comma >= 0 {
+			name = tag[:comma]
+		}
+		ft := sf.Type
+		if ft.Kind() == reflect.Ptr {
+			ft = ft.Elem()
+		}
+		if sf.Anonymous && name == "" && ft.Kind() == reflect.Struct && ft != timeType {
+			fields = append(fields, sizeField{index: i, inline: true})
+			continue
+		}
+		if sf.PkgPath != "" {
+			continue // unexported
+		}
+		if name == "" {
+			name = sf.Name
+		}
+		fields = append(fields, sizeField{index: i, nameLen: len(name) + 3})
+	}
+	sizeFields.Store(t, fields)
+	return fields
+}
+
+// sizeMethod is how a type reports its own size, if it does.
+type sizeMethod int
+
+const (
+	noSizeMethod sizeMethod = iota
+	sizerMethod
+	marshalerMethod
+)
+
+// sizeMethods caches the sizeMethod of each pointer and struct type.
+var sizeMethods sync.Map
+
+// customSize returns the size reported by v, if it is a Sizer, or the length
+// of its encoding, if it is a json.Marshaler.
+func customSize(v reflect.Value) (int, bool) {
+	t := v.Type()
+	m, ok := sizeMethods.Load(t)
+	if !ok {
+		switch {
+		case t.Implements(sizerType):
+			m = sizerMethod
+		case t.Implements(marshalerType):
+			m = marshalerMethod
+		default:
+			m = noSizeMethod
+		}
+		sizeMethods.Store(t, m)
+	}
+	if m == noSizeMethod || !v.CanInterface() {
+		return 0, false
+	}
+	if m == sizerMethod {
+		return v.Interface().(Sizer).Size(), true
+	}
+	b, err := v.Interface().(json.Marshaler).MarshalJSON()
+	if err != nil {
+		return 0, false
+	}
+	return len(b), true
+}
+
+// estimateSize returns an upper estimate of the length of the JSON encoding
+// of v.
+func estimateSize(v reflect.Value) int {
+	switch v.Kind() {
+	case reflect.Ptr, reflect.Interface:
+		if v.IsNil() {
+			return len("null")
+		}
+		if v.Kind() == reflect.Ptr {
+			if n, ok := customSize(v); ok {
+				return n
+			}
+		}
+		return estimateSize(v.Elem())
+	case reflect.Struct:
+		if v.Type() == timeType {
+			return maxTimeLen
+		}
+		if n, ok := customSize(v); ok {
+			return n
+		}
+		return len("{}") + estimateFields(v)
+	case reflect.String:
+		return len(v.String()) + 2
+	case reflect.Bool:
+		return len("false")
+	case reflect.Int, reflect.Int8, reflect.Int16, reflect.Int32, reflect.Int64:
+		n := v.Int()
+		if n < 0 {
+			return 1 + digits(uint64(-n))
+		}
+		return digits(uint64(n))
+	case reflect.Uint, reflect.Uint8, reflect.Uint16, reflect.Uint32, reflect.Uint64, reflect.Uintptr:
+		return digits(v.Uint())
+	case reflect.Float32, reflect.Float64:
+		return 24
+	case reflect.Slice, reflect.Array:
+		if v.Kind() == reflect.Slice && v.IsNil() {
+			return len("null")
+		}
+		if v.Type().Elem().Kind() == reflect.Uint8 {
+			return (v.Len()+2)/3*4 + 2 // base64
+		}
+		n := len("[]")
+		for i := 0; i < v.Len(); i++ {
+			n += estimateSize(v.Index(i)) + 1
+		}
+		return n
+	case reflect.Map:
+		if v.IsNil() {
+			return len("null")
+		}
+		n := len("{}")
+		it := v.MapRange()
+		for it.Next() {
+			n += estimateSize(it.Key()) + estimateSize(it.Value()) + 4
+		}
+		return n
+	}
+	return 0
+}
+
+// estimateFields returns the estimated size of the fields of struct v,
+// including separators, but not the enclosing braces.
+func estimateFields(v reflect.Value) int {
+	n := 0
+	for _, f := range fieldsOf(v.Type()) {
+		fv := v.Field(f.index)
+		if !f.inline {
+			n += f.nameLen + estimateSize(fv) + 1
+			continue
+		}
+		if fv.Kind() == reflect.Ptr {
+			if fv.IsNil() {
+				continue
+			}
+			fv = fv.Elem()
+		}
+		n += estimateFields(fv)
+	}
+	return n
+}
+
+// digits returns the number of decimal digits in n.
+func digits(n uint64) int {
+	d := 1
+	for n >= 10 {
+		n /= 10
+		d++
+	}
+	return d
+}
@@ -60,7 +60,11 @@ type TCPRow struct {
 
 	FinalSnapshot *snapshot.Snapshot
 
-	Snapshots []*snapshot.Snapshot
+	// Snapshots are sampled where the TCP state changes.  SnapshotDeltas
+	// holds all snapshots, see EncodeSnapshotDeltas.  It is a BYTES column,
+	// which existing tables gain when updated by cmd/update-schema.
+	Snapshots      []*snapshot.Snapshot
+	SnapshotDeltas []byte
 
 	// ServerX and ClientX are for the synthetic UUID annotator export process.
 	ServerX annotator.ServerAnnotations
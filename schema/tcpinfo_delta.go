@@ -0,0 +1,414 @@
+package schema
+
+import (
+	"bytes"
+	"encoding/binary"
+	"errors"
+	"hash/fnv"
+	"log"
+	"math"
+	"reflect"
+	"sync"
+	"time"
+
+	"github.com/m-lab/tcp-info/snapshot"
+)
+
+// Snapshot deltas.
+//   TCPRow.SnapshotDeltas holds the complete series of snapshots for a
+//   connection, in a compact binary form that is far smaller than the
+//   repeated Snapshot records.  The Snapshot struct is flattened into
+//   columns, one for each scalar field, and one for each pointer indicating
+//   whether it is nil.  Each snapshot is then encoded as the columns that
+//   changed since the previous snapshot.
+//
+//   Format:
+//     version byte, uvarint layout hash, uvarint column count,
+//     uvarint snapshot count, then for each snapshot:
+//       a bitmap of the changed columns, (column count + 7)/8 bytes, and
+//       for each changed column, in column order:
+//         numeric columns: zigzag uvarint of the difference from the
+//           previous value
+//         string columns: uvarint length, and the new value
+//   All columns start from zero, or the empty string.  Numeric columns are
+//   bools, integers, floats (as their bits) and times (as unix nanoseconds).
+//   Byte arrays are string columns.  A pointer to a scalar is a pointer
+//   column, followed by a column for the value.  Fields of other types are
+//   not encoded.  Times are decoded in UTC.
+
+const snapshotDeltasVersion = 1
+
+// ErrBadSnapshotDeltas is returned when deltas are corrupt, or were encoded
+// with a different Snapshot layout.
+var ErrBadSnapshotDeltas = errors.New("bad snapshot deltas")
+
+// deltaColumn is a single scalar field, or pointer, within the struct.
+type deltaColumn struct {
+	name    string
+	group   int   // The group containing the field.
+	index   []int // Field indices within the group's value.
+	kind    reflect.Kind
+	isTime  bool
+	isBytes bool
+	inner   int // For pointers, the group of the value pointed to.
+}
+
+// deltaLayout is the flattened column layout of a struct type.  Fields are
+// grouped by the pointer they are reached through, so each column is found
+// from its group's value with a few Field calls, rather than by walking
+// from the root.  Group 0 is the root, and every pointer column precedes
+// the columns of its inner group.
+type deltaLayout struct {
+	columns []deltaColumn
+	groups  int
+	hash    uint64
+}
+
+var deltaLayouts sync.Map // Compiled *deltaLayout, by reflect.Type.
+
+var timeType = reflect.TypeOf(time.Time{})
+
+// zeroTime represents time.Time{}, for which UnixNano is not defined.
+const zeroTime = math.MinInt64
+
+func deltaLayoutOf(t reflect.Type) *deltaLayout {
+	if dl, ok := deltaLayouts.Load(t); ok {
+		return dl.(*deltaLayout)
+	}
+	dl := &deltaLayout{groups: 1}
+	dl.flatten(t, "", 0, nil, map[reflect.Type]bool{})
+	h := fnv.New64a()
+	for i := range dl.columns {
+		h.Write([]byte(dl.columns[i].name))
+		h.Write([]byte{byte(dl.columns[i].kind)})
+	}
+	dl.hash = h.Sum64()
+	actual, _ := deltaLayouts.LoadOrStore(t, dl)
+	return actual.(*deltaLayout)
+}
+
+// flatten appends the columns for the fields of struct type t, at index
+// within group.
+func (dl *deltaLayout) flatten(t reflect.Type, prefix string, group int, index []int, active map[reflect.Type]bool) {
+	active[t] = true
+	defer delete(active, t)
+	for i := 0; i < t.NumField(); i++ {
+		f := t.Field(i)
+		if f.PkgPath != "" {
+			continue // Unexported.
+		}
+		dl.add(f.Type, prefix+f.Name, group, append(append([]int{}, index...), i), active)
+	}
+}
+
+// add appends the columns for a value of type t, at index within group.
+func (dl *deltaLayout) add(t reflect.Type, name string, group int, index []int, active map[reflect.Type]bool) {
+	col := deltaColumn{name: name, group: group, index: index, kind: t.Kind()}
+	switch {
+	case t.Kind() == reflect.Ptr:
+		if active[t.Elem()] {
+			log.Println("Snapshot deltas do not include", name)
+			return
+		}
+		col.inner = dl.groups
+		dl.groups++
+		dl.columns = append(dl.columns, col)
+		if t.Elem().Kind() == reflect.Struct && t.Elem() != timeType {
+			dl.flatten(t.Elem(), name+".", col.inner, nil, active)
+		} else {
+			dl.add(t.Elem(), name+".*", col.inner, nil, active)
+		}
+		return
+	case t == timeType:
+		col.isTime = true
+	case t.Kind() == reflect.Struct:
+		dl.flatten(t, name+".", group, index, active)
+		return
+	case t.Kind() == reflect.String:
+		col.isBytes = true
+	case t.Kind() == reflect.Array && t.Elem().Kind() == reflect.Uint8:
+		col.isBytes = true
+	case t.Kind() == reflect.Slice && t.Elem().Kind() == reflect.Uint8:
+		col.isBytes = true
+	case t.Kind() >= reflect.Bool && t.Kind() <= reflect.Float64:
+	default:
+		log.Println("Snapshot deltas do not include", name)
+		return
+	}
+	dl.columns = append(dl.columns, col)
+}
+
+// field returns the value of col within its group's value.
+func (col *deltaColumn) field(group reflect.Value) reflect.Value {
+	for _, i := range col.index {
+		group = group.Field(i)
+	}
+	return group
+}
+
+// timeOf returns the addressable time.Time v, without copying it to an
+// interface.
+func timeOf(v reflect.Value) *time.Time {
+	return v.Addr().Interface().(*time.Time)
+}
+
+// number returns the numeric column value of v.
+func (col *deltaColumn) number(v reflect.Value) int64 {
+	if col.isTime {
+		t := timeOf(v)
+		if t.IsZero() {
+			return zeroTime
+		}
+		return t.UnixNano()
+	}
+	switch col.kind {
+	case reflect.Ptr:
+		if v.IsNil() {
+			return 0
+		}
+		return 1
+	case reflect.Bool:
+		if v.Bool() {
+			return 1
+		}
+		return 0
+	case reflect.Int, reflect.Int8, reflect.Int16, reflect.Int32, reflect.Int64:
+		return v.Int()
+	case reflect.Float32:
+		return int64(math.Float32bits(float32(v.Float())))
+	case reflect.Float64:
+		return int64(math.Float64bits(v.Float()))
+	default:
+		return int64(v.Uint())
+	}
+}
+
+// setNumber sets v to the numeric column value n.
+func (col *deltaColumn) setNumber(v reflect.Value, n int64) {
+	if col.isTime {
+		if n == zeroTime {
+			*timeOf(v) = time.Time{}
+		} else {
+			*timeOf(v) = time.Unix(0, n).UTC()
+		}
+		return
+	}
+	switch col.kind {
+	case reflect.Bool:
+		v.SetBool(n != 0)
+	case reflect.Int, reflect.Int8, reflect.Int16, reflect.Int32, reflect.Int64:
+		v.SetInt(n)
+	case reflect.Float32:
+		v.SetFloat(float64(math.Float32frombits(uint32(n))))
+	case reflect.Float64:
+		v.SetFloat(math.Float64frombits(uint64(n)))
+	default:
+		v.SetUint(uint64(n))
+	}
+}
+
+// sameBytes returns whether the byte array v holds b.  Arrays are compared
+// by element, as slicing an array value allocates.
+func sameBytes(v reflect.Value, b []byte) bool {
+	if v.Len() != len(b) {
+		return false
+	}
+	for j := range b {
+		if byte(v.Index(j).Uint()) != b[j] {
+			return false
+		}
+	}
+	return true
+}
+
+// setBytes sets v to the string column value s.
+func setBytes(v reflect.Value, s string) {
+	switch v.Kind() {
+	case reflect.String:
+		v.SetString(s)
+	case reflect.Slice:
+		if s != "" {
+			v.SetBytes([]byte(s))
+		}
+	default:
+		for j := 0; j < len(s) && j < v.Len(); j++ {
+			v.Index(j).SetUint(uint64(s[j]))
+		}
+	}
+}
+
+func appendUvarint(b []byte, x uint64) []byte {
+	var buf [binary.MaxVarintLen64]byte
+	return append(b, buf[:binary.PutUvarint(buf[:], x)]...)
+}
+
+func appendVarint(b []byte, x int64) []byte {
+	var buf [binary.MaxVarintLen64]byte
+	return append(b, buf[:binary.PutVarint(buf[:], x)]...)
+}
+
+// encode appends the deltas for the structs in the slice rows.
+func (dl *deltaLayout) encode(b []byte, rows reflect.Value) []byte {
+	n := len(dl.columns)
+	b = append(b, snapshotDeltasVersion)
+	b = appendUvarint(b, dl.hash)
+	b = appendUvarint(b, uint64(n))
+	b = appendUvarint(b, uint64(rows.Len()))
+	nums := make([]int64, n)
+	prev := make([][]byte, n) // Previous string column values.
+	groups := make([]reflect.Value, dl.groups)
+	for r := 0; r < rows.Len(); r++ {
+		for g := range groups {
+			groups[g] = reflect.Value{}
+		}
+		groups[0] = rows.Index(r)
+		bitmap := len(b)
+		b = append(b, make([]byte, (n+7)/8)...)
+		for i := range dl.columns {
+			col := &dl.columns[i]
+			if !groups[col.group].IsValid() {
+				continue // Nil parent, so leave the value unchanged.
+			}
+			v := col.field(groups[col.group])
+			if col.isBytes {
+				switch v.Kind() {
+				case reflect.String:
+					s := v.String()
+					if s == string(prev[i]) {
+						continue
+					}
+					prev[i] = append(prev[i][:0], s...)
+				case reflect.Slice:
+					s := v.Bytes()
+					if bytes.Equal(s, prev[i]) {
+						continue
+					}
+					prev[i] = append(prev[i][:0], s...)
+				default:
+					if sameBytes(v, prev[i]) {
+						continue
+					}
+					prev[i] = prev[i][:0]
+					for j := 0; j < v.Len(); j++ {
+						prev[i] = append(prev[i], byte(v.Index(j).Uint()))
+					}
+				}
+				b[bitmap+i/8] |= 1 << uint(i%8)
+				b = appendUvarint(b, uint64(len(prev[i])))
+				b = append(b, prev[i]...)
+				continue
+			}
+			if col.kind == reflect.Ptr && !v.IsNil() {
+				groups[col.inner] = v.Elem()
+			}
+			x := col.number(v)
+			if x == nums[i] {
+				continue
+			}
+			b[bitmap+i/8] |= 1 << uint(i%8)
+			b = appendVarint(b, x-nums[i])
+			nums[i] = x
+		}
+	}
+	return b
+}
+
+// decode appends the structs decoded from b to the slice pointed to by rows.
+func (dl *deltaLayout) decode(b []byte, rows reflect.Value) error {
+	uvarint := func() uint64 {
+		x, k := binary.Uvarint(b)
+		if k <= 0 {
+			b = nil
+			return 0
+		}
+		b = b[k:]
+		return x
+	}
+	if len(b) == 0 || b[0] != snapshotDeltasVersion {
+		return ErrBadSnapshotDeltas
+	}
+	b = b[1:]
+	n := len(dl.columns)
+	if uvarint() != dl.hash || uvarint() != uint64(n) {
+		return ErrBadSnapshotDeltas
+	}
+	count := uvarint()
+	if b == nil || count > uint64(len(b)) {
+		return ErrBadSnapshotDeltas
+	}
+	nums := make([]int64, n)
+	strs := make([]string, n)
+	groups := make([]reflect.Value, dl.groups)
+	slice := rows.Elem()
+	first := slice.Len()
+	slice = reflect.AppendSlice(slice, reflect.MakeSlice(slice.Type(), int(count), int(count)))
+	for r := 0; r < int(count); r++ {
+		if len(b) < (n+7)/8 {
+			return ErrBadSnapshotDeltas
+		}
+		bitmap := b[:(n+7)/8]
+		b = b[len(bitmap):]
+		for i := range dl.columns {
+			if bitmap[i/8]&(1<<uint(i%8)) == 0 {
+				continue
+			}
+			if dl.columns[i].isBytes {
+				k := uvarint()
+				if b == nil || k > uint64(len(b)) {
+					return ErrBadSnapshotDeltas
+				}
+				strs[i] = string(b[:k])
+				b = b[k:]
+				continue
+			}
+			d, k := binary.Varint(b)
+			if k <= 0 {
+				return ErrBadSnapshotDeltas
+			}
+			b = b[k:]
+			nums[i] += d
+		}
+
+		for g := range groups {
+			groups[g] = reflect.Value{}
+		}
+		groups[0] = slice.Index(first + r)
+		for i := range dl.columns {
+			col := &dl.columns[i]
+			if !groups[col.group].IsValid() {
+				continue
+			}
+			f := col.field(groups[col.group])
+			switch {
+			case col.kind == reflect.Ptr:
+				if nums[i] != 0 {
+					f.Set(reflect.New(f.Type().Elem()))
+					groups[col.inner] = f.Elem()
+				}
+			case col.isBytes:
+				setBytes(f, strs[i])
+			default:
+				col.setNumber(f, nums[i])
+			}
+		}
+	}
+	if len(b) != 0 {
+		return ErrBadSnapshotDeltas
+	}
+	rows.Elem().Set(slice)
+	return nil
+}
+
+var snapshotType = reflect.TypeOf(snapshot.Snapshot{})
+
+// EncodeSnapshotDeltas returns the compact encoding of the snapshot series.
+func EncodeSnapshotDeltas(snaps []snapshot.Snapshot) []byte {
+	return deltaLayoutOf(snapshotType).encode(nil, reflect.ValueOf(snaps))
+}
+
+// DecodeSnapshotDeltas appends the snapshots encoded by EncodeSnapshotDeltas
+// to snaps, and returns the extended slice.
+func DecodeSnapshotDeltas(b []byte, snaps []snapshot.Snapshot) ([]snapshot.Snapshot, error) {
+	err := deltaLayoutOf(snapshotType).decode(b, reflect.ValueOf(&snaps))
+	return snaps, err
+}
@@ -3,6 +3,7 @@ package schema_test
 import (
 	"archive/tar"
 	"compress/gzip"
+	"encoding/json"
 	"errors"
 	"io"
 	"os"
@@ -104,3 +105,60 @@ func TestBQSaver(t *testing.T) {
 		t.Fatal("problem with idm")
 	}
 }
+
+func TestTCPRowSchema(t *testing.T) {
+	row := &schema.TCPRow{}
+	sch, err := row.Schema()
+	if err != nil {
+		t.Fatal(err)
+	}
+	for _, f := range sch {
+		if f.Name != "SnapshotDeltas" {
+			continue
+		}
+		if f.Type != bigquery.BytesFieldType || f.Repeated || f.Description == "" {
+			t.Errorf("SnapshotDeltas = %+v, want a described BYTES column", f)
+		}
+		return
+	}
+	t.Error("Schema() has no SnapshotDeltas column")
+}
+
+func TestSnapshotDeltas(t *testing.T) {
+	start := time.Date(2019, 5, 16, 1, 30, 26, 0, time.UTC)
+	snaps := make([]snapshot.Snapshot, 100)
+	for i := range snaps {
+		snaps[i].Timestamp = start.Add(time.Duration(i) * 10 * time.Millisecond)
+		snaps[i].Observed = 1
+		snaps[i].CongestionAlgorithm = "cubic"
+		if i%10 != 5 {
+			snaps[i].InetDiagMsg = &inetdiag.InetDiagMsg{}
+			snaps[i].InetDiagMsg.ID.IDiagSPort[1] = byte(i / 30)
+		}
+	}
+	b := schema.EncodeSnapshotDeltas(snaps)
+	got, err := schema.DecodeSnapshotDeltas(b, nil)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if !reflect.DeepEqual(got, snaps) {
+		t.Error("Snapshots do not match after decoding")
+	}
+	sample, _ := json.Marshal(snaps[0])
+	if len(b) > len(sample)*5 {
+		t.Error("Deltas for 100 snapshots are larger than 5 snapshot records:", len(b), len(sample))
+	}
+	if _, err := schema.DecodeSnapshotDeltas(b[:len(b)-1], nil); err != schema.ErrBadSnapshotDeltas {
+		t.Error("Expected ErrBadSnapshotDeltas for truncated deltas:", err)
+	}
+
+	// Encoding allocates for the series, not for each snapshot or column.
+	long := make([]snapshot.Snapshot, 0, 10*len(snaps))
+	for i := 0; i < 10; i++ {
+		long = append(long, snaps...)
+	}
+	short := testing.AllocsPerRun(10, func() { schema.EncodeSnapshotDeltas(snaps) })
+	if n := testing.AllocsPerRun(10, func() { schema.EncodeSnapshotDeltas(long) }); n > short+10 {
+		t.Error("Encoding allocates per snapshot:", short, n)
+	}
+}
@@ -7,9 +7,9 @@ import (
 	"log"
 
 	"cloud.google.com/go/bigquery"
-)
 
-// TODO(prod): Create a struct that satisfies the web100.Saver interface?
+	"github.com/m-lab/etl/web100"
+)
 
 // Web100ValueMap implements the web100.Saver interface for recording web100 values.
 type Web100ValueMap map[string]bigquery.Value
@@ -267,7 +267,9 @@ func EmptyGeolocation() Web100ValueMap {
 
 // NewWeb100MinimalRecord creates a web100 value map with only the given fields.
 // All undefined fields will be set to null after a BQ insert.
-func NewWeb100MinimalRecord(version string, logTime int64, connSpec, snapValues Web100ValueMap, deltas []Web100ValueMap) Web100ValueMap {
+// The deltas are kept in columnar form, and encoded directly to JSON by
+// either the BigQuery or GCS sink.
+func NewWeb100MinimalRecord(version string, logTime int64, connSpec, snapValues Web100ValueMap, deltas *web100.Columns) Web100ValueMap {
 	return Web100ValueMap{
 		"anomalies": Web100ValueMap{},
 		"web100_log_entry": Web100ValueMap{
@@ -0,0 +1,469 @@
+package storage
+
+import (
+	"bytes"
+	"compress/flate"
+	"crypto/rand"
+	"encoding/binary"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"io"
+	"log"
+	"math"
+	"reflect"
+	"strings"
+	"sync"
+	"time"
+
+	"cloud.google.com/go/civil"
+
+	"github.com/m-lab/etl/metrics"
+	"github.com/m-lab/etl/row"
+)
+
+// Avro output.
+//   AvroWriter writes rows to an Avro object container file, with a schema
+//   derived from the Go type of the rows, using the bigquery struct tags for
+//   field names.  Rows are buffered into blocks of about avroBlockSize
+//   bytes, and each block is deflate compressed.  BigQuery loads these files
+//   directly, and they are far smaller than the equivalent JSONL, as field
+//   names appear only once, in the schema.
+//
+//   Schema mapping:
+//     bool -> boolean, integers -> long, float32 -> float, float64 -> double
+//     string -> string, []byte and [N]byte -> bytes
+//     time.Time -> timestamp-micros, civil.Date -> date
+//     struct -> record, slice and array -> array, map[string]T -> map
+//     pointer fields -> union of null and the element type
+//   Pointers within arrays and maps are encoded as their zero value if nil,
+//   as BigQuery does not allow null array elements.  Interface types are
+//   not supported.
+
+// avroBlockSize is the approximate uncompressed size of each block.
+const avroBlockSize = 1024 * 1024
+
+// ErrUnsupportedType is returned for rows that cannot be encoded as Avro.
+var ErrUnsupportedType = errors.New("type not supported for avro output")
+
+// avroEncoder appends the Avro binary encoding of v to b.
+type avroEncoder func(b []byte, v reflect.Value) []byte
+
+// avroType is the compiled schema and encoder for a Go type.
+type avroType struct {
+	schema json.RawMessage
+	encode avroEncoder
+}
+
+var avroTypes sync.Map // Compiled *avroType, by reflect.Type.
+
+// avroCompiler compiles a single top level type.  Each named record is
+// defined once, and referenced by name thereafter.
+type avroCompiler struct {
+	names  map[reflect.Type]string
+	active map[reflect.Type]bool // For detecting recursive types.
+	used   map[string]int
+}
+
+func avroTypeOf(t reflect.Type) (*avroType, error) {
+	if at, ok := avroTypes.Load(t); ok {
+		return at.(*avroType), nil
+	}
+	c := avroCompiler{names: map[reflect.Type]string{}, active: map[reflect.Type]bool{}, used: map[string]int{}}
+	schema, enc, err := c.compile(t)
+	if err != nil {
+		return nil, err
+	}
+	b, err := json.Marshal(schema)
+	if err != nil {
+		return nil, err
+	}
+	at, _ := avroTypes.LoadOrStore(t, &avroType{schema: b, encode: enc})
+	return at.(*avroType), nil
+}
+
+var (
+	timeType  = reflect.TypeOf(time.Time{})
+	civilType = reflect.TypeOf(civil.Date{})
+)
+
+// avroName converts s to a valid Avro name.
+func avroName(s string) string {
+	b := []byte(s)
+	for i, c := range b {
+		if !(c == '_' || 'a' <= c && c <= 'z' || 'A' <= c && c <= 'Z' || i > 0 && '0' <= c && c <= '9') {
+			b[i] = '_'
+		}
+	}
+	if len(b) == 0 {
+		return "_"
+	}
+	return string(b)
+}
+
+// compile returns the schema and encoder for t.
+func (c *avroCompiler) compile(t reflect.Type) (interface{}, avroEncoder, error) {
+	switch t {
+	case timeType:
+		return map[string]string{"type": "long", "logicalType": "timestamp-micros"},
+			func(b []byte, v reflect.Value) []byte {
+				tm := v.Interface().(time.Time)
+				return appendLong(b, tm.Unix()*1000000+int64(tm.Nanosecond()/1000))
+			}, nil
+	case civilType:
+		epoch := civil.Date{Year: 1970, Month: 1, Day: 1}
+		return map[string]string{"type": "int", "logicalType": "date"},
+			func(b []byte, v reflect.Value) []byte {
+				return appendLong(b, int64(v.Interface().(civil.Date).DaysSince(epoch)))
+			}, nil
+	}
+	switch t.Kind() {
+	case reflect.Bool:
+		return "boolean", func(b []byte, v reflect.Value) []byte {
+			if v.Bool() {
+				return append(b, 1)
+			}
+			return append(b, 0)
+		}, nil
+	case reflect.Int, reflect.Int8, reflect.Int16, reflect.Int32, reflect.Int64:
+		return "long", func(b []byte, v reflect.Value) []byte {
+			return appendLong(b, v.Int())
+		}, nil
+	case reflect.Uint, reflect.Uint8, reflect.Uint16, reflect.Uint32, reflect.Uint64, reflect.Uintptr:
+		return "long", func(b []byte, v reflect.Value) []byte {
+			return appendLong(b, int64(v.Uint()))
+		}, nil
+	case reflect.Float32:
+		return "float", func(b []byte, v reflect.Value) []byte {
+			var buf [4]byte
+			binary.LittleEndian.PutUint32(buf[:], math.Float32bits(float32(v.Float())))
+			return append(b, buf[:]...)
+		}, nil
+	case reflect.Float64:
+		return "double", func(b []byte, v reflect.Value) []byte {
+			var buf [8]byte
+			binary.LittleEndian.PutUint64(buf[:], math.Float64bits(v.Float()))
+			return append(b, buf[:]...)
+		}, nil
+	case reflect.String:
+		return "string", func(b []byte, v reflect.Value) []byte {
+			s := v.String()
+			return append(appendLong(b, int64(len(s))), s...)
+		}, nil
+	case reflect.Slice, reflect.Array:
+		if t.Elem().Kind() == reflect.Uint8 {
+			return "bytes", func(b []byte, v reflect.Value) []byte {
+				b = appendLong(b, int64(v.Len()))
+				for i := 0; i < v.Len(); i++ {
+					b = append(b, byte(v.Index(i).Uint()))
+				}
+				return b
+			}, nil
+		}
+		items, enc, err := c.compileElem(t.Elem())
+		if err != nil {
+			return nil, nil, err
+		}
+		return map[string]interface{}{"type": "array", "items": items},
+			func(b []byte, v reflect.Value) []byte {
+				n := v.Len()
+				if n > 0 {
+					b = appendLong(b, int64(n))
+					for i := 0; i < n; i++ {
+						b = enc(b, v.Index(i))
+					}
+				}
+				return appendLong(b, 0)
+			}, nil
+	case reflect.Map:
+		if t.Key().Kind() != reflect.String {
+			return nil, nil, fmt.Errorf("%w: %v", ErrUnsupportedType, t)
+		}
+		values, enc, err := c.compileElem(t.Elem())
+		if err != nil {
+			return nil, nil, err
+		}
+		return map[string]interface{}{"type": "map", "values": values},
+			func(b []byte, v reflect.Value) []byte {
+				if v.Len() > 0 {
+					b = appendLong(b, int64(v.Len()))
+					iter := v.MapRange()
+					for iter.Next() {
+						k := iter.Key().String()
+						b = append(appendLong(b, int64(len(k))), k...)
+						b = enc(b, iter.Value())
+					}
+				}
+				return appendLong(b, 0)
+			}, nil
+	case reflect.Ptr:
+		elem, enc, err := c.compile(t.Elem())
+		if err != nil {
+			return nil, nil, err
+		}
+		return []interface{}{"null", elem}, func(b []byte, v reflect.Value) []byte {
+			if v.IsNil() {
+				return appendLong(b, 0)
+			}
+			return enc(appendLong(b, 1), v.Elem())
+		}, nil
+	case reflect.Struct:
+		return c.compileStruct(t)
+	}
+	return nil, nil, fmt.Errorf("%w: %v", ErrUnsupportedType, t)
+}
+
+// compileElem compiles an array or map element type.  Pointers are not
+// nullable here, and nil pointers are encoded as the zero value.
+func (c *avroCompiler) compileElem(t reflect.Type) (interface{}, avroEncoder, error) {
+	if t.Kind() != reflect.Ptr {
+		return c.compile(t)
+	}
+	schema, enc, err := c.compile(t.Elem())
+	if err != nil {
+		return nil, nil, err
+	}
+	zero := reflect.Zero(t.Elem())
+	return schema, func(b []byte, v reflect.Value) []byte {
+		if v.IsNil() {
+			return enc(b, zero)
+		}
+		return enc(b, v.Elem())
+	}, nil
+}
+
+type avroField struct {
+	index  []int
+	encode avroEncoder
+}
+
+// structFields appends the encoded fields of t, flattening embedded structs
+// without a bigquery name, as bigquery.InferSchema does.
+func (c *avroCompiler) structFields(t reflect.Type, index []int, schemas []interface{}, fields []avroField) ([]interface{}, []avroField, error) {
+	for i := 0; i < t.NumField(); i++ {
+		f := t.Field(i)
+		name := strings.Split(f.Tag.Get("bigquery"), ",")[0]
+		// Unexported fields, including unexported embedded structs, are
+		// skipped, as their values cannot be read through reflection.
+		if name == "-" || f.PkgPath != "" {
+			continue
+		}
+		fi := append(append([]int{}, index...), i)
+		if f.Anonymous && name == "" {
+			ft := f.Type
+			if ft.Kind() == reflect.Ptr {
+				// Promoted fields through pointers are not supported.
+				continue
+			}
+			if ft.Kind() == reflect.Struct {
+				var err error
+				schemas, fields, err = c.structFields(ft, fi, schemas, fields)
+				if err != nil {
+					return nil, nil, err
+				}
+			}
+			continue
+		}
+		if name == "" {
+			name = f.Name
+		}
+		schema, enc, err := c.compile(f.Type)
+		if err != nil {
+			return nil, nil, fmt.Errorf("%s.%s: %w", t.Name(), f.Name, err)
+		}
+		schemas = append(schemas, map[string]interface{}{"name": avroName(name), "type": schema})
+		fields = append(fields, avroField{fi, enc})
+	}
+	return schemas, fields, nil
+}
+
+func (c *avroCompiler) compileStruct(t reflect.Type) (interface{}, avroEncoder, error) {
+	if c.active[t] {
+		return nil, nil, fmt.Errorf("%w: recursive type %v", ErrUnsupportedType, t)
+	}
+	name, defined := c.names[t]
+	if !defined {
+		name = avroName(t.Name())
+		if t.Name() == "" {
+			name = "record"
+		}
+		// Record names must be unique within the schema.
+		if n := c.used[name]; n > 0 {
+			c.used[name]++
+			name = fmt.Sprintf("%s_%d", name, n)
+		} else {
+			c.used[name] = 1
+		}
+		c.names[t] = name
+	}
+	c.active[t] = true
+	schemas, fields, err := c.structFields(t, nil, nil, nil)
+	delete(c.active, t)
+	if err != nil {
+		return nil, nil, err
+	}
+	enc := func(b []byte, v reflect.Value) []byte {
+		for i := range fields {
+			b = fields[i].encode(b, v.FieldByIndex(fields[i].index))
+		}
+		return b
+	}
+	if defined {
+		// Already defined, so reference it by name.
+		return name, enc, nil
+	}
+	if schemas == nil {
+		schemas = []interface{}{}
+	}
+	return map[string]interface{}{"type": "record", "name": name, "fields": schemas}, enc, nil
+}
+
+// appendLong appends the zigzag varint encoding of n.
+func appendLong(b []byte, n int64) []byte {
+	var buf [binary.MaxVarintLen64]byte
+	return append(b, buf[:binary.PutUvarint(buf[:], uint64(n<<1)^uint64(n>>63))]...)
+}
+
+//=================================================================================
+
+// AvroWriter implements row.Sink, writing an Avro object container file.
+// All rows must have the same type.
+// AvroWriter is THREAD-SAFE.
+type AvroWriter struct {
+	w       io.Writer
+	onClose func(rows int) error
+
+	lock   sync.Mutex
+	typ    reflect.Type
+	at     *avroType
+	sync   [16]byte
+	block  []byte // Encoded rows not yet written.
+	count  int    // Rows in block.
+	rows   int
+	zbuf   bytes.Buffer
+	zw     *flate.Writer
+	err    error // Sticky write error.
+	closed bool
+}
+
+// NewAvroWriter creates an AvroWriter that writes to w, and calls onClose,
+// which may be nil, with the total row count when it is closed.
+func NewAvroWriter(w io.Writer, onClose func(rows int) error) *AvroWriter {
+	aw := &AvroWriter{w: w, onClose: onClose}
+	rand.Read(aw.sync[:])
+	return aw
+}
+
+// writeHeader writes the container header, with the schema for the first row.
+func (aw *AvroWriter) writeHeader() error {
+	h := []byte{'O', 'b', 'j', 1}
+	meta := [][2]string{{"avro.schema", string(aw.at.schema)}, {"avro.codec", "deflate"}}
+	h = appendLong(h, int64(len(meta)))
+	for _, kv := range meta {
+		h = append(appendLong(h, int64(len(kv[0]))), kv[0]...)
+		h = append(appendLong(h, int64(len(kv[1]))), kv[1]...)
+	}
+	h = appendLong(h, 0)
+	h = append(h, aw.sync[:]...)
+	_, err := aw.w.Write(h)
+	return err
+}
+
+// writeBlock compresses and writes the buffered rows.  MUST hold the lock.
+func (aw *AvroWriter) writeBlock() error {
+	if aw.count == 0 {
+		return nil
+	}
+	aw.zbuf.Reset()
+	if aw.zw == nil {
+		aw.zw, _ = flate.NewWriter(&aw.zbuf, flate.DefaultCompression)
+	} else {
+		aw.zw.Reset(&aw.zbuf)
+	}
+	aw.zw.Write(aw.block)
+	if err := aw.zw.Close(); err != nil {
+		return err
+	}
+	h := appendLong(nil, int64(aw.count))
+	h = appendLong(h, int64(aw.zbuf.Len()))
+	if _, err := aw.w.Write(h); err != nil {
+		return err
+	}
+	if _, err := aw.zbuf.WriteTo(aw.w); err != nil {
+		return err
+	}
+	if _, err := aw.w.Write(aw.sync[:]); err != nil {
+		return err
+	}
+	aw.block = aw.block[:0]
+	aw.count = 0
+	return nil
+}
+
+// Commit implements row.Sink.  Rows are buffered, and written in compressed
+// blocks.
+func (aw *AvroWriter) Commit(rows []interface{}, label string) (int, error) {
+	rows = row.Unwrap(rows)
+	aw.lock.Lock()
+	defer aw.lock.Unlock()
+	if aw.err != nil {
+		return 0, aw.err
+	}
+	if aw.closed {
+		return 0, errors.New("AvroWriter closed")
+	}
+	for i := range rows {
+		v := reflect.ValueOf(rows[i])
+		for v.Kind() == reflect.Ptr && !v.IsNil() {
+			v = v.Elem()
+		}
+		if aw.typ == nil {
+			at, err := avroTypeOf(v.Type())
+			if err != nil {
+				metrics.BackendFailureCount.WithLabelValues(label, "encoding error").Inc()
+				return i, err
+			}
+			aw.typ, aw.at = v.Type(), at
+			if aw.err = aw.writeHeader(); aw.err != nil {
+				return i, aw.err
+			}
+		}
+		if v.Type() != aw.typ {
+			metrics.BackendFailureCount.WithLabelValues(label, "encoding error").Inc()
+			return i, fmt.Errorf("%w: mixed row types %v and %v", ErrUnsupportedType, aw.typ, v.Type())
+		}
+		n := len(aw.block)
+		aw.block = aw.at.encode(aw.block, v)
+		metrics.RowSizeHistogram.WithLabelValues(label).Observe(float64(len(aw.block) - n))
+		aw.count++
+		aw.rows++
+		if len(aw.block) >= avroBlockSize {
+			if aw.err = aw.writeBlock(); aw.err != nil {
+				return i + 1, aw.err
+			}
+		}
+	}
+	return len(rows), nil
+}
+
+// Close writes any buffered rows, and calls onClose.
+func (aw *AvroWriter) Close() error {
+	aw.lock.Lock()
+	defer aw.lock.Unlock()
+	if aw.closed {
+		return errors.New("AvroWriter closed")
+	}
+	aw.closed = true
+	if aw.err == nil {
+		aw.err = aw.writeBlock()
+	}
+	if aw.err != nil {
+		log.Println(aw.err)
+	}
+	if aw.onClose != nil {
+		if err := aw.onClose(aw.rows); err != nil {
+			return err
+		}
+	}
+	return aw.err
+}
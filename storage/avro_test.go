@@ -0,0 +1,159 @@
+package storage_test
+
+import (
+	"bytes"
+	"compress/flate"
+	"encoding/binary"
+	"encoding/json"
+	"io/ioutil"
+	"math"
+	"testing"
+	"time"
+
+	"github.com/m-lab/etl/storage"
+)
+
+type avroInner struct {
+	X int
+}
+
+type avroRow struct {
+	Name   string `bigquery:"name"`
+	N      int64
+	P      *int32
+	F      float64
+	T      time.Time
+	L      []string
+	Inner  *avroInner
+	Inners []*avroInner
+	skip   int
+	Skip   int `bigquery:"-"`
+}
+
+// avroReader decodes the Avro primitives used by the container format.
+type avroReader struct {
+	t *testing.T
+	b []byte
+}
+
+func (r *avroReader) long() int64 {
+	u, n := binary.Uvarint(r.b)
+	if n <= 0 {
+		r.t.Fatal("bad varint")
+	}
+	r.b = r.b[n:]
+	return int64(u>>1) ^ -int64(u&1)
+}
+
+func (r *avroReader) bytes(n int) []byte {
+	if len(r.b) < n {
+		r.t.Fatal("short data")
+	}
+	b := r.b[:n]
+	r.b = r.b[n:]
+	return b
+}
+
+func (r *avroReader) string() string {
+	return string(r.bytes(int(r.long())))
+}
+
+func TestAvroWriter(t *testing.T) {
+	buf := &bytes.Buffer{}
+	closedRows := -1
+	aw := storage.NewAvroWriter(buf, func(rows int) error { closedRows = rows; return nil })
+	rows := []interface{}{
+		&avroRow{Name: "ab", N: -2, F: 1.5, T: time.Unix(1, 0), L: []string{"x"}},
+		&avroRow{Name: "c", Inner: &avroInner{X: 3}, Inners: []*avroInner{nil, {X: 4}}},
+	}
+	if n, err := aw.Commit(rows, "test"); n != 2 || err != nil {
+		t.Fatal(n, err)
+	}
+	if _, err := aw.Commit([]interface{}{&avroInner{}}, "test"); err == nil {
+		t.Error("Expected error for mixed row types")
+	}
+	if err := aw.Close(); err != nil || closedRows != 2 {
+		t.Fatal(err, closedRows)
+	}
+
+	r := &avroReader{t, buf.Bytes()}
+	if string(r.bytes(4)) != "Obj\x01" {
+		t.Fatal("Bad magic")
+	}
+	meta := map[string]string{}
+	for n := r.long(); n > 0; n = r.long() {
+		for i := int64(0); i < n; i++ {
+			k := r.string()
+			meta[k] = r.string()
+		}
+	}
+	if meta["avro.codec"] != "deflate" {
+		t.Error("Bad codec", meta["avro.codec"])
+	}
+	var schema struct {
+		Name   string
+		Fields []struct {
+			Name string
+			Type interface{}
+		}
+	}
+	if err := json.Unmarshal([]byte(meta["avro.schema"]), &schema); err != nil {
+		t.Fatal(err, meta["avro.schema"])
+	}
+	names := []string{}
+	for _, f := range schema.Fields {
+		names = append(names, f.Name)
+	}
+	if schema.Name != "avroRow" || len(names) != 8 || names[0] != "name" || names[7] != "Inners" {
+		t.Error("Bad schema", meta["avro.schema"])
+	}
+	sync := r.bytes(16)
+
+	if count := r.long(); count != 2 {
+		t.Fatal("Bad block count", count)
+	}
+	block := r.bytes(int(r.long()))
+	if !bytes.Equal(r.bytes(16), sync) || len(r.b) != 0 {
+		t.Error("Bad block trailer")
+	}
+	data, err := ioutil.ReadAll(flate.NewReader(bytes.NewReader(block)))
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	d := &avroReader{t, data}
+	if d.string() != "ab" || d.long() != -2 || d.long() != 0 {
+		t.Error("Bad name, N, or P")
+	}
+	if math.Float64frombits(binary.LittleEndian.Uint64(d.bytes(8))) != 1.5 {
+		t.Error("Bad F")
+	}
+	if d.long() != 1000000 {
+		t.Error("Bad T")
+	}
+	if d.long() != 1 || d.string() != "x" || d.long() != 0 {
+		t.Error("Bad L")
+	}
+	if d.long() != 0 || d.long() != 0 {
+		t.Error("Bad Inner or Inners")
+	}
+	// Second row.
+	if d.string() != "c" || d.long() != 0 || d.long() != 0 {
+		t.Error("Bad name, N, or P")
+	}
+	d.bytes(8)
+	d.long()
+	if d.long() != 0 {
+		t.Error("Bad L")
+	}
+	if d.long() != 1 || d.long() != 3 {
+		t.Error("Bad Inner")
+	}
+	// Nil array elements are encoded as zero values.
+	if d.long() != 2 || d.long() != 0 || d.long() != 4 || d.long() != 0 {
+		t.Error("Bad Inners")
+	}
+	if len(d.b) != 0 {
+		t.Error("Unexpected trailing data")
+	}
+}
@@ -1 +1,35 @@
 package storage
+
+import (
+	"bytes"
+	"context"
+	"io"
+	"io/ioutil"
+	"time"
+)
+
+// SplitForTest splits src using index, reading ranges from archive.
+func SplitForTest(src *GCSSource, index []byte, archive []byte, gzipped bool, n int) int {
+	open := func(ctx context.Context, offset, length int64) (io.ReadCloser, error) {
+		if length < 0 {
+			length = int64(len(archive)) - offset
+		}
+		return ioutil.NopCloser(bytes.NewReader(archive[offset : offset+length])), nil
+	}
+	return src.splitWith(index, open, gzipped, n)
+}
+
+// NewReadAheadForTest returns a read-ahead reader over data.  Each read of
+// a range fails if fail returns true for its offset.
+func NewReadAheadForTest(data []byte, chunkSize int64, ranges int, fail func(offset int64) bool) io.ReadCloser {
+	open := func(ctx context.Context, offset, length int64) (io.ReadCloser, error) {
+		if fail(offset) {
+			// Return a truncated range.
+			length /= 2
+		}
+		return ioutil.NopCloser(bytes.NewReader(data[offset : offset+length])), nil
+	}
+	ra := newReadAhead(open, int64(len(data)), chunkSize, ranges, "test")
+	ra.retryBase = time.Microsecond
+	return ra
+}
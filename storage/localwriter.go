@@ -75,14 +75,45 @@ func (lw *LocalWriter) Close() error {
 	return nil
 }
 
+// NewLocalAvroWriter creates an AvroWriter for output to the given dir and
+// path.  On success, missing directories are created.  Callers must call
+// Close() to release the file.
+func NewLocalAvroWriter(dir string, path string) (row.Sink, error) {
+	p := filepath.Join(dir, path)
+	err := os.MkdirAll(filepath.Dir(p), os.ModePerm)
+	if err != nil {
+		return nil, err
+	}
+	f, err := os.OpenFile(p, os.O_TRUNC|os.O_CREATE|os.O_WRONLY, 0644)
+	if err != nil {
+		return nil, err
+	}
+	return NewAvroWriter(f, func(rows int) error {
+		err := f.Close()
+		if err != nil {
+			return err
+		}
+		log.Printf("Successful AvroWriter.Close(); wrote %d rows to %s", rows, f.Name())
+		return nil
+	}), nil
+}
+
 // LocalFactory creates LocalWriters sinks within a given output directory.
 type LocalFactory struct {
 	outputDir string
+	format    Format
 }
 
 // Get implements factory.SinkFactory for LocalWriters.
 func (lf *LocalFactory) Get(ctx context.Context, dp etl.DataPath) (row.Sink, etl.ProcessingError) {
-	s, err := NewLocalWriter(lf.outputDir, dp.Path+".jsonl")
+	var s row.Sink
+	var err error
+	switch lf.format {
+	case Avro:
+		s, err = NewLocalAvroWriter(lf.outputDir, dp.Path+".avro")
+	default:
+		s, err = NewLocalWriter(lf.outputDir, dp.Path+".jsonl")
+	}
 	if err != nil {
 		return nil, factory.NewError(dp.DataType, "LocalFactory", http.StatusInternalServerError, err)
 	}
@@ -90,9 +121,14 @@ func (lf *LocalFactory) Get(ctx context.Context, dp etl.DataPath) (row.Sink, etl
 }
 
 // NewLocalFactory creates a new LocalFactory that produces LocalWriters that
-// output to the named output directory.
-func NewLocalFactory(outputDir string) factory.SinkFactory {
-	return &LocalFactory{
+// output to the named output directory, as JSONL, or the optional format.
+func NewLocalFactory(outputDir string, format ...Format) factory.SinkFactory {
+	lf := &LocalFactory{
 		outputDir: outputDir,
+		format:    JSONL,
+	}
+	if len(format) > 0 {
+		lf.format = format[0]
 	}
+	return lf
 }
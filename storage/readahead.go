@@ -0,0 +1,196 @@
+package storage
+
+import (
+	"context"
+	"io"
+	"log"
+	"strconv"
+	"time"
+
+	"github.com/googleapis/google-cloud-go-testing/storage/stiface"
+	"github.com/m-lab/etl/metrics"
+)
+
+const (
+	// DefaultChunkSize is the default size of each ranged read.
+	DefaultChunkSize = 8 * 1024 * 1024
+	// maxRangeTrials is the number of attempts to read each chunk.
+	maxRangeTrials = 10
+	// rangeTimeout limits each attempt, so that a stalled read is retried.
+	rangeTimeout = 2 * time.Minute
+)
+
+type chunk struct {
+	data []byte
+	err  error
+}
+
+// readAhead is an io.ReadCloser that reads an object as a series of chunks,
+// with ranged reads of up to ranges chunks running concurrently ahead of the
+// reader.  Each chunk is retried separately, so a stalled or broken range
+// does not fail the whole object.
+type readAhead struct {
+	open      rangeOpener
+	size      int64
+	chunkSize int64
+	label     string // For metrics.
+	retryBase time.Duration
+
+	ctx     context.Context
+	cancel  func()
+	pending chan chan chunk // Chunks in order, at most ranges ahead.
+	free    chan []byte     // Buffers for reuse.
+
+	started bool
+	cur     []byte // Unread part of the current chunk.
+	buf     []byte // The current chunk's buffer.
+	err     error  // Sticky error.
+}
+
+func newReadAhead(open rangeOpener, size int64, chunkSize int64, ranges int, label string) *readAhead {
+	if chunkSize <= 0 {
+		chunkSize = DefaultChunkSize
+	}
+	if ranges < 1 {
+		ranges = 1
+	}
+	ctx, cancel := context.WithCancel(context.Background())
+	ra := &readAhead{
+		open:      open,
+		size:      size,
+		chunkSize: chunkSize,
+		label:     label,
+		retryBase: 16 * time.Millisecond,
+		ctx:       ctx,
+		cancel:    cancel,
+		pending:   make(chan chan chunk, ranges-1),
+		free:      make(chan []byte, ranges+1),
+	}
+	return ra
+}
+
+// fetchAll starts the fetch for each chunk, in order, blocking while the
+// pending queue is full.  So at most ranges chunks are fetched at once: those
+// queued, and the one the reader is waiting for.
+func (ra *readAhead) fetchAll() {
+	defer close(ra.pending)
+	for off := int64(0); off < ra.size; off += ra.chunkSize {
+		length := ra.chunkSize
+		if off+length > ra.size {
+			length = ra.size - off
+		}
+		result := make(chan chunk, 1)
+		select {
+		case ra.pending <- result:
+			go ra.fetch(off, length, result)
+		case <-ra.ctx.Done():
+			return
+		}
+	}
+}
+
+// fetch reads one chunk, retrying with backoff.
+func (ra *readAhead) fetch(off, length int64, result chan<- chunk) {
+	var buf []byte
+	select {
+	case buf = <-ra.free:
+	default:
+	}
+	if int64(cap(buf)) < length {
+		buf = make([]byte, ra.chunkSize)
+	}
+	buf = buf[:length]
+
+	delay := ra.retryBase
+	var err error
+	for trial := 1; trial <= maxRangeTrials; trial++ {
+		if err = ra.readRange(off, buf); err == nil {
+			result <- chunk{data: buf}
+			return
+		}
+		if ra.ctx.Err() != nil {
+			break
+		}
+		metrics.GCSRetryCount.WithLabelValues(
+			ra.label, "readAhead", strconv.Itoa(trial), "range error").Inc()
+		log.Printf("ERROR: readAhead:%d [%s] range %d+%d\n", trial, err, off, length)
+		// For each trial, increase backoff delay by 2x.
+		delay *= 2
+		select {
+		case <-time.After(delay):
+		case <-ra.ctx.Done():
+		}
+	}
+	result <- chunk{err: err}
+}
+
+func (ra *readAhead) readRange(off int64, buf []byte) error {
+	ctx, cancel := context.WithTimeout(ra.ctx, rangeTimeout)
+	defer cancel()
+	r, err := ra.open(ctx, off, int64(len(buf)))
+	if err != nil {
+		return err
+	}
+	defer r.Close()
+	_, err = io.ReadFull(r, buf)
+	return err
+}
+
+// Read implements io.Reader.  The first Read starts the fetches.
+func (ra *readAhead) Read(p []byte) (int, error) {
+	if !ra.started {
+		ra.started = true
+		go ra.fetchAll()
+	}
+	for len(ra.cur) == 0 {
+		if ra.err != nil {
+			return 0, ra.err
+		}
+		if ra.buf != nil {
+			select {
+			case ra.free <- ra.buf:
+			default:
+			}
+			ra.buf = nil
+		}
+		result, ok := <-ra.pending
+		if !ok {
+			ra.err = io.EOF
+			if ra.ctx.Err() != nil {
+				ra.err = ra.ctx.Err()
+			}
+			continue
+		}
+		c := <-result
+		if c.err != nil {
+			ra.err = c.err
+			continue
+		}
+		ra.buf, ra.cur = c.data, c.data
+	}
+	n := copy(p, ra.cur)
+	ra.cur = ra.cur[n:]
+	return n, nil
+}
+
+// Close implements io.Closer.  It stops any reads in progress.
+func (ra *readAhead) Close() error {
+	ra.cancel()
+	return nil
+}
+
+// getReadAheadReader returns a read-ahead reader for the object, and its size.
+func getReadAheadReader(ctx context.Context, client stiface.Client, bucket string, fn string,
+	chunkSize int64, ranges int, label string) (io.ReadCloser, int64, error) {
+	obj := client.Bucket(bucket).Object(fn)
+	attr, err := obj.Attrs(ctx)
+	if err != nil {
+		return nil, 0, err
+	}
+	// All ranges must come from the same version of the object.
+	obj = obj.Generation(attr.Generation)
+	open := func(ctx context.Context, offset, length int64) (io.ReadCloser, error) {
+		return obj.NewRangeReader(ctx, offset, length)
+	}
+	return newReadAhead(open, attr.Size, chunkSize, ranges, label), attr.Size, nil
+}
@@ -0,0 +1,56 @@
+package storage_test
+
+import (
+	"bytes"
+	"io/ioutil"
+	"sync"
+	"testing"
+
+	"github.com/m-lab/etl/storage"
+)
+
+func TestReadAhead(t *testing.T) {
+	data := make([]byte, 100000)
+	for i := range data {
+		data[i] = byte(i * 7)
+	}
+	for _, ranges := range []int{1, 3, 8} {
+		r := storage.NewReadAheadForTest(data, 4096, ranges, func(int64) bool { return false })
+		got, err := ioutil.ReadAll(r)
+		if err != nil || !bytes.Equal(got, data) {
+			t.Error("Wrong data with", ranges, "ranges", err, len(got))
+		}
+		r.Close()
+	}
+
+	// Each range fails on its first attempt, and is retried.
+	var lock sync.Mutex
+	tried := map[int64]bool{}
+	r := storage.NewReadAheadForTest(data, 4096, 4, func(off int64) bool {
+		lock.Lock()
+		defer lock.Unlock()
+		fail := !tried[off]
+		tried[off] = true
+		return fail
+	})
+	got, err := ioutil.ReadAll(r)
+	if err != nil || !bytes.Equal(got, data) {
+		t.Error("Wrong data with retries", err, len(got))
+	}
+	r.Close()
+
+	// A range that always fails is an error.
+	r = storage.NewReadAheadForTest(data, 4096, 4, func(off int64) bool { return off == 8192 })
+	got, err = ioutil.ReadAll(r)
+	if err == nil || !bytes.Equal(got, data[:8192]) {
+		t.Error("Expected error after 8192 bytes", err, len(got))
+	}
+	r.Close()
+
+	// An empty object.
+	r = storage.NewReadAheadForTest(nil, 4096, 4, func(int64) bool { return false })
+	if got, err := ioutil.ReadAll(r); err != nil || len(got) != 0 {
+		t.Error("Expected empty read", err, len(got))
+	}
+	r.Close()
+}
@@ -7,6 +7,8 @@ import (
 	"fmt"
 	"log"
 	"net/http"
+	"runtime"
+	"sync"
 	"time"
 
 	gcs "cloud.google.com/go/storage"
@@ -31,11 +33,15 @@ type RowWriter struct {
 	bucket string
 	path   string
 
-	// These act as tokens to serialize access to the writer.
-	// This allows concurrent encoding and writing, while ensuring
-	// that single client access is correctly ordered.
-	encoding chan struct{} // Token required for encoding.
-	writing  chan struct{} // Token required for writing.
+	// Up to cap(encoders) calls to Commit may encode concurrently.  Each
+	// Commit takes a sequence number on entry, and writes only when all
+	// earlier Commits have finished, so rows reach the writer in the order
+	// Commit was called.
+	encoders chan struct{} // Tokens limiting concurrent encoding.
+	lock     sync.Mutex
+	turn     *sync.Cond // Signalled when writing advances.
+	next     uint64     // Sequence number of the next Commit.
+	writing  uint64     // Sequence number of the Commit allowed to write.
 }
 
 // NewRowWriter creates a RowWriter.
@@ -46,67 +52,100 @@ func NewRowWriter(ctx context.Context, client stiface.Client, bucket string, pat
 	// Set smaller chunk size to conserve memory.
 	w.SetChunkSize(4 * 1024 * 1024)
 
-	encoding := make(chan struct{}, 1)
-	encoding <- struct{}{}
-	writing := make(chan struct{}, 1)
-	writing <- struct{}{}
-
-	return &RowWriter{bucket: bucket, path: path, o: o, w: w, encoding: encoding, writing: writing}, nil
+	// Each encoder holds the full encoding of its rows, so limit the
+	// concurrency to bound memory, even on large machines.
+	encoders := runtime.GOMAXPROCS(0)
+	if encoders > maxEncoders {
+		encoders = maxEncoders
+	}
+	rw := &RowWriter{bucket: bucket, path: path, o: o, w: w, encoders: make(chan struct{}, encoders)}
+	rw.turn = sync.NewCond(&rw.lock)
+	return rw, nil
 }
 
-// Acquire the encoding token.
-// TODO can we allow two encoders, and still sequence the writing?
-func (rw *RowWriter) acquireEncodingToken() {
-	<-rw.encoding
+// maxEncoders limits the number of concurrent encoders per RowWriter.
+const maxEncoders = 4
+
+// sequence returns the sequence number for a new Commit.
+func (rw *RowWriter) sequence() uint64 {
+	rw.lock.Lock()
+	defer rw.lock.Unlock()
+	seq := rw.next
+	rw.next++
+	return seq
 }
 
-func (rw *RowWriter) releaseEncodingToken() {
-	if len(rw.encoding) > 0 {
-		log.Println("token error")
-		return
+// waitTurn blocks until all Commits before seq have finished.
+func (rw *RowWriter) waitTurn(seq uint64) {
+	rw.lock.Lock()
+	for rw.writing != seq {
+		rw.turn.Wait()
 	}
-	rw.encoding <- struct{}{}
+	rw.lock.Unlock()
 }
 
-// Swap the encoding token for the write token.
-// MUST already hold the write token.
-func (rw *RowWriter) swapForWritingToken() {
-	<-rw.writing
-	rw.releaseEncodingToken()
+// endTurn allows the next Commit to write.  MUST be called exactly once
+// after each waitTurn.
+func (rw *RowWriter) endTurn() {
+	rw.lock.Lock()
+	rw.writing++
+	rw.lock.Unlock()
+	rw.turn.Broadcast()
 }
 
-func (rw *RowWriter) releaseWritingToken() {
-	rw.writing <- struct{}{} // return the token.
+// AcceptsEncoded implements row.EncodedSink, so rows are JSON encoded by
+// the committing goroutine, before Commit.
+func (rw *RowWriter) AcceptsEncoded() bool {
+	return true
+}
+
+// encode returns the rows as newline delimited JSON.
+// NOTE: This can cause a fairly hefty memory footprint for
+// large numbers of large rows.
+func encode(rows []interface{}, label string) (*bytes.Buffer, error) {
+	buf := bytes.NewBuffer(nil)
+	for i := range rows {
+		var j []byte
+		if e, ok := rows[i].(*row.Encoded); ok {
+			j = e.JSON
+		} else {
+			var err error
+			j, err = json.Marshal(rows[i])
+			if err != nil {
+				metrics.BackendFailureCount.WithLabelValues(
+					label, "encoding error").Inc()
+				return nil, err
+			}
+		}
+		metrics.RowSizeHistogram.WithLabelValues(label).Observe(float64(len(j)))
+		buf.Write(j)
+		buf.WriteByte('\n')
+	}
+	return buf, nil
 }
 
 // Commit commits rows, in order, to the GCS object.
+// Rows that are *row.Encoded are written without encoding them again.
+// Concurrent calls encode in parallel, but are written in the order in
+// which Commit was called.
 // The GCS object is not available until Close is called, at which
 // point the entire object becomes available atomically.
 // The returned int is the number of rows written (and pending), or,
 // if error is not nil, an estimate of the number of rows written.
 func (rw *RowWriter) Commit(rows []interface{}, label string) (int, error) {
-	rw.acquireEncodingToken()
-	// First, do the encoding.  Other calls to Commit will block here
-	// until encoding is done.
-	// NOTE: This can cause a fairly hefty memory footprint for
-	// large numbers of large rows.
-	buf := bytes.NewBuffer(nil)
+	seq := rw.sequence()
+	rw.encoders <- struct{}{}
+	buf, err := encode(rows, label)
+	<-rw.encoders
 
-	for i := range rows {
-		j, err := json.Marshal(rows[i])
-		if err != nil {
-			rw.releaseEncodingToken()
-			metrics.BackendFailureCount.WithLabelValues(
-				label, "encoding error").Inc()
-			return 0, err
-		}
-		metrics.RowSizeHistogram.WithLabelValues(label).Observe(float64(len(j)))
-		buf.Write(j)
-		buf.WriteByte('\n')
+	// Even on encoding error, this Commit must take its turn, so that
+	// later Commits can proceed.
+	rw.waitTurn(seq)
+	defer rw.endTurn()
+	if err != nil {
+		return 0, err
 	}
 	numBytes := buf.Len()
-	rw.swapForWritingToken()
-	defer rw.releaseWritingToken()
 	n, err := buf.WriteTo(rw.w) // This is buffered (by 4MB chunks).  Are the writes to GCS synchronous?
 	if err != nil {
 		rw.writeErr = err
@@ -138,17 +177,22 @@ func (rw *RowWriter) Commit(rows []interface{}, label string) (int, error) {
 	return len(rows), nil
 }
 
-// Close synchronizes on the tokens, and closes the backing file.
+// Close waits for all pending Commits to finish, and closes the backing file.
 func (rw *RowWriter) Close() error {
-	// Take BOTH tokens, to ensure no other goroutines are still running.
-	<-rw.encoding
-	<-rw.writing
-
-	close(rw.encoding)
-	close(rw.writing)
+	rw.lock.Lock()
+	for rw.writing != rw.next {
+		rw.turn.Wait()
+	}
+	rw.lock.Unlock()
 
 	log.Println("Closing", rw.bucket, rw.path)
-	err := rw.w.Close()
+	return closeObject(rw.w, rw.o, rw.rows, rw.writeErr)
+}
+
+// closeObject closes the object writer, and records the row count, and any
+// write error, in the object metadata.
+func closeObject(w stiface.Writer, o stiface.ObjectHandle, rows int, writeErr error) error {
+	err := w.Close()
 	if err != nil {
 		log.Println(err)
 		return err
@@ -156,28 +200,59 @@ func (rw *RowWriter) Close() error {
 
 	oa := gcs.ObjectAttrsToUpdate{}
 	oa.Metadata = make(map[string]string, 1)
-	oa.Metadata["rows"] = fmt.Sprint(rw.rows)
-	if rw.writeErr != nil {
-		oa.Metadata["writeError"] = rw.writeErr.Error()
+	oa.Metadata["rows"] = fmt.Sprint(rows)
+	if writeErr != nil {
+		oa.Metadata["writeError"] = writeErr.Error()
 	}
 
 	ctx, cancel := context.WithTimeout(context.Background(), time.Minute)
 	defer cancel()
-	attr, err := rw.o.Update(ctx, oa)
+	attr, err := o.Update(ctx, oa)
 	log.Println(attr, err)
 	return err
+}
 
+// NewAvroObjectWriter creates an AvroWriter for a GCS object.  As with
+// RowWriter, the object is not available until Close.
+func NewAvroObjectWriter(ctx context.Context, client stiface.Client, bucket string, path string) (row.Sink, error) {
+	o := client.Bucket(bucket).Object(path)
+	w := o.NewWriter(ctx)
+	// Set smaller chunk size to conserve memory.
+	w.SetChunkSize(4 * 1024 * 1024)
+	var aw *AvroWriter
+	aw = NewAvroWriter(w, func(rows int) error {
+		log.Println("Closing", bucket, path)
+		return closeObject(w, o, rows, aw.err)
+	})
+	return aw, nil
 }
 
+// Format is the file format written by the storage sinks.
+type Format string
+
+// Output formats.
+const (
+	JSONL Format = "jsonl" // Newline delimited JSON, the default.
+	Avro  Format = "avro"  // Avro object container files.
+)
+
 // SinkFactory implements factory.SinkFactory.
 type SinkFactory struct {
 	client       stiface.Client
 	outputBucket string
+	format       Format
 }
 
 // Get implements factory.SinkFactory
 func (sf *SinkFactory) Get(ctx context.Context, dp etl.DataPath) (row.Sink, etl.ProcessingError) {
-	s, err := NewRowWriter(ctx, sf.client, sf.outputBucket, dp.Path+".json")
+	var s row.Sink
+	var err error
+	switch sf.format {
+	case Avro:
+		s, err = NewAvroObjectWriter(ctx, sf.client, sf.outputBucket, dp.Path+".avro")
+	default:
+		s, err = NewRowWriter(ctx, sf.client, sf.outputBucket, dp.Path+".json")
+	}
 	if err != nil {
 		return nil, factory.NewError(dp.DataType, "SinkFactory",
 			http.StatusInternalServerError, err)
@@ -185,7 +260,12 @@ func (sf *SinkFactory) Get(ctx context.Context, dp etl.DataPath) (row.Sink, etl.
 	return s, nil
 }
 
-// NewSinkFactory returns the default SinkFactory
-func NewSinkFactory(client stiface.Client, outputBucket string) factory.SinkFactory {
-	return &SinkFactory{client: client, outputBucket: outputBucket}
+// NewSinkFactory returns the default SinkFactory, which writes JSONL, or
+// the optional format.
+func NewSinkFactory(client stiface.Client, outputBucket string, format ...Format) factory.SinkFactory {
+	sf := &SinkFactory{client: client, outputBucket: outputBucket, format: JSONL}
+	if len(format) > 0 {
+		sf.format = format[0]
+	}
+	return sf
 }
@@ -3,6 +3,8 @@ package storage_test
 import (
 	"context"
 	"io/ioutil"
+	"runtime"
+	"sync"
 	"testing"
 	"time"
 
@@ -59,3 +61,66 @@ func TestRowWriter(t *testing.T) {
 		t.Error(diff)
 	}
 }
+
+// blockingRow signals started when encoding begins, and then waits for wait
+// to be closed before completing.
+type blockingRow struct {
+	name          string
+	started, wait chan struct{}
+}
+
+func (br blockingRow) MarshalJSON() ([]byte, error) {
+	if br.started != nil {
+		close(br.started)
+	}
+	if br.wait != nil {
+		<-br.wait
+	}
+	return []byte(`"` + br.name + `"`), nil
+}
+
+// The second Commit finishes encoding before the first, but must still be
+// written second.
+func TestRowWriterOrdered(t *testing.T) {
+	defer runtime.GOMAXPROCS(runtime.GOMAXPROCS(2))
+	server := fgs.NewServer([]fgs.Object{})
+	defer server.Stop()
+
+	bucket := "fake-bucket"
+	server.CreateBucket(bucket)
+	c := server.Client()
+
+	file := "ordered-file"
+	rw, err := storage.NewRowWriter(context.Background(), stiface.AdaptClient(c), bucket, file)
+	if err != nil {
+		t.Fatal(err)
+	}
+	started := make(chan struct{})
+	release := make(chan struct{})
+	wg := sync.WaitGroup{}
+	wg.Add(2)
+	go func() {
+		defer wg.Done()
+		rw.Commit([]interface{}{blockingRow{name: "first", started: started, wait: release}}, "fake-label")
+	}()
+	<-started
+	go func() {
+		defer wg.Done()
+		rw.Commit([]interface{}{blockingRow{name: "second", started: release}}, "fake-label")
+	}()
+	wg.Wait()
+	rw.Close()
+
+	reader, err := c.Bucket(bucket).Object(file).NewReader(context.Background())
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer reader.Close()
+	data, err := ioutil.ReadAll(reader)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if string(data) != "\"first\"\n\"second\"\n" {
+		t.Errorf("Wrong order: %q", data)
+	}
+}
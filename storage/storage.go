@@ -8,16 +8,17 @@ package storage
 
 import (
 	"archive/tar"
+	"bytes"
 	"compress/gzip"
 	"context"
 	"errors"
 	"fmt"
 	"io"
-	"io/ioutil"
 	"log"
 	"net/http"
 	"strconv"
 	"strings"
+	"sync"
 	"time"
 
 	"cloud.google.com/go/civil"
@@ -48,6 +49,92 @@ type GCSSource struct {
 	RetryBaseTime time.Duration // The base time for backoff and retry.
 	TableBase     string        // TableBase is BQ table associated with this source, or "invalid".
 	PathDate      civil.Date    // Date associated with YYYY/MM/DD in FilePath.
+
+	// Reused across the files of the archive.
+	zipReader *gzip.Reader
+	lock      sync.Mutex // Protects free, which may be released concurrently.
+	free      [][]byte   // Buffers returned through Release.
+	pool      *GCSSource // If non-nil, the source whose buffers are used.
+
+	// For reading ranges of the archive concurrently.  See Split.
+	obj     stiface.ObjectHandle // The archive object.
+	index   stiface.ObjectHandle // The archive's index object.
+	gzipped bool
+	split   *splitReader // Non-nil once split.
+
+	stages *metrics.TaskStages // May be nil.
+}
+
+// SetStages sets the TaskStages that record the source's decompression.
+func (src *GCSSource) SetStages(stages *metrics.TaskStages) {
+	src.stages = stages
+}
+
+const (
+	// maxFreeBuffers is the number of released buffers kept for reuse.
+	maxFreeBuffers = 4
+	// maxReusedBuffer is the largest buffer kept for reuse.  Larger buffers
+	// are left to the garbage collector, to avoid pinning a rare huge file.
+	maxReusedBuffer = 16 * 1024 * 1024
+	// gzipRatio is the initial estimate of uncompressed size / compressed size.
+	gzipRatio = 4
+)
+
+// getBuffer returns an empty buffer, preferably a released one with capacity
+// of at least size.
+func (src *GCSSource) getBuffer(size int64) []byte {
+	if src.pool != nil {
+		return src.pool.getBuffer(size)
+	}
+	src.lock.Lock()
+	defer src.lock.Unlock()
+	for i, b := range src.free {
+		if int64(cap(b)) >= size {
+			last := len(src.free) - 1
+			src.free[i] = src.free[last]
+			src.free[last] = nil
+			src.free = src.free[:last]
+			return b[:0]
+		}
+	}
+	if size > maxReusedBuffer {
+		size = maxReusedBuffer
+	}
+	return make([]byte, 0, size+bytes.MinRead)
+}
+
+// Release implements etl.TestSource.Release.
+func (src *GCSSource) Release(data []byte) {
+	if cap(data) == 0 || cap(data) > maxReusedBuffer {
+		return
+	}
+	if src.pool != nil {
+		src.pool.Release(data)
+		return
+	}
+	src.lock.Lock()
+	defer src.lock.Unlock()
+	if len(src.free) < maxFreeBuffers {
+		src.free = append(src.free, data[:0])
+	}
+}
+
+// readAll is like ioutil.ReadAll, but reads into buf, which may be reused.
+func readAll(r io.Reader, buf []byte) ([]byte, error) {
+	for {
+		if len(buf) == cap(buf) {
+			// Let append choose the growth.
+			buf = append(buf, 0)[:len(buf)]
+		}
+		n, err := r.Read(buf[len(buf):cap(buf)])
+		buf = buf[:len(buf)+n]
+		if err == io.EOF {
+			return buf, nil
+		}
+		if err != nil {
+			return buf, err
+		}
+	}
 }
 
 // Retrieve next file header.
@@ -82,9 +169,15 @@ func (src *GCSSource) nextData(h *tar.Header, trial int) ([]byte, bool, error) {
 	var phase string
 	if strings.HasSuffix(strings.ToLower(h.Name), "gz") {
 		// TODO add unit test
-		var zipReader *gzip.Reader
-		zipReader, err = gzip.NewReader(src)
+		if src.zipReader == nil {
+			src.zipReader, err = gzip.NewReader(src)
+		} else {
+			err = src.zipReader.Reset(src)
+		}
 		if err != nil {
+			// A failed NewReader returns nil, and a failed Reset leaves the
+			// reader in an error state, so start afresh next time.
+			src.zipReader = nil
 			if err == io.EOF {
 				return nil, false, err
 			}
@@ -93,12 +186,13 @@ func (src *GCSSource) nextData(h *tar.Header, trial int) ([]byte, bool, error) {
 			log.Printf("ERROR: zipReader(%d): %v in file %s\n", trial, err, h.Name)
 			return nil, true, err
 		}
-		defer zipReader.Close()
 		phase = "nextData zip"
-		data, err = ioutil.ReadAll(zipReader)
+		start := time.Now()
+		data, err = readAll(src.zipReader, src.getBuffer(gzipRatio*h.Size))
+		src.stages.Observe(src.TableBase, metrics.StageInflate, start, len(data), 0)
 	} else {
 		phase = "nextData"
-		data, err = ioutil.ReadAll(src)
+		data, err = readAll(src, src.getBuffer(h.Size))
 	}
 	if err != nil {
 		// These errors seem to be recoverable, at least with zip files.
@@ -120,6 +214,7 @@ func (src *GCSSource) nextData(h *tar.Header, trial int) ([]byte, bool, error) {
 				src.TableBase, phase, strconv.Itoa(trial), "other error").Inc()
 		}
 		log.Printf("ERROR: nextData:%d [%s] %s (%d bytes) from %s\n", trial, err, h.Name, h.Size, src.FilePath)
+		src.Release(data)
 		return nil, true, err
 	}
 
@@ -145,7 +240,11 @@ func (src *GCSSource) Date() civil.Date {
 // Skips reading contents of any file larger than maxSize, returning empty data
 // and storage.ErrOversizeFile.
 // Returns io.EOF when there are no more tests.
+// After Split, tests are returned in no particular order.
 func (src *GCSSource) NextTest(maxSize int64) (string, []byte, error) {
+	if src.split != nil {
+		return src.split.next(maxSize)
+	}
 	metrics.WorkerState.WithLabelValues(src.TableBase, "read").Inc()
 	defer metrics.WorkerState.WithLabelValues(src.TableBase, "read").Dec()
 
@@ -261,7 +360,14 @@ func NewTestSource(client stiface.Client, dp etl.DataPath, label string) (etl.Te
 	// TODO - appengine requests time out after 60 minutes, so more than that doesn't help.
 	// SS processing sometimes times out with 1 hour.
 	// Is there a limit on http requests from task queue, or into flex instance?
-	rdr, size, err := getReader(ctx, client, bucket, fn, 300*time.Minute)
+	var rdr io.ReadCloser
+	var size int64
+	if etl.ReadAheadRanges > 0 {
+		rdr, size, err = getReadAheadReader(ctx, client, bucket, fn,
+			etl.ReadChunkSize, etl.ReadAheadRanges, label)
+	} else {
+		rdr, size, err = getReader(ctx, client, bucket, fn, 300*time.Minute)
+	}
 	if err != nil {
 		cancel()
 		log.Println(err)
@@ -270,7 +376,8 @@ func NewTestSource(client stiface.Client, dp etl.DataPath, label string) (etl.Te
 
 	closer := &Closer{nil, rdr, cancel}
 	// Handle .tar.gz, .tgz files.
-	if strings.HasSuffix(strings.ToLower(fn), "gz") {
+	gzipped := strings.HasSuffix(strings.ToLower(fn), "gz")
+	if gzipped {
 		// TODO add unit test
 		// NB: This must not be :=, or it creates local rdr.
 		// TODO - add retries with backoff.
@@ -294,6 +401,9 @@ func NewTestSource(client stiface.Client, dp etl.DataPath, label string) (etl.Te
 		RetryBaseTime: baseTimeout,
 		TableBase:     label,
 		PathDate:      civil.DateOf(archiveDate),
+		obj:           client.Bucket(bucket).Object(fn),
+		index:         client.Bucket(bucket).Object(fn + IndexSuffix),
+		gzipped:       gzipped,
 	}
 	return gcs, nil
 }
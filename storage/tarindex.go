@@ -0,0 +1,390 @@
+package storage
+
+import (
+	"archive/tar"
+	"bufio"
+	"bytes"
+	"compress/gzip"
+	"context"
+	"errors"
+	"fmt"
+	"io"
+	"io/ioutil"
+	"log"
+	"strconv"
+	"sync"
+	"time"
+
+	gcs "cloud.google.com/go/storage"
+)
+
+// Archive indexes.
+//   An archive may have a sidecar index object, named by appending
+//   IndexSuffix to the archive's object name, listing byte offsets in the
+//   archive object at which an independently readable portion begins.
+//   For uncompressed tar archives, each offset is the start of a tar header.
+//   For block gzipped archives, each offset is the start of a gzip member
+//   whose content begins with a tar header.
+//   The index is text, with one decimal offset per line, in increasing
+//   order, starting with 0.
+//
+//   Each range between chosen offsets is then read with its own ranged GCS
+//   read and tar.Reader, concurrently with the others.  See GCSSource.Split.
+
+// IndexSuffix is appended to an archive's object name to name its index.
+const IndexSuffix = ".index"
+
+// ErrBadIndex is returned for malformed archive indexes.
+var ErrBadIndex = errors.New("bad archive index")
+
+// ParseIndex parses an archive index, and returns its offsets.
+func ParseIndex(b []byte) ([]int64, error) {
+	offsets := []int64{}
+	s := bufio.NewScanner(bytes.NewReader(b))
+	for s.Scan() {
+		line := bytes.TrimSpace(s.Bytes())
+		if len(line) == 0 {
+			continue
+		}
+		off, err := strconv.ParseInt(string(line), 10, 64)
+		if err != nil {
+			return nil, ErrBadIndex
+		}
+		if len(offsets) == 0 && off != 0 ||
+			len(offsets) > 0 && off <= offsets[len(offsets)-1] {
+			return nil, ErrBadIndex
+		}
+		offsets = append(offsets, off)
+	}
+	if s.Err() != nil || len(offsets) == 0 {
+		return nil, ErrBadIndex
+	}
+	return offsets, nil
+}
+
+// WriteIndex writes offsets in the archive index format.
+func WriteIndex(w io.Writer, offsets []int64) error {
+	bw := bufio.NewWriter(w)
+	for _, off := range offsets {
+		fmt.Fprintln(bw, off)
+	}
+	return bw.Flush()
+}
+
+// countingReader counts the bytes read through it.
+type countingReader struct {
+	io.Reader
+	n int64
+}
+
+func (cr *countingReader) Read(b []byte) (int, error) {
+	n, err := cr.Reader.Read(b)
+	cr.n += int64(n)
+	return n, err
+}
+
+// IndexTar is an indexing pass over an uncompressed tar archive.  It returns
+// the offsets of entry headers that begin portions of at least rangeSize
+// bytes, suitable for WriteIndex.
+func IndexTar(r io.Reader, rangeSize int64) ([]int64, error) {
+	cr := &countingReader{Reader: r}
+	tr := tar.NewReader(cr)
+	offsets := []int64{0}
+	for {
+		// The previous entry has been read to its end, so the next header
+		// starts at the following block boundary.
+		start := (cr.n + 511) &^ 511
+		_, err := tr.Next()
+		if err == io.EOF {
+			return offsets, nil
+		}
+		if err != nil {
+			return nil, err
+		}
+		if last := offsets[len(offsets)-1]; start > last && start-last >= rangeSize {
+			offsets = append(offsets, start)
+		}
+		if _, err := io.Copy(ioutil.Discard, tr); err != nil {
+			return nil, err
+		}
+	}
+}
+
+// countingByteReader counts the bytes read through it.  It implements
+// io.ByteReader, so gzip reads exactly to the end of each member.
+type countingByteReader struct {
+	r *bufio.Reader
+	n int64
+}
+
+func (cr *countingByteReader) Read(b []byte) (int, error) {
+	n, err := cr.r.Read(b)
+	cr.n += int64(n)
+	return n, err
+}
+
+func (cr *countingByteReader) ReadByte() (byte, error) {
+	b, err := cr.r.ReadByte()
+	if err == nil {
+		cr.n++
+	}
+	return b, err
+}
+
+// IndexGzipTar is an indexing pass over a block gzipped tar archive.  It
+// returns the offsets of gzip members whose content starts with a tar
+// header, and that begin portions of at least rangeSize bytes of the
+// archive, suitable for WriteIndex.  An archive that is a single gzip
+// stream has only the offset 0.
+func IndexGzipTar(r io.Reader, rangeSize int64) ([]int64, error) {
+	type member struct {
+		offset int64 // Offset of the member in the archive.
+		start  int64 // Offset of the member's content in the tar.
+	}
+	cr := &countingByteReader{r: bufio.NewReader(r)}
+	zr, err := gzip.NewReader(cr)
+	if err != nil {
+		return nil, err
+	}
+	// The tar headers are found by indexing the decompressed stream.
+	pr, pw := io.Pipe()
+	type result struct {
+		headers []int64
+		err     error
+	}
+	done := make(chan result, 1)
+	go func() {
+		headers, err := IndexTar(pr, 1)
+		// Drain any padding after the end of the tar.
+		io.Copy(ioutil.Discard, pr)
+		done <- result{headers, err}
+	}()
+	members := []member{}
+	offset, start := int64(0), int64(0)
+	for {
+		zr.Multistream(false)
+		n, err := io.Copy(pw, zr)
+		if err != nil {
+			pw.CloseWithError(err)
+			<-done
+			return nil, err
+		}
+		members = append(members, member{offset, start})
+		start += n
+		offset = cr.n
+		err = zr.Reset(cr)
+		if err == io.EOF {
+			break
+		}
+		if err != nil {
+			pw.CloseWithError(err)
+			<-done
+			return nil, err
+		}
+	}
+	pw.Close()
+	res := <-done
+	if res.err != nil {
+		return nil, res.err
+	}
+	headers := make(map[int64]bool, len(res.headers))
+	for _, h := range res.headers {
+		headers[h] = true
+	}
+	offsets := []int64{0}
+	for _, m := range members[1:] {
+		if headers[m.start] && m.offset-offsets[len(offsets)-1] >= rangeSize {
+			offsets = append(offsets, m.offset)
+		}
+	}
+	return offsets, nil
+}
+
+// splitRanges chooses the offsets that start up to n ranges of roughly equal
+// size, within an archive of size bytes.
+func splitRanges(offsets []int64, size int64, n int) []int64 {
+	starts := []int64{0}
+	for _, off := range offsets {
+		next := int64(len(starts)) * size / int64(n)
+		if len(starts) == n {
+			break
+		}
+		if off >= next && off > starts[len(starts)-1] {
+			starts = append(starts, off)
+		}
+	}
+	return starts
+}
+
+// rangeOpener opens a reader for length bytes of the archive from offset,
+// or for the rest of the archive if length is negative.
+type rangeOpener func(ctx context.Context, offset, length int64) (io.ReadCloser, error)
+
+type splitTest struct {
+	name string
+	data []byte
+	err  error
+}
+
+// splitReader merges the tests read concurrently from ranges of an archive.
+type splitReader struct {
+	src     *GCSSource
+	open    rangeOpener
+	gzipped bool
+	starts  []int64
+
+	once   sync.Once
+	ctx    context.Context
+	cancel func()
+	wg     sync.WaitGroup
+	tests  chan splitTest
+}
+
+func newSplitReader(src *GCSSource, open rangeOpener, gzipped bool, starts []int64) *splitReader {
+	ctx, cancel := context.WithCancel(context.Background())
+	return &splitReader{
+		src:     src,
+		open:    open,
+		gzipped: gzipped,
+		starts:  starts,
+		ctx:     ctx,
+		cancel:  cancel,
+		tests:   make(chan splitTest, len(starts)),
+	}
+}
+
+// readRange reads the tests in the range from starts[i], until the end of
+// the range, an unrecoverable error, or cancellation.
+func (sr *splitReader) readRange(i int, maxSize int64) {
+	defer sr.wg.Done()
+	length := int64(-1)
+	if i+1 < len(sr.starts) {
+		length = sr.starts[i+1] - sr.starts[i]
+	}
+	send := func(t splitTest) bool {
+		select {
+		case sr.tests <- t:
+			return true
+		case <-sr.ctx.Done():
+			return false
+		}
+	}
+	rdr, err := sr.open(sr.ctx, sr.starts[i], length)
+	if err != nil {
+		send(splitTest{err: err})
+		return
+	}
+	defer rdr.Close()
+	var r io.Reader = rdr
+	if sr.gzipped {
+		zr, err := gzip.NewReader(rdr)
+		if err != nil {
+			send(splitTest{err: err})
+			return
+		}
+		defer zr.Close()
+		r = zr
+	}
+	part := &GCSSource{
+		FilePath:      sr.src.FilePath,
+		TarReader:     tar.NewReader(r),
+		RetryBaseTime: sr.src.RetryBaseTime,
+		TableBase:     sr.src.TableBase,
+		PathDate:      sr.src.PathDate,
+		pool:          sr.src,
+		stages:        sr.src.stages,
+	}
+	for {
+		name, data, err := part.NextTest(maxSize)
+		if err == io.EOF {
+			return
+		}
+		if !send(splitTest{name, data, err}) {
+			sr.src.Release(data)
+			return
+		}
+		if err != nil && err != ErrOversizeFile {
+			return
+		}
+	}
+}
+
+// next returns the next test read from any range, starting the reads on the
+// first call.
+func (sr *splitReader) next(maxSize int64) (string, []byte, error) {
+	sr.once.Do(func() {
+		sr.wg.Add(len(sr.starts))
+		for i := range sr.starts {
+			go sr.readRange(i, maxSize)
+		}
+		go func() {
+			sr.wg.Wait()
+			close(sr.tests)
+		}()
+	})
+	t, ok := <-sr.tests
+	if !ok {
+		return "", nil, io.EOF
+	}
+	return t.name, t.data, t.err
+}
+
+// Close stops any ranges still being read, and waits for them to finish.
+func (sr *splitReader) Close() error {
+	sr.cancel()
+	sr.wg.Wait()
+	return nil
+}
+
+// Split implements etl.Splitter.  If the archive has an index, it arranges
+// for up to n byte ranges of the archive to be read concurrently, and
+// returns the number of ranges.  Otherwise the archive is read sequentially,
+// and Split returns 1.
+func (src *GCSSource) Split(n int) int {
+	if n < 2 || src.obj == nil || src.split != nil {
+		return 1
+	}
+	ctx, cancel := context.WithTimeout(context.Background(), time.Minute)
+	defer cancel()
+	rdr, err := src.index.NewReader(ctx)
+	if err == gcs.ErrObjectNotExist {
+		return 1
+	}
+	if err != nil {
+		log.Println("Reading index for", src.FilePath, err)
+		return 1
+	}
+	defer rdr.Close()
+	index, err := ioutil.ReadAll(rdr)
+	if err != nil {
+		log.Println("Reading index for", src.FilePath, err)
+		return 1
+	}
+	open := func(ctx context.Context, offset, length int64) (io.ReadCloser, error) {
+		return src.obj.NewRangeReader(ctx, offset, length)
+	}
+	return src.splitWith(index, open, src.gzipped, n)
+}
+
+// splitWith splits the source into up to n ranges, using index.
+func (src *GCSSource) splitWith(index []byte, open rangeOpener, gzipped bool, n int) int {
+	offsets, err := ParseIndex(index)
+	if err == nil && offsets[len(offsets)-1] >= src.Size {
+		err = ErrBadIndex
+	}
+	if err != nil {
+		log.Println("Ignoring index for", src.FilePath, err)
+		return 1
+	}
+	starts := splitRanges(offsets, src.Size, n)
+	if len(starts) < 2 {
+		return 1
+	}
+	// Stop the sequential read, which has not been used.
+	if src.Closer != nil {
+		src.Closer.Close()
+	}
+	src.split = newSplitReader(src, open, gzipped, starts)
+	src.Closer = src.split
+	return len(starts)
+}
@@ -0,0 +1,169 @@
+package storage_test
+
+import (
+	"archive/tar"
+	"bytes"
+	"compress/gzip"
+	"fmt"
+	"io"
+	"testing"
+	"time"
+
+	"github.com/m-lab/etl/storage"
+)
+
+func makeTar(t *testing.T, files map[string][]byte, names []string) []byte {
+	buf := &bytes.Buffer{}
+	tw := tar.NewWriter(buf)
+	for _, name := range names {
+		data := files[name]
+		if err := tw.WriteHeader(&tar.Header{Name: name, Mode: 0644, Size: int64(len(data)), Typeflag: tar.TypeReg}); err != nil {
+			t.Fatal(err)
+		}
+		tw.Write(data)
+	}
+	if err := tw.Close(); err != nil {
+		t.Fatal(err)
+	}
+	return buf.Bytes()
+}
+
+func readAllTests(t *testing.T, src *storage.GCSSource) map[string][]byte {
+	got := map[string][]byte{}
+	for {
+		name, data, err := src.NextTest(1 << 20)
+		if err == io.EOF {
+			return got
+		}
+		if err != nil {
+			t.Fatal(err)
+		}
+		got[name] = append([]byte{}, data...)
+		src.Release(data)
+	}
+}
+
+func TestSplit(t *testing.T) {
+	files := map[string][]byte{}
+	names := []string{}
+	for i := 0; i < 40; i++ {
+		name := fmt.Sprintf("test%02d.json", i)
+		files[name] = bytes.Repeat([]byte{byte('a' + i%26)}, 100*i+1)
+		names = append(names, name)
+	}
+	archive := makeTar(t, files, names)
+
+	offsets, err := storage.IndexTar(bytes.NewReader(archive), 8192)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if len(offsets) < 4 {
+		t.Fatal("Too few offsets", offsets)
+	}
+	index := &bytes.Buffer{}
+	storage.WriteIndex(index, offsets)
+	parsed, err := storage.ParseIndex(index.Bytes())
+	if err != nil || len(parsed) != len(offsets) {
+		t.Fatal(err, parsed)
+	}
+
+	check := func(name string, archive []byte, index []byte, gzipped bool) {
+		src := &storage.GCSSource{Size: int64(len(archive)), RetryBaseTime: time.Millisecond}
+		if n := storage.SplitForTest(src, index, archive, gzipped, 4); n != 4 {
+			t.Error(name, "Wrong number of ranges", n)
+		}
+		got := readAllTests(t, src)
+		if len(got) != len(files) {
+			t.Error(name, "Wrong number of tests", len(got))
+		}
+		for k, v := range files {
+			if !bytes.Equal(got[k], v) {
+				t.Error(name, "Wrong data for", k)
+			}
+		}
+		src.Close()
+	}
+	check("tar", archive, index.Bytes(), false)
+
+	// Block gzip, with one member per indexed portion.
+	gz := &bytes.Buffer{}
+	gzOffsets := []int64{}
+	for i, off := range offsets {
+		end := int64(len(archive))
+		if i+1 < len(offsets) {
+			end = offsets[i+1]
+		}
+		gzOffsets = append(gzOffsets, int64(gz.Len()))
+		zw := gzip.NewWriter(gz)
+		zw.Write(archive[off:end])
+		zw.Close()
+	}
+	gzIndex := &bytes.Buffer{}
+	storage.WriteIndex(gzIndex, gzOffsets)
+	check("tgz", gz.Bytes(), gzIndex.Bytes(), true)
+
+	// Bad indexes leave the source unsplit.
+	for _, bad := range []string{"", "1\n", "0\n10\n5\n", "0\nx\n", fmt.Sprintf("0\n%d\n", len(archive))} {
+		src := &storage.GCSSource{Size: int64(len(archive))}
+		if n := storage.SplitForTest(src, []byte(bad), archive, false, 4); n != 1 {
+			t.Errorf("Split with index %q should fail", bad)
+		}
+	}
+}
+
+func TestIndexGzipTar(t *testing.T) {
+	files := map[string][]byte{}
+	names := []string{}
+	for i := 0; i < 10; i++ {
+		name := fmt.Sprintf("test%02d.json", i)
+		files[name] = bytes.Repeat([]byte{byte('a' + i)}, 1000*i+1)
+		names = append(names, name)
+	}
+	archive := makeTar(t, files, names)
+	headers, err := storage.IndexTar(bytes.NewReader(archive), 1)
+	if err != nil || len(headers) != len(names) {
+		t.Fatal(err, headers)
+	}
+
+	// One member per entry, with every other entry split across two members.
+	gz := &bytes.Buffer{}
+	want := []int64{}
+	for i, off := range headers {
+		end := int64(len(archive))
+		if i+1 < len(headers) {
+			end = headers[i+1]
+		}
+		want = append(want, int64(gz.Len()))
+		parts := []int64{off, end}
+		if i%2 == 1 {
+			parts = []int64{off, off + 700, end}
+		}
+		for j := 1; j < len(parts); j++ {
+			zw := gzip.NewWriter(gz)
+			zw.Write(archive[parts[j-1]:parts[j]])
+			zw.Close()
+		}
+	}
+	got, err := storage.IndexGzipTar(bytes.NewReader(gz.Bytes()), 1)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if fmt.Sprint(got) != fmt.Sprint(want) {
+		t.Errorf("IndexGzipTar() = %v, want %v", got, want)
+	}
+	// Larger ranges skip some members.
+	got, err = storage.IndexGzipTar(bytes.NewReader(gz.Bytes()), want[3])
+	if err != nil || len(got) >= len(want) || got[0] != 0 {
+		t.Errorf("IndexGzipTar() = %v, %v, want fewer than %v", got, err, want)
+	}
+
+	// A single gzip stream has no other offsets.
+	single := &bytes.Buffer{}
+	zw := gzip.NewWriter(single)
+	zw.Write(archive)
+	zw.Close()
+	got, err = storage.IndexGzipTar(bytes.NewReader(single.Bytes()), 1)
+	if err != nil || len(got) != 1 {
+		t.Errorf("IndexGzipTar() = %v, %v, want [0]", got, err)
+	}
+}
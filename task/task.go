@@ -7,8 +7,11 @@ package task
 
 import (
 	"context"
+	"errors"
 	"io"
 	"log"
+	"sync"
+	"sync/atomic"
 	"time"
 
 	"cloud.google.com/go/bigquery"
@@ -41,6 +44,13 @@ type Task struct {
 
 	meta        map[string]bigquery.Value // Metadata about this task.
 	maxFileSize int64                     // Max file size to avoid OOM.
+	prefetch    int                       // Tests read ahead of parsing.  Zero for serial.
+	parsers     int                       // Parsing goroutines, for order independent parsers.
+
+	forkFlushErr error // Error flushing a forked parser, if any.
+	dropped      int64 // Tests that were not parsed, or failed to parse.
+
+	stages *metrics.TaskStages // Time spent in each stage, for the status page.
 
 	closer io.Closer // So we can call Close()
 }
@@ -58,14 +68,32 @@ func NewTask(filename string, src etl.TestSource, prsr etl.Parser, closer io.Clo
 		Parser:      prsr,
 		meta:        meta,
 		maxFileSize: DefaultMaxFileSize,
+		prefetch:    etl.PrefetchTests,
+		parsers:     etl.ParseWorkers,
+		stages:      metrics.NewTaskStages(filename, src.Type()),
 		closer:      closer}
+	// The source and parser may also record their stages.
+	if ss, ok := src.(stagesSetter); ok {
+		ss.SetStages(t.stages)
+	}
+	if ss, ok := prsr.(stagesSetter); ok {
+		ss.SetStages(t.stages)
+	}
 	return &t
 }
 
-// Close closes the source and sink.
-func (tt *Task) Close() {
+// stagesSetter is implemented by sources and parsers that record the time
+// spent in their stages of the task.
+type stagesSetter interface {
+	SetStages(*metrics.TaskStages)
+}
+
+// Close closes the source and sink.  It returns any error from closing the
+// sink, since for some sinks, e.g. GCS objects, the output is not complete
+// until Close succeeds.
+func (tt *Task) Close() error {
 	tt.TestSource.Close()
-	tt.closer.Close()
+	return tt.closer.Close()
 }
 
 // SetMaxFileSize overrides the default maxFileSize.
@@ -73,41 +101,49 @@ func (tt *Task) SetMaxFileSize(max int64) {
 	tt.maxFileSize = max
 }
 
+// SetPipeline overrides the default pipelining, from etl.PrefetchTests and
+// etl.ParseWorkers.  If prefetch is positive, up to prefetch tests are read
+// and decompressed ahead of parsing, and order independent parsers are run
+// in up to parsers goroutines.  If prefetch is zero, tests are read and
+// parsed serially.
+func (tt *Task) SetPipeline(prefetch int, parsers int) {
+	tt.prefetch = prefetch
+	tt.parsers = parsers
+}
+
 // This is used for logging empty test warnings.
 // TODO - consider just removing the log.
 var emptyTest = logx.NewLogEvery(nil, time.Second)
 
-// ProcessAllTests loops through all the tests in a tar file, calls the
-// injected parser to parse them, and inserts them into bigquery. Returns the
-// number of files processed.
-// TODO pass in the datatype label.
-func (tt *Task) ProcessAllTests(failfast bool) (int, error) {
-	if tt.Parser == nil {
-		panic("Parser is nil")
-	}
-	metrics.WorkerState.WithLabelValues(tt.Type(), "task").Inc()
-	defer metrics.WorkerState.WithLabelValues(tt.Type(), "task").Dec()
-	files := 0
-	nilData := 0
-	var testname string
-	var data []byte
-	var loopErr error
-	// Read each file from the tar
+// testCounts tracks the files read by nextTest.
+type testCounts struct {
+	files    int
+	nilData  int
+	oversize int
+}
 
-OUTER:
-	for testname, data, loopErr = tt.NextTest(tt.maxFileSize); loopErr != io.EOF; testname, data, loopErr = tt.NextTest(tt.maxFileSize) {
-		files++
-		if loopErr != nil {
+// nextTest reads tests from the source until it finds one to parse.  It
+// handles and counts oversize, empty and unparsable files.  It returns io.EOF
+// at the end of the archive, or any unrecoverable error.
+func (tt *Task) nextTest(counts *testCounts) (string, []byte, error) {
+	for {
+		start := time.Now()
+		testname, data, err := tt.NextTest(tt.maxFileSize)
+		if err == io.EOF {
+			return "", nil, err
+		}
+		tt.stages.Observe(tt.Type(), metrics.StageRead, start, len(data), 0)
+		counts.files++
+		if err != nil {
 			switch {
-			case loopErr == io.EOF:
-				break OUTER
-			case loopErr == storage.ErrOversizeFile:
+			case err == storage.ErrOversizeFile:
 				log.Printf("ERROR filename:%s testname:%s files:%d, duration:%v err:%v",
-					tt.meta["filename"], testname, files,
-					time.Since(tt.meta["parse_time"].(time.Time)), loopErr)
+					tt.meta["filename"], testname, counts.files,
+					time.Since(tt.meta["parse_time"].(time.Time)), err)
 				metrics.TestCount.WithLabelValues(
 					tt.Type(), "unknown", "oversize file").Inc()
-				continue OUTER
+				counts.oversize++
+				continue
 			default:
 				// We are seeing several of these per hour, a little more than
 				// one in one thousand files.  duration varies from 10 seconds
@@ -120,20 +156,20 @@ OUTER:
 				// Because of the break, this error is passed up, and counted at
 				// the Task level.
 				log.Printf("ERROR filename:%s testname:%s files:%d, duration:%v err:%v",
-					tt.meta["filename"], testname, files,
-					time.Since(tt.meta["parse_time"].(time.Time)), loopErr)
+					tt.meta["filename"], testname, counts.files,
+					time.Since(tt.meta["parse_time"].(time.Time)), err)
 
 				metrics.TestCount.WithLabelValues(
 					tt.Type(), "unknown", "unrecovered").Inc()
 				// Since we don't understand these errors, safest thing to do is
 				// stop processing the tar file (and task).
-				break OUTER
+				return testname, nil, err
 			}
 		}
 		if data == nil {
 			// TODO(dev) Handle directories (expected) and other
 			// things separately.
-			nilData++
+			counts.nilData++
 			// If verbose, log the filename that is skipped.
 			continue
 		}
@@ -149,30 +185,176 @@ OUTER:
 			metrics.FileSizeHistogram.WithLabelValues(
 				tt.Type(), kind, "ignored").Observe(float64(len(data)))
 			// Don't bother calling ParseAndInsert since this is unparsable.
+			tt.Release(data)
 			continue
-		} else {
-			metrics.FileSizeHistogram.WithLabelValues(
-				tt.Type(), kind, "parsed").Observe(float64(len(data)))
 		}
-		loopErr = tt.Parser.ParseAndInsert(tt.meta, testname, data)
-		// Shouldn't have any of these, as they should be handled in ParseAndInsert.
-		if loopErr != nil {
-			metrics.TaskCount.WithLabelValues(
-				tt.Type(), "ParseAndInsertError").Inc()
-			log.Printf("ERROR %v", loopErr)
-			// TODO(dev) Handle this error properly!
-			if failfast {
-				break OUTER
+		metrics.FileSizeHistogram.WithLabelValues(
+			tt.Type(), kind, "parsed").Observe(float64(len(data)))
+		return testname, data, nil
+	}
+}
+
+// parseTest parses a single test, and releases the data if possible.
+func (tt *Task) parseTest(p etl.Parser, testname string, data []byte, retains bool) error {
+	start := time.Now()
+	err := p.ParseAndInsert(tt.meta, testname, data)
+	tt.stages.Observe(tt.Type(), metrics.StageParse, start, len(data), 0)
+	if !retains {
+		tt.Release(data)
+	}
+	// Shouldn't have any of these, as they should be handled in ParseAndInsert.
+	if err != nil {
+		metrics.TaskCount.WithLabelValues(
+			tt.Type(), "ParseAndInsertError").Inc()
+		log.Printf("ERROR %v", err)
+		atomic.AddInt64(&tt.dropped, 1)
+		// TODO(dev) Handle this error properly!
+	}
+	return err
+}
+
+// processSerial reads and parses each test in turn.
+func (tt *Task) processSerial(failfast bool, retains bool, counts *testCounts) error {
+	for {
+		testname, data, err := tt.nextTest(counts)
+		if err != nil {
+			return err
+		}
+		err = tt.parseTest(tt.Parser, testname, data, retains)
+		if err != nil && failfast {
+			return err
+		}
+	}
+}
+
+type testData struct {
+	name string
+	data []byte
+}
+
+// processPipelined reads tests in one goroutine, up to tt.prefetch ahead of
+// the parsing goroutines.  Parsers that are order independent are given
+// tt.parsers goroutines, each with its own fork if the parser is an
+// etl.Forker.  Others are given one, so tests are parsed in archive order.
+func (tt *Task) processPipelined(failfast bool, retains bool, counts *testCounts) error {
+	tests := make(chan testData, tt.prefetch)
+	stop := make(chan struct{})
+	var readErr error
+	go func() {
+		// readErr and counts are visible to the caller once the parsers
+		// see the channel closed.
+		defer close(tests)
+		for {
+			testname, data, err := tt.nextTest(counts)
+			if err != nil {
+				readErr = err
+				return
+			}
+			select {
+			case tests <- testData{testname, data}:
+			case <-stop:
+				if !retains {
+					tt.Release(data)
+				}
+				readErr = errStopped
+				return
+			}
+		}
+	}()
+
+	// Each goroutine uses its own fork of the parser, if possible.
+	parsers := []etl.Parser{tt.Parser}
+	if oi, ok := tt.Parser.(etl.OrderIndependent); ok && oi.OrderIndependent() {
+		forker, canFork := tt.Parser.(etl.Forker)
+		for len(parsers) < tt.parsers {
+			if canFork {
+				parsers = append(parsers, forker.Fork())
+			} else {
+				parsers = append(parsers, tt.Parser)
 			}
-			continue
 		}
 	}
+	var parseErr error
+	var once sync.Once
+	wg := sync.WaitGroup{}
+	flushErrs := make([]error, len(parsers))
+	for i := range parsers {
+		wg.Add(1)
+		go func(i int, p etl.Parser) {
+			defer wg.Done()
+			if p != tt.Parser {
+				// The original parser is flushed by ProcessAllTests.
+				defer func() { flushErrs[i] = p.Flush() }()
+			}
+			for t := range tests {
+				select {
+				case <-stop:
+					// Drain, so that the reader is not blocked.
+					if !retains {
+						tt.Release(t.data)
+					}
+					continue
+				default:
+				}
+				err := tt.parseTest(p, t.name, t.data, retains)
+				if err != nil && failfast {
+					once.Do(func() {
+						parseErr = err
+						close(stop)
+					})
+				}
+			}
+		}(i, parsers[i])
+	}
+	wg.Wait()
+	for _, err := range flushErrs {
+		if err != nil {
+			log.Printf("%v", err)
+			tt.forkFlushErr = err
+		}
+	}
+	if parseErr != nil {
+		return parseErr
+	}
+	return readErr
+}
+
+// errStopped is used internally when reading is stopped by a parse error.
+var errStopped = errors.New("stopped")
+
+// ProcessAllTests loops through all the tests in a tar file, calls the
+// injected parser to parse them, and inserts them into bigquery. Returns the
+// number of files processed.
+// TODO pass in the datatype label.
+func (tt *Task) ProcessAllTests(failfast bool) (int, error) {
+	if tt.Parser == nil {
+		panic("Parser is nil")
+	}
+	metrics.WorkerState.WithLabelValues(tt.Type(), "task").Inc()
+	defer metrics.WorkerState.WithLabelValues(tt.Type(), "task").Dec()
+	tt.stages.Start()
+	defer tt.stages.Finish()
+	// Return buffers to the source for reuse, unless the parser holds them.
+	retainer, ok := tt.Parser.(etl.DataRetainer)
+	retains := ok && retainer.RetainsData()
+
+	counts := testCounts{}
+	var loopErr error
+	if tt.prefetch > 0 {
+		loopErr = tt.processPipelined(failfast, retains, &counts)
+	} else {
+		loopErr = tt.processSerial(failfast, retains, &counts)
+	}
+	files, nilData := counts.files, counts.nilData
+	tt.dropped += int64(counts.oversize)
 
 	// There may be an error from the processing loop, but we wait to handle that
 	// error until after we flush and cached rows.
 	flushErr := tt.Flush()
 	if flushErr != nil {
 		log.Printf("%v", flushErr)
+	} else {
+		flushErr = tt.forkFlushErr
 	}
 
 	// TODO - make this debug or remove
@@ -193,3 +375,9 @@ OUTER:
 	// Otherwise, return any error from the call to Flush.
 	return files, flushErr
 }
+
+// Complete reports whether ProcessAllTests parsed every test, and whether
+// every row was committed, with none failed or left in the buffer.
+func (tt *Task) Complete() bool {
+	return tt.dropped == 0 && tt.Parser.Failed() == 0 && tt.Parser.RowsInBuffer() == 0
+}
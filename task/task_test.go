@@ -8,6 +8,8 @@ import (
 	"errors"
 	"fmt"
 	"reflect"
+	"sort"
+	"sync"
 	"testing"
 
 	"cloud.google.com/go/bigquery"
@@ -186,5 +188,101 @@ func TestTarFileInput(t *testing.T) {
 	if !reflect.DeepEqual(tp.files, []string{"foo", "bar"}) {
 		t.Error("Not expected files: ", tp.files)
 	}
+	// The oversize file was dropped.
+	if tt.Complete() {
+		t.Error("Expected incomplete task")
+	}
+
+	tt = task.NewTask("filename", MakeTestSource(t), &TestParser{}, &NullCloser{})
+	if _, err := tt.ProcessAllTests(false); err != nil {
+		t.Error("Expected nil error, but got ", err)
+	}
+	if !tt.Complete() {
+		t.Error("Expected complete task")
+	}
+}
+
+// retainingParser keeps the test data, so it must not be released.
+type retainingParser struct {
+	TestParser
+	data []string
+	raw  [][]byte
+}
+
+func (rp *retainingParser) ParseAndInsert(meta map[string]bigquery.Value, testName string, test []byte) error {
+	rp.data = append(rp.data, string(test))
+	rp.raw = append(rp.raw, test)
+	return nil
+}
+
+func (rp *retainingParser) RetainsData() bool {
+	return true
+}
+
+func TestRetainedDataNotReleased(t *testing.T) {
+	rp := &retainingParser{}
+	tt := task.NewTask("filename", MakeTestSource(t), rp, &NullCloser{})
+	tt.SetMaxFileSize(100)
+	if _, err := tt.ProcessAllTests(false); err != nil {
+		t.Fatal(err)
+	}
+	if len(rp.raw) != 2 {
+		t.Fatal("Expected two files: ", len(rp.raw))
+	}
+	for i := range rp.raw {
+		if string(rp.raw[i]) != rp.data[i] {
+			t.Errorf("Retained data overwritten: %q != %q", rp.raw[i], rp.data[i])
+		}
+	}
+}
+
+// concurrentParser is an order independent TestParser.
+type concurrentParser struct {
+	TestParser
+	lock sync.Mutex
+}
+
+func (cp *concurrentParser) ParseAndInsert(meta map[string]bigquery.Value, testName string, test []byte) error {
+	cp.lock.Lock()
+	defer cp.lock.Unlock()
+	return cp.TestParser.ParseAndInsert(meta, testName, test)
+}
 
+func (cp *concurrentParser) OrderIndependent() bool {
+	return true
+}
+
+func TestPipelinedInput(t *testing.T) {
+	// Ordered parser.
+	tp := &TestParser{}
+	tt := task.NewTask("filename", MakeTestSource(t), tp, &NullCloser{})
+	tt.SetMaxFileSize(100)
+	tt.SetPipeline(2, 4)
+	fc, err := tt.ProcessAllTests(false)
+	if err != nil {
+		t.Error("Expected nil error, but got ", err)
+	}
+	if fc != 3 {
+		t.Error("Expected 3 files: ", fc)
+	}
+	if !reflect.DeepEqual(tp.files, []string{"foo", "bar"}) {
+		t.Error("Not expected files: ", tp.files)
+	}
+
+	// Order independent parser.
+	cp := &concurrentParser{}
+	tt = task.NewTask("filename", MakeTestSource(t), cp, &NullCloser{})
+	tt.SetMaxFileSize(100)
+	tt.SetPipeline(1, 4)
+	fc, err = tt.ProcessAllTests(true)
+	if err != nil {
+		t.Error("Expected nil error, but got ", err)
+	}
+	if fc != 3 {
+		t.Error("Expected 3 files: ", fc)
+	}
+	sort.Strings(cp.files)
+	if !reflect.DeepEqual(cp.files, []string{"bar", "foo"}) {
+		t.Error("Not expected files: ", cp.files)
+	}
 }
@@ -0,0 +1,303 @@
+package web100
+
+import (
+	"encoding/json"
+	"errors"
+	"strconv"
+)
+
+// FieldID identifies a field within a Columns store.  IDs below the number of
+// snapshot fields correspond to fields of the SnapLog decoder plan.  Other
+// names saved through the Saver interface are assigned IDs above that.
+type FieldID uint16
+
+type columnRow struct {
+	ints, strs, bools int32 // End offsets of this row in each value slice.
+}
+
+// Columns is a columnar Saver for a series of records, e.g. snapshot deltas,
+// from a single SnapLog.  Values are held in typed slices tagged by FieldID,
+// instead of one map[string]bigquery.Value per record, so a log with
+// thousands of deltas costs a handful of allocations rather than thousands
+// of maps and boxed integers.
+//
+// Columns implements json.Marshaler, encoding the records as a JSON array of
+// objects, so it can be placed directly in a row for either BigQuery or GCS
+// output.
+// Columns is NOT THREAD-SAFE.
+type Columns struct {
+	plan  *decodePlan
+	names []string           // Field names, indexed by FieldID.
+	index map[string]FieldID // Lazily built, for the name based Saver methods.
+	omit  []bool             // Fields that are never saved, indexed by FieldID.
+
+	intIDs  []FieldID
+	ints    []int64
+	strIDs  []FieldID
+	strs    []string
+	boolIDs []FieldID
+	bools   []bool
+
+	rows []columnRow
+}
+
+// NewColumns creates an empty Columns store for records from sl.
+// rowHint and valueHint size the initial allocations.
+func NewColumns(sl *SnapLog, rowHint int, valueHint int) *Columns {
+	names := make([]string, len(sl.plan.fields), len(sl.plan.fields)+4)
+	for i := range sl.plan.fields {
+		names[i] = sl.plan.fields[i].name
+	}
+	return &Columns{
+		plan:   sl.plan,
+		names:  names,
+		omit:   make([]bool, len(names), cap(names)),
+		intIDs: make([]FieldID, 0, valueHint),
+		ints:   make([]int64, 0, valueHint),
+		rows:   make([]columnRow, 0, rowHint),
+	}
+}
+
+// ID returns the FieldID for name, adding a new ID if necessary.
+func (c *Columns) ID(name string) FieldID {
+	if c.index == nil {
+		c.index = make(map[string]FieldID, len(c.names)+4)
+		for i, n := range c.names {
+			c.index[n] = FieldID(i)
+		}
+	}
+	id, ok := c.index[name]
+	if !ok {
+		id = FieldID(len(c.names))
+		c.names = append(c.names, name)
+		c.omit = append(c.omit, false)
+		c.index[name] = id
+	}
+	return id
+}
+
+// Name returns the name of the field with the given ID.
+func (c *Columns) Name(id FieldID) string {
+	return c.names[id]
+}
+
+// Omit causes all subsequent values for the named fields to be discarded.
+func (c *Columns) Omit(names ...string) {
+	for _, name := range names {
+		c.omit[c.ID(name)] = true
+	}
+}
+
+// StartRow begins a new record.  Subsequent values are saved to this record.
+func (c *Columns) StartRow() {
+	c.rows = append(c.rows, columnRow{int32(len(c.ints)), int32(len(c.strs)), int32(len(c.bools))})
+}
+
+// rowStart returns the start offsets of row i.
+func (c *Columns) rowStart(i int) columnRow {
+	if i == 0 {
+		return columnRow{}
+	}
+	return c.rows[i-1]
+}
+
+// DropRow discards the current record, and all of its values.
+func (c *Columns) DropRow() {
+	if len(c.rows) == 0 {
+		return
+	}
+	start := c.rowStart(len(c.rows) - 1)
+	c.intIDs, c.ints = c.intIDs[:start.ints], c.ints[:start.ints]
+	c.strIDs, c.strs = c.strIDs[:start.strs], c.strs[:start.strs]
+	c.boolIDs, c.bools = c.boolIDs[:start.bools], c.bools[:start.bools]
+	c.rows = c.rows[:len(c.rows)-1]
+}
+
+// NumRows returns the number of records.
+func (c *Columns) NumRows() int {
+	return len(c.rows)
+}
+
+// RowLen returns the number of values in record i.
+func (c *Columns) RowLen(i int) int {
+	start, end := c.rowStart(i), c.rows[i]
+	return int(end.ints - start.ints + end.strs - start.strs + end.bools - start.bools)
+}
+
+// SizeBytes returns the approximate memory held by the value slices.
+func (c *Columns) SizeBytes() int {
+	n := cap(c.intIDs)*2 + cap(c.ints)*8 + cap(c.boolIDs)*2 + cap(c.bools) +
+		cap(c.strIDs)*2 + cap(c.strs)*16 + cap(c.rows)*12
+	for _, s := range c.strs {
+		n += len(s)
+	}
+	return n
+}
+
+// Size returns an upper estimate of the length of the JSON encoding of the
+// records, ignoring string escapes.  It implements row.Sizer, so that rows
+// holding Columns are measured without encoding them.
+func (c *Columns) Size() int {
+	n := len("[]") + len("{},")*len(c.rows)
+	for j, id := range c.intIDs {
+		n += len(c.names[id]) + len(`"":,`) + intLen(c.ints[j])
+	}
+	for j, id := range c.strIDs {
+		n += len(c.names[id]) + len(`"":,`) + len(c.strs[j]) + 2
+	}
+	for _, id := range c.boolIDs {
+		n += len(c.names[id]) + len(`"":,`) + len("false")
+	}
+	return n
+}
+
+// intLen returns the length of the decimal encoding of v.
+func intLen(v int64) int {
+	n := 1
+	u := uint64(v)
+	if v < 0 {
+		n++
+		u = uint64(-v)
+	}
+	for u >= 10 {
+		u /= 10
+		n++
+	}
+	return n
+}
+
+// RowInt64 returns the value of an integer field in record i, if present.
+func (c *Columns) RowInt64(i int, name string) (int64, bool) {
+	id := c.ID(name)
+	start, end := c.rowStart(i), c.rows[i]
+	for j := start.ints; j < end.ints; j++ {
+		if c.intIDs[j] == id {
+			return c.ints[j], true
+		}
+	}
+	return 0, false
+}
+
+// setInt64 saves an integer value by ID in the current record.
+func (c *Columns) setInt64(id FieldID, value int64) {
+	if c.omit[id] || len(c.rows) == 0 {
+		return
+	}
+	c.intIDs = append(c.intIDs, id)
+	c.ints = append(c.ints, value)
+	c.rows[len(c.rows)-1].ints++
+}
+
+func (c *Columns) setString(id FieldID, value string) {
+	if c.omit[id] || len(c.rows) == 0 {
+		return
+	}
+	c.strIDs = append(c.strIDs, id)
+	c.strs = append(c.strs, value)
+	c.rows[len(c.rows)-1].strs++
+}
+
+func (c *Columns) setBool(id FieldID, value bool) {
+	if c.omit[id] || len(c.rows) == 0 {
+		return
+	}
+	c.boolIDs = append(c.boolIDs, id)
+	c.bools = append(c.bools, value)
+	c.rows[len(c.rows)-1].bools++
+}
+
+// SetInt64 implements Saver.
+func (c *Columns) SetInt64(name string, value int64) {
+	c.setInt64(c.ID(name), value)
+}
+
+// SetString implements Saver.
+func (c *Columns) SetString(name string, value string) {
+	c.setString(c.ID(name), value)
+}
+
+// SetBool implements Saver.
+func (c *Columns) SetBool(name string, value bool) {
+	c.setBool(c.ID(name), value)
+}
+
+// SnapshotDeltasTo saves the fields of snap that differ from other into the
+// current record of cols.  If other is empty, all fields are saved.
+// This is equivalent to SnapshotDeltas, but avoids the name based Saver
+// interface.  cols must have been created from the SnapLog containing snap.
+func (snap *Snapshot) SnapshotDeltasTo(other *Snapshot, cols *Columns) error {
+	if snap.raw == nil {
+		return errors.New("Empty/Invalid Snaplog")
+	}
+	if snap.plan != cols.plan {
+		return errors.New("Columns created for a different SnapLog")
+	}
+	if other.raw == nil {
+		for i := range snap.plan.fields {
+			cols.saveField(i, snap.raw)
+		}
+		return nil
+	}
+	snap.plan.forEachChanged(snap.raw, other.raw, func(i int) {
+		cols.saveField(i, snap.raw)
+	})
+	return nil
+}
+
+// saveField decodes plan field i from raw and saves it in the current record.
+func (c *Columns) saveField(i int, raw []byte) {
+	if c.omit[i] {
+		return
+	}
+	f := &c.plan.fields[i]
+	b := raw[f.offset : f.offset+f.size]
+	if !f.isString() {
+		c.setInt64(FieldID(i), f.decodeInt64(b))
+		return
+	}
+	str, err := f.decodeString(b)
+	if err == nil {
+		c.setString(FieldID(i), str)
+	}
+}
+
+// MarshalJSON implements json.Marshaler.
+func (c *Columns) MarshalJSON() ([]byte, error) {
+	out := make([]byte, 0, 64+len(c.ints)*24)
+	out = append(out, '[')
+	for i := range c.rows {
+		if i > 0 {
+			out = append(out, ',')
+		}
+		out = append(out, '{')
+		start, end := c.rowStart(i), c.rows[i]
+		first := true
+		key := func(id FieldID) {
+			if !first {
+				out = append(out, ',')
+			}
+			first = false
+			out = strconv.AppendQuote(out, c.names[id])
+			out = append(out, ':')
+		}
+		for j := start.ints; j < end.ints; j++ {
+			key(c.intIDs[j])
+			out = strconv.AppendInt(out, c.ints[j], 10)
+		}
+		for j := start.strs; j < end.strs; j++ {
+			key(c.strIDs[j])
+			s, err := json.Marshal(c.strs[j])
+			if err != nil {
+				return nil, err
+			}
+			out = append(out, s...)
+		}
+		for j := start.bools; j < end.bools; j++ {
+			key(c.boolIDs[j])
+			out = strconv.AppendBool(out, c.bools[j])
+		}
+		out = append(out, '}')
+	}
+	out = append(out, ']')
+	return out, nil
+}
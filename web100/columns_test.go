@@ -0,0 +1,110 @@
+package web100_test
+
+import (
+	"encoding/json"
+	"io/ioutil"
+	"reflect"
+	"testing"
+
+	"github.com/m-lab/etl/web100"
+)
+
+type mapSaver map[string]interface{}
+
+func (s mapSaver) SetInt64(name string, val int64)   { s[name] = val }
+func (s mapSaver) SetString(name string, val string) { s[name] = val }
+func (s mapSaver) SetBool(name string, val bool)     { s[name] = val }
+
+// Columns should encode the same deltas as the map based Saver.
+func TestColumnsMatchesMapDeltas(t *testing.T) {
+	name := `20170509T13:45:13.590210000Z_eb.measurementlab.net:48716.c2s_snaplog`
+	data, err := ioutil.ReadFile(`testdata/web100/` + name)
+	if err != nil {
+		t.Fatal(err)
+	}
+	slog, err := web100.NewSnapLog(data)
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	cols := web100.NewColumns(slog, 10, 100)
+	cols.Omit("StartTimeStamp", "LocalAddress")
+	expected := []mapSaver{}
+	last := &web100.Snapshot{}
+	for i := 0; i < 100; i++ {
+		snap, err := slog.Snapshot(i)
+		if err != nil {
+			t.Fatal(err)
+		}
+		m := mapSaver{}
+		snap.SnapshotDeltas(last, m)
+		delete(m, "StartTimeStamp")
+		delete(m, "LocalAddress")
+		m["snapshot_num"] = int64(i)
+		expected = append(expected, m)
+
+		cols.StartRow()
+		if err := snap.SnapshotDeltasTo(last, cols); err != nil {
+			t.Fatal(err)
+		}
+		cols.SetInt64("snapshot_num", int64(i))
+		if cols.RowLen(i) != len(m) {
+			t.Errorf("RowLen(%d) = %d, want %d", i, cols.RowLen(i), len(m))
+		}
+		last = &snap
+	}
+	// Add and drop an extra row.
+	cols.StartRow()
+	cols.SetBool("is_last", true)
+	cols.DropRow()
+	cols.SetBool("is_last", true)
+	expected[len(expected)-1]["is_last"] = true
+
+	if cols.NumRows() != len(expected) {
+		t.Fatalf("NumRows() = %d, want %d", cols.NumRows(), len(expected))
+	}
+	if v, ok := cols.RowInt64(1, "snapshot_num"); !ok || v != 1 {
+		t.Errorf("RowInt64() = %d, %v", v, ok)
+	}
+
+	got, err := json.Marshal(cols)
+	if err != nil {
+		t.Fatal(err)
+	}
+	want, err := json.Marshal(expected)
+	if err != nil {
+		t.Fatal(err)
+	}
+	var gotRows, wantRows []map[string]interface{}
+	if err := json.Unmarshal(got, &gotRows); err != nil {
+		t.Fatal(err, string(got))
+	}
+	json.Unmarshal(want, &wantRows)
+	if !reflect.DeepEqual(gotRows, wantRows) {
+		t.Error("Columns JSON does not match map deltas")
+	}
+}
+
+// Deltas through SnapshotDeltasTo.
+func BenchmarkColumnsDeltas(b *testing.B) {
+	data, err := ioutil.ReadFile(`testdata/web100/20090601T22:19:19.325928000Z-75.133.69.98:60631.s2c_snaplog`)
+	if err != nil {
+		b.Fatal(err)
+	}
+	slog, err := web100.NewSnapLog(data)
+	if err != nil {
+		b.Fatal(err)
+	}
+	b.ReportAllocs()
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		cols := web100.NewColumns(slog, 256, 2560)
+		last := web100.Snapshot{}
+		for n := 0; n < slog.SnapCount(); n++ {
+			snap, _ := slog.Snapshot(n)
+			cols.StartRow()
+			snap.SnapshotDeltasTo(&last, cols)
+			last = snap
+		}
+	}
+}
@@ -0,0 +1,163 @@
+package web100
+
+import (
+	"errors"
+	"sort"
+)
+
+// Integer matrices.
+//   Analyses that need random access to a whole log, such as the NDT
+//   congestion event slices, read a few integer fields from every snapshot.
+//   Rather than resolving the field and decoding it through a Saver once per
+//   snapshot per field, DecodeInts decodes all the requested fields in a
+//   single pass over the snapshot body, into a dense column major matrix.
+//   Slices of a field are then just indexing into its column.  Columns are
+//   decoded on first use, and cached in the SnapLog, so repeated queries over
+//   one log decode each field only once.
+//
+//   The record layout is the one written by web100_userland (see config.h),
+//   with little endian values, as for all M-Lab snaplogs.
+//
+//   There is no native or assembly kernel.  Fields have mixed widths and
+//   arbitrary offsets within records of a few hundred bytes, so each value
+//   is a single unaligned load, and the loop is dominated by striding through
+//   the body, which a vector kernel would not avoid.  A native kernel would
+//   also need a build tagged fallback for every platform, for little gain.
+
+// ErrNotInteger is returned for fields that are not decoded as integers.
+var ErrNotInteger = errors.New("Not an integer field")
+
+// IntMatrix holds the values of some integer fields for every snapshot of a
+// SnapLog, indexed by snapshot and field.
+type IntMatrix struct {
+	names []string  // Field names, as requested.
+	rows  int       // Number of snapshots.
+	cols  [][]int64 // Column for each name, shared with the SnapLog cache.
+}
+
+// Rows returns the number of snapshots in the matrix.
+func (m *IntMatrix) Rows() int {
+	return m.rows
+}
+
+// Column returns the values of the named field for every snapshot, or nil
+// if the field is not in the matrix.  The result must not be modified.
+func (m *IntMatrix) Column(name string) []int64 {
+	for c, n := range m.names {
+		if n == name {
+			return m.cols[c]
+		}
+	}
+	return nil
+}
+
+// Slice returns the values of the named field at the snapshot indices.
+func (m *IntMatrix) Slice(name string, indices []int) []int64 {
+	col := m.Column(name)
+	result := make([]int64, 0, len(indices))
+	if col == nil {
+		return result
+	}
+	for _, i := range indices {
+		result = append(result, col[i])
+	}
+	return result
+}
+
+// ChangeIndices returns the snapshot indices at which the value of the named
+// field changes, including the first snapshot if its value is not zero.
+// Unlike SnapLog.ChangeIndices, this compares decoded values, not raw bytes.
+func (m *IntMatrix) ChangeIndices(name string) []int {
+	col := m.Column(name)
+	if col == nil {
+		return nil
+	}
+	result := make([]int, 0, 100)
+	last := int64(0)
+	for i, v := range col {
+		if v != last {
+			result = append(result, i)
+		}
+		last = v
+	}
+	return result
+}
+
+// intField returns the decoder plan index of the named "/read" field, which
+// must be decoded as an integer.  The name may be either the name in the
+// header, or the canonical name, e.g. HCThruOctetsAcked for ThruBytesAcked.
+func (sl *SnapLog) intField(name string) (int, error) {
+	fields := sl.plan.fields
+	v := sl.read.find(name)
+	if v == nil {
+		for i := range fields {
+			if fields[i].name == name && !fields[i].isString() {
+				return i, nil
+			}
+		}
+		return -1, errors.New("Field not found")
+	}
+	// Plan fields are in offset order, and omit only deprecated fields.
+	i := sort.Search(len(fields), func(i int) bool { return fields[i].offset >= v.Offset })
+	if i == len(fields) || fields[i].offset != v.Offset || fields[i].isString() {
+		return -1, ErrNotInteger
+	}
+	return i, nil
+}
+
+// DecodeInts returns the named integer fields of every snapshot.  Any fields
+// not already cached are decoded together, in a single pass.  It returns an
+// error if any field is missing or not an integer, or if any snapshot is
+// missing its BEGIN_SNAP_DATA marker.
+func (sl *SnapLog) DecodeInts(names ...string) (*IntMatrix, error) {
+	ids := make([]int, len(names))
+	for i, name := range names {
+		id, err := sl.intField(name)
+		if err != nil {
+			return nil, err
+		}
+		ids[i] = id
+	}
+	rows := sl.SnapCount()
+	if sl.validPrefix() < rows {
+		return nil, errors.New("missing BeginSnapData")
+	}
+	if sl.intCols == nil {
+		sl.intCols = make([][]int64, len(sl.plan.fields))
+	}
+	missing := make([]int, 0, len(ids))
+	for _, id := range ids {
+		if sl.intCols[id] == nil {
+			// Mark it, in case the same field is named twice.
+			sl.intCols[id] = []int64{}
+			missing = append(missing, id)
+		}
+	}
+	if len(missing) > 0 {
+		fields := make([]*planField, len(missing))
+		for c, id := range missing {
+			fields[c] = &sl.plan.fields[id]
+		}
+		values := make([]int64, len(missing)*rows)
+		decodeInts(sl.raw[sl.bodyOffset:], sl.read.Length, rows, fields, values)
+		for c, id := range missing {
+			sl.intCols[id] = values[c*rows : (c+1)*rows : (c+1)*rows]
+		}
+	}
+	m := &IntMatrix{names: names, rows: rows, cols: make([][]int64, len(ids))}
+	for c, id := range ids {
+		m.cols[c] = sl.intCols[id]
+	}
+	return m, nil
+}
+
+// decodeInts decodes fields from each of the first rows records of body,
+// into the column major matrix out.
+func decodeInts(body []byte, recordLen int, rows int, fields []*planField, out []int64) {
+	for s := 0; s < rows; s++ {
+		rec := body[s*recordLen+len(BEGIN_SNAP_DATA) : (s+1)*recordLen]
+		for c, f := range fields {
+			out[c*rows+s] = f.decodeInt64(rec[f.offset : f.offset+f.size])
+		}
+	}
+}
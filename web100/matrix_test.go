@@ -0,0 +1,184 @@
+package web100
+
+import (
+	"io/ioutil"
+	"reflect"
+	"testing"
+)
+
+// The matrix must hold exactly the values saved by the decoder plan.
+func TestDecodeIntsMatchesSnapshots(t *testing.T) {
+	names := []string{
+		`20170509T13:45:13.590210000Z_eb.measurementlab.net:48716.c2s_snaplog`,
+		`20090601T22:19:19.325928000Z-75.133.69.98:60631.s2c_snaplog`,
+	}
+	for _, name := range names {
+		data, err := ioutil.ReadFile(`testdata/web100/` + name)
+		if err != nil {
+			t.Fatal(err)
+		}
+		slog, err := NewSnapLog(data)
+		if err != nil {
+			t.Fatal(err)
+		}
+		// All integer fields, by their names in the header.
+		fields := []string{}
+		canonical := map[string]string{}
+		for _, v := range slog.read.Fields {
+			if id, err := slog.intField(v.Name); err == nil {
+				fields = append(fields, v.Name)
+				canonical[v.Name] = slog.plan.fields[id].name
+			}
+		}
+		m, err := slog.DecodeInts(fields...)
+		if err != nil {
+			t.Fatal(err)
+		}
+		if m.Rows() != slog.SnapCount() {
+			t.Fatalf("%s: Rows() = %d, want %d", name, m.Rows(), slog.SnapCount())
+		}
+		for _, n := range []int{0, 1, 1000, slog.SnapCount() - 1} {
+			snap, err := slog.Snapshot(n)
+			if err != nil {
+				t.Fatal(err)
+			}
+			want := mapSaver{}
+			snap.SnapshotValues(want)
+			for _, field := range fields {
+				if got := m.Column(field)[n]; got != want[canonical[field]] {
+					t.Errorf("%s[%d].%s = %d, want %v", name, n, field, got, want[canonical[field]])
+				}
+			}
+		}
+
+		indices, err := slog.ChangeIndices("SmoothedRTT")
+		if err != nil {
+			t.Fatal(err)
+		}
+		if got := m.ChangeIndices("SmoothedRTT"); !reflect.DeepEqual(got, indices) {
+			t.Errorf("%s: ChangeIndices() = %v, want %v", name, got, indices)
+		}
+		want := []int64{}
+		for _, n := range indices {
+			want = append(want, m.Column("SmoothedRTT")[n])
+		}
+		if got := slog.SliceIntField("SmoothedRTT", indices); !reflect.DeepEqual(got, want) {
+			t.Errorf("%s: SliceIntField() = %v, want %v", name, got, want)
+		}
+	}
+}
+
+func TestDecodeIntsCached(t *testing.T) {
+	name := `20090601T22:19:19.325928000Z-75.133.69.98:60631.s2c_snaplog`
+	data, err := ioutil.ReadFile(`testdata/web100/` + name)
+	if err != nil {
+		t.Fatal(err)
+	}
+	slog, err := NewSnapLog(data)
+	if err != nil {
+		t.Fatal(err)
+	}
+	m1, err := slog.DecodeInts("SmoothedRTT", "SmoothedRTT")
+	if err != nil {
+		t.Fatal(err)
+	}
+	// ThruBytesAcked is the legacy name of HCThruOctetsAcked.
+	m2, err := slog.DecodeInts("HCThruOctetsAcked", "SmoothedRTT")
+	if err != nil {
+		t.Fatal(err)
+	}
+	m3, err := slog.DecodeInts("ThruBytesAcked")
+	if err != nil {
+		t.Fatal(err)
+	}
+	if &m1.Column("SmoothedRTT")[0] != &m2.Column("SmoothedRTT")[0] {
+		t.Error("SmoothedRTT decoded twice")
+	}
+	if &m2.Column("HCThruOctetsAcked")[0] != &m3.Column("ThruBytesAcked")[0] {
+		t.Error("HCThruOctetsAcked decoded twice")
+	}
+
+	c1, err := slog.ChangeIndices("SmoothedRTT")
+	if err != nil {
+		t.Fatal(err)
+	}
+	c2, err := slog.ChangeIndices("SmoothedRTT")
+	if err != nil {
+		t.Fatal(err)
+	}
+	if &c1[0] != &c2[0] {
+		t.Error("ChangeIndices computed twice")
+	}
+}
+
+// A few indices are decoded directly, and must match the matrix.
+func TestSliceIntFieldSparse(t *testing.T) {
+	name := `20170509T13:45:13.590210000Z_eb.measurementlab.net:48716.c2s_snaplog`
+	data, err := ioutil.ReadFile(`testdata/web100/` + name)
+	if err != nil {
+		t.Fatal(err)
+	}
+	slog, err := NewSnapLog(data)
+	if err != nil {
+		t.Fatal(err)
+	}
+	indices := []int{0, 1, 1000, slog.SnapCount() - 1}
+	sparse := slog.SliceIntField("HCThruOctetsAcked", indices)
+	if slog.intCols != nil {
+		t.Error("SliceIntField() decoded the whole column for sparse indices")
+	}
+	m, err := slog.DecodeInts("HCThruOctetsAcked")
+	if err != nil {
+		t.Fatal(err)
+	}
+	if want := m.Slice("HCThruOctetsAcked", indices); !reflect.DeepEqual(sparse, want) {
+		t.Errorf("SliceIntField() = %v, want %v", sparse, want)
+	}
+}
+
+func TestDecodeIntsErrors(t *testing.T) {
+	name := `20090601T22:19:19.325928000Z-75.133.69.98:60631.s2c_snaplog`
+	data, err := ioutil.ReadFile(`testdata/web100/` + name)
+	if err != nil {
+		t.Fatal(err)
+	}
+	slog, err := NewSnapLog(append([]byte{}, data...))
+	if err != nil {
+		t.Fatal(err)
+	}
+	if _, err := slog.DecodeInts("NoSuchField"); err == nil {
+		t.Error("DecodeInts() missing field, want error")
+	}
+	if _, err := slog.DecodeInts("RemAddress"); err != ErrNotInteger {
+		t.Errorf("DecodeInts() string field = %v, want %v", err, ErrNotInteger)
+	}
+	if got := slog.SliceIntField("RemAddress", []int{0, 1}); len(got) != 0 {
+		t.Errorf("SliceIntField() string field = %v, want empty", got)
+	}
+	slog.raw[slog.bodyOffset+5*slog.read.Length] = 'x'
+	if _, err := slog.DecodeInts("SmoothedRTT"); err == nil {
+		t.Error("DecodeInts() corrupt snapshot, want error")
+	}
+}
+
+func BenchmarkDecodeInts(b *testing.B) {
+	name := `20090601T22:19:19.325928000Z-75.133.69.98:60631.s2c_snaplog`
+	data, err := ioutil.ReadFile(`testdata/web100/` + name)
+	if err != nil {
+		b.Fatal(err)
+	}
+	slog, err := NewSnapLog(data)
+	if err != nil {
+		b.Fatal(err)
+	}
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		m, err := slog.DecodeInts("SmoothedRTT", "HCThruOctetsAcked")
+		if err != nil {
+			b.Fatal(err)
+		}
+		indices := m.ChangeIndices("SmoothedRTT")
+		m.Slice("SmoothedRTT", indices)
+		m.Slice("HCThruOctetsAcked", indices)
+	}
+}
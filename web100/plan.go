@@ -0,0 +1,355 @@
+package web100
+
+import (
+	"encoding/binary"
+	"errors"
+	"math/bits"
+	"strconv"
+	"sync"
+)
+
+// Decoder plans.
+//   Nearly every NDT snaplog uses one of a handful of "/read" header layouts,
+//   and each log contains around 2000 snapshots.  Variable.Save re-resolves the
+//   deprecated field check, the canonical name map lookup, and the type switch
+//   for every field of every snapshot.  A decodePlan resolves all of that once
+//   per distinct layout, so snapshot decoding is a tight loop over offsets.
+
+// fieldKind is the resolved decoding operation for a single field.
+type fieldKind uint8
+
+const (
+	kindInt32 fieldKind = iota // Signed 32 bit integer.
+	kindUint32
+	kindUint64
+	kindUint16
+	kindOctet
+	kindIPv4   // 4 byte address, saved as a dotted quad string.
+	kindIP17   // 17 byte web100 address, saved as a string.
+	kindString // Null terminated STR32.
+)
+
+// planField is a fully resolved field specification.
+type planField struct {
+	name   string // Canonical name.
+	offset int    // Offset, beyond the BEGIN_SNAP_HEADER.
+	size   int
+	kind   fieldKind
+}
+
+// decodePlan holds the resolved field list for a single header layout.
+// It is immutable after construction, and shared across SnapLogs.
+type decodePlan struct {
+	fields []planField
+
+	recordLen int        // Length of the raw record, excluding BEGIN_SNAP_DATA.
+	words     []wordSpan // Fields overlapping each 8 byte word of the record.
+}
+
+func kindOf(t varType) (fieldKind, error) {
+	switch t {
+	case WEB100_TYPE_INTEGER, WEB100_TYPE_INTEGER32:
+		return kindInt32, nil
+	case WEB100_TYPE_INET_ADDRESS_IPV4:
+		return kindIPv4, nil
+	case WEB100_TYPE_COUNTER32, WEB100_TYPE_GAUGE32,
+		WEB100_TYPE_UNSIGNED32, WEB100_TYPE_TIME_TICKS:
+		return kindUint32, nil
+	case WEB100_TYPE_COUNTER64:
+		return kindUint64, nil
+	case WEB100_TYPE_INET_PORT_NUMBER:
+		return kindUint16, nil
+	case WEB100_TYPE_INET_ADDRESS, WEB100_TYPE_INET_ADDRESS_IPV6:
+		return kindIP17, nil
+	case WEB100_TYPE_STR32:
+		return kindString, nil
+	case WEB100_TYPE_OCTET:
+		return kindOctet, nil
+	default:
+		return 0, errors.New("Invalid field type")
+	}
+}
+
+// newDecodePlan resolves canonical names and decoding kinds for all
+// non-deprecated fields in fs.
+func newDecodePlan(fs *fieldSet) (*decodePlan, error) {
+	p := &decodePlan{fields: make([]planField, 0, len(fs.Fields))}
+	for i := range fs.Fields {
+		v := &fs.Fields[i]
+		// Ignore deprecated fields.
+		if v.Name[0] == '_' {
+			continue
+		}
+		kind, err := kindOf(v.Type)
+		if err != nil {
+			return nil, err
+		}
+		name := v.Name
+		if canonical, ok := CanonicalNames[name]; ok {
+			name = canonical
+		}
+		p.fields = append(p.fields, planField{name: name, offset: v.Offset, size: v.Size, kind: kind})
+	}
+	p.initWords(fs.Length - len(BEGIN_SNAP_DATA))
+	return p, nil
+}
+
+// isString reports whether the field is saved as a string.
+func (f *planField) isString() bool {
+	return f.kind >= kindIPv4
+}
+
+// decodeInt64 interprets the data of an integer field.
+func (f *planField) decodeInt64(data []byte) int64 {
+	switch f.kind {
+	case kindInt32:
+		val := binary.LittleEndian.Uint32(data)
+		if val >= 0x7FFFFFFF {
+			return int64(val) - 0x100000000
+		}
+		return int64(val)
+	case kindUint32:
+		return int64(binary.LittleEndian.Uint32(data))
+	case kindUint64:
+		// This conversion to signed may cause overflow panic!
+		return int64(binary.LittleEndian.Uint64(data))
+	case kindUint16:
+		return int64(binary.LittleEndian.Uint16(data))
+	case kindOctet:
+		return int64(data[0])
+	}
+	return 0
+}
+
+// decodeString interprets the data of a string field.
+func (f *planField) decodeString(data []byte) (string, error) {
+	switch f.kind {
+	case kindIPv4:
+		return dottedQuad(data), nil
+	case kindIP17:
+		ip, err := IPFromBytes(data)
+		if err != nil {
+			return "", err
+		}
+		return ip.String(), nil
+	case kindString:
+		n := 0
+		for n < len(data) && data[n] != 0 {
+			n++
+		}
+		return string(data[:n]), nil
+	}
+	return "", errors.New("Invalid field type")
+}
+
+// save interprets the field data, and saves it to snapValues.
+// This must produce exactly the same values as Variable.Save.
+func (f *planField) save(data []byte, snapValues Saver) error {
+	if !f.isString() {
+		snapValues.SetInt64(f.name, f.decodeInt64(data))
+		return nil
+	}
+	str, err := f.decodeString(data)
+	if err != nil {
+		return err
+	}
+	snapValues.SetString(f.name, str)
+	return nil
+}
+
+// dottedQuad formats a 4 byte address without going through fmt.
+func dottedQuad(data []byte) string {
+	b := make([]byte, 0, len("255.255.255.255"))
+	for i := 0; i < 4; i++ {
+		if i > 0 {
+			b = append(b, '.')
+		}
+		b = strconv.AppendUint(b, uint64(data[i]), 10)
+	}
+	return string(b)
+}
+
+// values saves all fields of a raw snapshot record.
+func (p *decodePlan) values(raw []byte, snapValues Saver) {
+	for i := range p.fields {
+		f := &p.fields[i]
+		f.save(raw[f.offset:f.offset+f.size], snapValues)
+	}
+}
+
+// deltas saves only the fields that differ between raw and other.
+func (p *decodePlan) deltas(raw, other []byte, snapValues Saver) {
+	p.forEachChanged(raw, other, func(i int) {
+		f := &p.fields[i]
+		f.save(raw[f.offset:f.offset+f.size], snapValues)
+	})
+}
+
+//=================================================================================
+
+// parsedLayout is the cached result of parsing a header section.
+type parsedLayout struct {
+	fields *fieldSet
+	plan   *decodePlan
+}
+
+// layoutCache maps the raw text of a header section to its parsedLayout.
+// The number of distinct layouts across all archives is very small, so the
+// cache is never pruned.
+var layoutCache = struct {
+	lock    sync.RWMutex
+	layouts map[string]parsedLayout
+}{layouts: make(map[string]parsedLayout, 4)}
+
+// cachedLayout returns the parsedLayout for the header section text, if any.
+func cachedLayout(spec []byte) (parsedLayout, bool) {
+	if len(spec) == 0 {
+		return parsedLayout{}, false
+	}
+	layoutCache.lock.RLock()
+	defer layoutCache.lock.RUnlock()
+	// The compiler avoids allocating a string for this lookup.
+	layout, ok := layoutCache.layouts[string(spec)]
+	return layout, ok
+}
+
+// storeLayout builds the decodePlan for fields, and caches it under spec.
+// An empty spec is never cached.
+func storeLayout(spec []byte, fields *fieldSet) (parsedLayout, error) {
+	plan, err := newDecodePlan(fields)
+	if err != nil {
+		return parsedLayout{}, err
+	}
+	layout := parsedLayout{fields: fields, plan: plan}
+	if len(spec) == 0 {
+		return layout, nil
+	}
+	layoutCache.lock.Lock()
+	defer layoutCache.lock.Unlock()
+	if existing, ok := layoutCache.layouts[string(spec)]; ok {
+		return existing, nil
+	}
+	layoutCache.layouts[string(spec)] = layout
+	return layout, nil
+}
+
+//=================================================================================
+// Change detection.
+//   Consecutive snapshots usually differ in only a handful of counters, so
+//   rather than comparing each field separately, diffMask compares whole
+//   records 32 bytes at a time, and only examines individual fields within
+//   the 8 byte words that actually changed.
+
+// wordSpan is the range of plan fields [first, last) that overlap one 8 byte
+// word of a raw snapshot record.
+type wordSpan struct {
+	first, last int32
+}
+
+// initWords computes the wordSpans for a record of length recordLen.
+func (p *decodePlan) initWords(recordLen int) {
+	p.recordLen = recordLen
+	p.words = make([]wordSpan, (recordLen+7)/8)
+	for w := range p.words {
+		p.words[w] = wordSpan{-1, -1}
+	}
+	for i := range p.fields {
+		f := &p.fields[i]
+		for w := f.offset / 8; w <= (f.offset+f.size-1)/8 && w < len(p.words); w++ {
+			if p.words[w].first < 0 {
+				p.words[w].first = int32(i)
+			}
+			p.words[w].last = int32(i + 1)
+		}
+	}
+	for w := range p.words {
+		if p.words[w].first < 0 {
+			p.words[w] = wordSpan{}
+		}
+	}
+}
+
+// maskLen returns the number of uint64 needed for a field bitmap.
+func (p *decodePlan) maskLen() int {
+	return (len(p.fields) + 63) / 64
+}
+
+// markWord sets the mask bits for fields overlapping word w that differ.
+func (p *decodePlan) markWord(w int, raw, other []byte, mask []uint64) {
+	span := p.words[w]
+	for i := span.first; i < span.last; i++ {
+		if mask[i/64]&(1<<(uint(i)%64)) != 0 {
+			continue
+		}
+		f := &p.fields[i]
+		if string(raw[f.offset:f.offset+f.size]) != string(other[f.offset:f.offset+f.size]) {
+			mask[i/64] |= 1 << (uint(i) % 64)
+		}
+	}
+}
+
+// diffMask sets a bit in mask for each plan field that differs between the
+// raw records.  mask must have length maskLen(), and be zeroed by the caller.
+func (p *decodePlan) diffMask(raw, other []byte, mask []uint64) {
+	n := p.recordLen
+	if len(raw) < n || len(other) < n {
+		// Should not happen, but fall back to comparing every field.
+		for w := range p.words {
+			p.markWord(w, raw, other, mask)
+		}
+		return
+	}
+	w := 0
+	// Compare 32 bytes at a time, and only look at individual words if
+	// something in the block changed.
+	for ; (w+4)*8 <= n; w += 4 {
+		a, b := raw[w*8:w*8+32], other[w*8:w*8+32]
+		x0 := binary.LittleEndian.Uint64(a[0:]) ^ binary.LittleEndian.Uint64(b[0:])
+		x1 := binary.LittleEndian.Uint64(a[8:]) ^ binary.LittleEndian.Uint64(b[8:])
+		x2 := binary.LittleEndian.Uint64(a[16:]) ^ binary.LittleEndian.Uint64(b[16:])
+		x3 := binary.LittleEndian.Uint64(a[24:]) ^ binary.LittleEndian.Uint64(b[24:])
+		if x0|x1|x2|x3 == 0 {
+			continue
+		}
+		if x0 != 0 {
+			p.markWord(w, raw, other, mask)
+		}
+		if x1 != 0 {
+			p.markWord(w+1, raw, other, mask)
+		}
+		if x2 != 0 {
+			p.markWord(w+2, raw, other, mask)
+		}
+		if x3 != 0 {
+			p.markWord(w+3, raw, other, mask)
+		}
+	}
+	for ; (w+1)*8 <= n; w++ {
+		if binary.LittleEndian.Uint64(raw[w*8:]) != binary.LittleEndian.Uint64(other[w*8:]) {
+			p.markWord(w, raw, other, mask)
+		}
+	}
+	// Partial final word.
+	if w < len(p.words) && string(raw[w*8:n]) != string(other[w*8:n]) {
+		p.markWord(w, raw, other, mask)
+	}
+}
+
+// forEachChanged calls f for the index of each plan field that differs
+// between raw and other, in field order.
+func (p *decodePlan) forEachChanged(raw, other []byte, f func(i int)) {
+	// Use stack storage for the mask in the common case.
+	var buf [4]uint64
+	var mask []uint64
+	if p.maskLen() <= len(buf) {
+		mask = buf[:p.maskLen()]
+	} else {
+		mask = make([]uint64, p.maskLen())
+	}
+	p.diffMask(raw, other, mask)
+	for m := range mask {
+		for bitsLeft := mask[m]; bitsLeft != 0; bitsLeft &= bitsLeft - 1 {
+			f(m*64 + bits.TrailingZeros64(bitsLeft))
+		}
+	}
+}
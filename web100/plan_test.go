@@ -0,0 +1,126 @@
+package web100
+
+import (
+	"io/ioutil"
+	"reflect"
+	"testing"
+)
+
+type mapSaver map[string]interface{}
+
+func (s mapSaver) SetInt64(name string, val int64)   { s[name] = val }
+func (s mapSaver) SetString(name string, val string) { s[name] = val }
+func (s mapSaver) SetBool(name string, val bool)     { s[name] = val }
+
+// The decoder plan must produce exactly the same values as Variable.Save.
+func TestDecodePlanMatchesSave(t *testing.T) {
+	names := []string{
+		`20170509T13:45:13.590210000Z_eb.measurementlab.net:48716.c2s_snaplog`,
+		`20090601T22:19:19.325928000Z-75.133.69.98:60631.s2c_snaplog`,
+	}
+	for _, name := range names {
+		data, err := ioutil.ReadFile(`testdata/web100/` + name)
+		if err != nil {
+			t.Fatal(err)
+		}
+		slog, err := NewSnapLog(data)
+		if err != nil {
+			t.Fatal(err)
+		}
+		for _, n := range []int{0, 1, 1000, slog.SnapCount() - 1} {
+			snap, err := slog.Snapshot(n)
+			if err != nil {
+				t.Fatal(err)
+			}
+			want := mapSaver{}
+			for _, field := range snap.fields.Fields {
+				field.Save(snap.raw[field.Offset:field.Offset+field.Size], want)
+			}
+			got := mapSaver{}
+			snap.SnapshotValues(got)
+			if !reflect.DeepEqual(want, got) {
+				t.Errorf("%s[%d]: plan values differ from Variable.Save", name, n)
+			}
+		}
+	}
+}
+
+func TestLayoutCache(t *testing.T) {
+	name := `20170509T13:45:13.590210000Z_eb.measurementlab.net:48716.c2s_snaplog`
+	data, err := ioutil.ReadFile(`testdata/web100/` + name)
+	if err != nil {
+		t.Fatal(err)
+	}
+	a, err := NewSnapLog(data)
+	if err != nil {
+		t.Fatal(err)
+	}
+	b, err := NewSnapLog(data)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if a.plan != b.plan {
+		t.Error("Expected shared decoder plan")
+	}
+	if a.bodyOffset != b.bodyOffset || a.read.Length != b.read.Length {
+		t.Error("Cached layout produced different header offsets")
+	}
+}
+
+// diffMask must flag exactly the fields that differ between two records.
+func TestDiffMask(t *testing.T) {
+	name := `20090601T22:19:19.325928000Z-75.133.69.98:60631.s2c_snaplog`
+	data, err := ioutil.ReadFile(`testdata/web100/` + name)
+	if err != nil {
+		t.Fatal(err)
+	}
+	slog, err := NewSnapLog(data)
+	if err != nil {
+		t.Fatal(err)
+	}
+	p := slog.plan
+	check := func(n int, a, b []byte) {
+		got := make([]bool, len(p.fields))
+		p.forEachChanged(a, b, func(i int) { got[i] = true })
+		for i := range p.fields {
+			f := &p.fields[i]
+			want := string(a[f.offset:f.offset+f.size]) != string(b[f.offset:f.offset+f.size])
+			if got[i] != want {
+				t.Errorf("%d: field %s changed = %v, want %v", n, f.name, got[i], want)
+			}
+		}
+	}
+	last, _ := slog.Snapshot(0)
+	for n := 1; n < slog.SnapCount(); n += 7 {
+		snap, err := slog.Snapshot(n)
+		if err != nil {
+			t.Fatal(err)
+		}
+		check(n, snap.raw, last.raw)
+		last = snap
+	}
+	// Single byte changes at every offset, including the partial final word.
+	a, _ := slog.Snapshot(0)
+	for off := 0; off < len(a.raw); off++ {
+		b := append([]byte{}, a.raw...)
+		b[off] ^= 0x10
+		check(off, a.raw, b)
+	}
+}
+
+func TestChangeIndicesCorrupt(t *testing.T) {
+	name := `20090601T22:19:19.325928000Z-75.133.69.98:60631.s2c_snaplog`
+	data, err := ioutil.ReadFile(`testdata/web100/` + name)
+	if err != nil {
+		t.Fatal(err)
+	}
+	slog, err := NewSnapLog(append([]byte{}, data...))
+	if err != nil {
+		t.Fatal(err)
+	}
+	slog.raw[slog.bodyOffset+5*slog.read.Length] = 'x'
+	got, err := slog.ChangeIndices("SmoothedRTT")
+	if got != nil || err != nil {
+		t.Errorf("ChangeIndices() = %v, %v, want nil, nil", got, err)
+	}
+}
@@ -0,0 +1,165 @@
+package web100
+
+import (
+	"bytes"
+	"errors"
+	"io"
+)
+
+// Streaming access.
+//   SnapLog requires the entire decompressed file in memory.  SnapReader
+//   instead parses the header, then reads snapshots one at a time from an
+//   io.Reader, into a ring of two records, so memory use depends on the
+//   record length rather than the file length.
+
+const (
+	// maxHeaderLen bounds the header size accepted by NewSnapReader.  Typical
+	// headers are about 10KB.
+	maxHeaderLen = 256 * 1024
+	// headerTrailerLen is the number of bytes following END_OF_HEADER: the
+	// log time, the group name, and the connection spec.
+	headerTrailerLen = 4 + GROUPNAME_LEN_MAX + 16
+)
+
+var (
+	// ErrMissingBeginSnapData is returned when a snapshot record does not
+	// start with BEGIN_SNAP_DATA.
+	ErrMissingBeginSnapData = errors.New("missing BeginSnapData")
+	// ErrTruncated is returned when the final snapshot record is incomplete.
+	ErrTruncated = errors.New("last snapshot truncated")
+)
+
+// SnapReader reads the snapshots of a snaplog sequentially.
+// SnapReader is NOT THREAD-SAFE.
+type SnapReader struct {
+	header *SnapLog
+	r      io.Reader
+
+	ring  [2][]byte // Snapshot records, including BEGIN_SNAP_DATA.
+	count int       // Number of records read, including invalid records.
+	last  error     // nil, or ErrMissingBeginSnapData, for the latest record.
+	err   error     // Sticky read error.
+}
+
+// NewSnapReader parses the snaplog header from r, and returns a SnapReader
+// positioned at the first snapshot.
+func NewSnapReader(r io.Reader) (*SnapReader, error) {
+	buf := make([]byte, 0, 16*1024)
+	headerLen := -1
+	for headerLen < 0 {
+		if len(buf) == cap(buf) {
+			if cap(buf) >= maxHeaderLen {
+				return nil, errors.New("Header too long")
+			}
+			buf = append(buf, 0)[:len(buf)]
+		}
+		n, err := r.Read(buf[len(buf):cap(buf)])
+		buf = buf[:len(buf)+n]
+		// Look for the end of header, and the fixed length fields after it.
+		if end := bytes.Index(buf, []byte(END_OF_HEADER)); end >= 0 {
+			if end+len(END_OF_HEADER)+headerTrailerLen <= len(buf) {
+				headerLen = end + len(END_OF_HEADER) + headerTrailerLen
+				break
+			}
+		}
+		if err == io.EOF {
+			return nil, errors.New("Encountered EOF")
+		}
+		if err != nil {
+			return nil, err
+		}
+	}
+	header, err := NewSnapLog(buf[:headerLen:headerLen])
+	if err != nil {
+		return nil, err
+	}
+	length := header.read.Length
+	ring := make([]byte, 2*length)
+	sr := &SnapReader{header: header, ring: [2][]byte{ring[:length:length], ring[length:]}}
+	// Any bytes beyond the header belong to the first snapshots.
+	sr.r = r
+	if rest := buf[headerLen:]; len(rest) > 0 {
+		sr.r = io.MultiReader(bytes.NewReader(rest), r)
+	}
+	return sr, nil
+}
+
+// Header returns a SnapLog containing just the header, for access to the
+// version, log time, connection spec, etc.  It has no snapshots.
+func (sr *SnapReader) Header() *SnapLog {
+	return sr.header
+}
+
+// Count returns the number of snapshot records read so far, including any
+// with a missing BEGIN_SNAP_DATA.
+func (sr *SnapReader) Count() int {
+	return sr.count
+}
+
+// Next reads the next snapshot.  It returns io.EOF when there are no more
+// snapshots, ErrTruncated if the final record is incomplete, and
+// ErrMissingBeginSnapData for a corrupt record, after which reading may
+// continue.  The returned Snapshot shares the reader's buffers, and remains
+// valid only until the second following call to Next.  Use Snapshot.Clone
+// to retain it longer.
+func (sr *SnapReader) Next() (Snapshot, error) {
+	if sr.err != nil {
+		return Snapshot{}, sr.err
+	}
+	rec := sr.ring[sr.count%2]
+	_, err := io.ReadFull(sr.r, rec)
+	switch {
+	case err == io.ErrUnexpectedEOF:
+		sr.err = ErrTruncated
+		return Snapshot{}, sr.err
+	case err != nil:
+		sr.err = err
+		return Snapshot{}, err
+	}
+	sr.count++
+	return sr.Last()
+}
+
+// Last returns the most recently read snapshot, with the same lifetime as the
+// result of Next.
+func (sr *SnapReader) Last() (Snapshot, error) {
+	if sr.count == 0 {
+		return Snapshot{}, errors.New("no snapshots")
+	}
+	rec := sr.ring[(sr.count-1)%2]
+	if string(rec[:len(BEGIN_SNAP_DATA)]) != BEGIN_SNAP_DATA {
+		sr.last = ErrMissingBeginSnapData
+		return Snapshot{}, sr.last
+	}
+	sr.last = nil
+	return Snapshot{raw: rec[len(BEGIN_SNAP_DATA):], fields: &sr.header.read, plan: sr.header.plan}, nil
+}
+
+// Drain reads the remaining snapshots without decoding them.  This
+// invalidates any Snapshots previously returned.  Like
+// SnapLog.ValidateSnapshots, the error reports whether the final record is
+// valid and complete.
+func (sr *SnapReader) Drain() error {
+	for sr.err == nil {
+		sr.Next()
+	}
+	switch {
+	case sr.err != io.EOF:
+		return sr.err
+	case sr.count == 0:
+		return errors.New("no snapshots")
+	default:
+		return sr.last
+	}
+}
+
+// Clone returns a copy of the snapshot, using buf for storage if it is large
+// enough.
+func (snap *Snapshot) Clone(buf []byte) Snapshot {
+	if cap(buf) < len(snap.raw) {
+		buf = make([]byte, len(snap.raw))
+	}
+	buf = buf[:len(snap.raw)]
+	copy(buf, snap.raw)
+	return Snapshot{raw: buf, fields: snap.fields, plan: snap.plan}
+}
@@ -0,0 +1,95 @@
+package web100_test
+
+import (
+	"bytes"
+	"io"
+	"io/ioutil"
+	"testing"
+	"testing/iotest"
+
+	"github.com/m-lab/etl/web100"
+)
+
+// SnapReader should produce the same snapshots as SnapLog.
+func TestSnapReaderMatchesSnapLog(t *testing.T) {
+	name := `20170509T13:45:13.590210000Z_eb.measurementlab.net:48716.c2s_snaplog`
+	data, err := ioutil.ReadFile(`testdata/web100/` + name)
+	if err != nil {
+		t.Fatal(err)
+	}
+	slog, err := web100.NewSnapLog(data)
+	if err != nil {
+		t.Fatal(err)
+	}
+	sr, err := web100.NewSnapReader(iotest.HalfReader(bytes.NewReader(data)))
+	if err != nil {
+		t.Fatal(err)
+	}
+	if sr.Header().Version != slog.Version || sr.Header().LogTime != slog.LogTime {
+		t.Error("Header mismatch")
+	}
+	for i := 0; ; i++ {
+		snap, err := sr.Next()
+		if err == io.EOF {
+			break
+		}
+		if err != nil {
+			t.Fatal(err)
+		}
+		want, err := slog.Snapshot(i)
+		if err != nil {
+			t.Fatal(err)
+		}
+		gotVals := mapSaver{}
+		wantVals := mapSaver{}
+		snap.SnapshotValues(gotVals)
+		want.SnapshotValues(wantVals)
+		if len(gotVals) != len(wantVals) || gotVals["Duration"] != wantVals["Duration"] {
+			t.Fatalf("Snapshot %d differs", i)
+		}
+	}
+	if sr.Count() != slog.SnapCount() {
+		t.Errorf("Count() = %d, want %d", sr.Count(), slog.SnapCount())
+	}
+	if err := sr.Drain(); err != nil {
+		t.Error(err)
+	}
+}
+
+func TestSnapReaderTruncated(t *testing.T) {
+	name := `20170509T13:45:13.590210000Z_eb.measurementlab.net:48716.c2s_snaplog`
+	data, err := ioutil.ReadFile(`testdata/web100/` + name)
+	if err != nil {
+		t.Fatal(err)
+	}
+	slog, err := web100.NewSnapLog(data)
+	if err != nil {
+		t.Fatal(err)
+	}
+	sr, err := web100.NewSnapReader(bytes.NewReader(data[:len(data)-10]))
+	if err != nil {
+		t.Fatal(err)
+	}
+	if err := sr.Drain(); err != web100.ErrTruncated {
+		t.Errorf("Drain() = %v, want %v", err, web100.ErrTruncated)
+	}
+	if sr.Count() != slog.SnapCount()-1 {
+		t.Errorf("Count() = %d, want %d", sr.Count(), slog.SnapCount()-1)
+	}
+	last, err := sr.Last()
+	if err != nil {
+		t.Fatal(err)
+	}
+	vals := mapSaver{}
+	last.SnapshotValues(vals)
+	want, _ := slog.Snapshot(slog.SnapCount() - 2)
+	wantVals := mapSaver{}
+	want.SnapshotValues(wantVals)
+	if vals["Duration"] != wantVals["Duration"] {
+		t.Error("Last() returned the wrong snapshot")
+	}
+
+	if _, err := web100.NewSnapReader(bytes.NewReader(data[:1000])); err == nil {
+		t.Error("Expected error for truncated header")
+	}
+}
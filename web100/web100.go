@@ -310,6 +310,7 @@ type connectionSpec struct {
 //=================================================================================
 
 // SnapLog encapsulates the raw data and all elements of the header.
+// SnapLog is NOT THREAD-SAFE.
 type SnapLog struct {
 	// The entire raw contents of the file.  Generally 1.5MB, but may be much larger
 	raw []byte
@@ -325,6 +326,16 @@ type SnapLog struct {
 	// The name "read" is ugly, but that is the name of the web100 header section.
 	read fieldSet
 	tune fieldSet
+	// The decoder plan for the "/read" fields.  Shared with other SnapLogs
+	// that have the same header layout.
+	plan *decodePlan
+	// Number of leading snapshots with a valid BEGIN_SNAP_DATA marker, or -1
+	// if not yet checked.  See validPrefix.
+	validSnaps int
+	// Lazily decoded integer columns, indexed by plan field, and change
+	// indices, indexed by "/read" field.  See DecodeInts and ChangeIndices.
+	intCols [][]int64
+	changes [][]int
 
 	// Use with caution.  Generally should use connection spec from .meta file or
 	// from snapshot instead.
@@ -442,13 +453,27 @@ func NewSnapLog(raw []byte) (*SnapLog, error) {
 		return nil, err
 	}
 
-	// Lots of allocation here.
-	// TODO - could improve alloc efficiency here.
-	read, err := parseFields(buf, "/read\n", "\n")
-	if err != nil {
-		return nil, err
+	// The "/read" section is terminated by an empty line.  Nearly all snaplogs
+	// share a few layouts, so we reuse the parsed fields and decoder plan
+	// whenever the section text matches one we have already seen.
+	var readSpec []byte
+	if end := bytes.Index(buf.Bytes(), []byte("\n\n")); end >= 0 {
+		readSpec = buf.Bytes()[:end+2]
+	}
+	layout, ok := cachedLayout(readSpec)
+	if ok {
+		buf.Next(len(readSpec))
+	} else {
+		read, err := parseFields(buf, "/read\n", "\n")
+		if err != nil {
+			return nil, err
+		}
+		read.Length += len(BEGIN_SNAP_DATA)
+		layout, err = storeLayout(readSpec, read)
+		if err != nil {
+			return nil, err
+		}
 	}
-	read.Length += len(BEGIN_SNAP_DATA)
 
 	// The terminator here does NOT start with \n.  8-(
 	tune, err := parseFields(buf, "/tune\n", END_OF_HEADER)
@@ -491,7 +516,7 @@ func NewSnapLog(raw []byte) (*SnapLog, error) {
 
 	slog := SnapLog{raw: raw, Version: version, LogTime: logTime, GroupName: groupName,
 		connSpecOffset: connSpecOffset, bodyOffset: bodyOffset,
-		spec: *spec, read: *read, tune: *tune, connSpec: connSpec}
+		spec: *spec, read: *layout.fields, tune: *tune, plan: layout.plan, validSnaps: -1, connSpec: connSpec}
 
 	return &slog, nil
 }
@@ -527,8 +552,9 @@ func (sl *SnapLog) ValidateSnapshots() error {
 // Snapshot represents a complete snapshot from a snapshot log.
 type Snapshot struct {
 	// Just the raw data, without BEGIN_SNAP_DATA.
-	raw    []byte    // The raw data, NOT including the BEGIN_SNAP_HEADER
-	fields *fieldSet // The fieldset describing the raw contents.
+	raw    []byte      // The raw data, NOT including the BEGIN_SNAP_HEADER
+	fields *fieldSet   // The fieldset describing the raw contents.
+	plan   *decodePlan // The resolved decoder for fields.
 }
 
 // Snapshot returns the snapshot at index n, or error if n is not a valid index, or data is corrupted.
@@ -545,12 +571,7 @@ func (sl *SnapLog) Snapshot(n int) (Snapshot, error) {
 	// We use the "/read" field group, as that is what is always used for NDT snapshots.
 	// This may be incorrect for use in other settings.
 	return Snapshot{raw: sl.raw[offset+len(BEGIN_SNAP_DATA) : offset+sl.read.Length],
-		fields: &sl.read}, nil
-}
-
-func (snap *Snapshot) reset(data []byte, fields *fieldSet) {
-	snap.fields = fields
-	snap.raw = data
+		fields: &sl.read, plan: sl.plan}, nil
 }
 
 // SnapshotValues writes all values into the provided Saver.
@@ -558,11 +579,7 @@ func (snap *Snapshot) SnapshotValues(snapValues Saver) error {
 	if snap.raw == nil {
 		return errors.New("Empty/Invalid Snaplog")
 	}
-	var field Variable
-	for _, field = range snap.fields.Fields {
-		// Interpret and save the web100 field value.
-		field.Save(snap.raw[field.Offset:field.Offset+field.Size], snapValues)
-	}
+	snap.plan.values(snap.raw, snapValues)
 	return nil
 }
 
@@ -575,46 +592,61 @@ func (snap *Snapshot) SnapshotDeltas(other *Snapshot, snapValues Saver) error {
 		// If other is empty, return full snapshot
 		return snap.SnapshotValues(snapValues)
 	}
-	var field Variable
-	for _, field = range snap.fields.Fields {
-		a := other.raw[field.Offset : field.Offset+field.Size]
-		b := snap.raw[field.Offset : field.Offset+field.Size]
-		if bytes.Compare(a, b) != 0 {
-			// Interpret and save the web100 field value.
-			field.Save(b, snapValues)
-		}
-	}
+	snap.plan.deltas(snap.raw, other.raw, snapValues)
 	return nil
 }
 
 // ChangeIndices finds all snapshot indices where the specified field
-// changes value.
+// changes value.  The result is cached, and must not be modified.
 func (sl *SnapLog) ChangeIndices(fieldName string) ([]int, error) {
-	result := make([]int, 0, 100)
-	field := sl.read.find(fieldName)
-	if field == nil {
+	index, ok := sl.read.FieldMap[fieldName]
+	if !ok {
 		return nil, errors.New("Field not found")
 	}
+	field := &sl.read.Fields[index]
+	// The markers are checked once per SnapLog, rather than once per snapshot
+	// for each call.
+	if sl.validPrefix() < sl.SnapCount() {
+		return nil, nil
+	}
+	if sl.changes == nil {
+		sl.changes = make([][]int, len(sl.read.Fields))
+	}
+	if sl.changes[index] != nil {
+		return sl.changes[index], nil
+	}
+	result := make([]int, 0, 100)
 	last := make([]byte, field.Size)
-	var s Snapshot // This saves about 2 usec, compared with creating new Snapshot for each row.
+	start := sl.bodyOffset + len(BEGIN_SNAP_DATA) + field.Offset
 	for i := 0; i < sl.SnapCount(); i++ {
-		// This saves about 30 usec
-		offset := sl.bodyOffset + i*sl.read.Length
-		begin := string(sl.raw[offset : offset+len(BEGIN_SNAP_DATA)])
-		if begin != BEGIN_SNAP_DATA {
-			return nil, nil
-		}
-		s.reset(sl.raw[offset+len(BEGIN_SNAP_DATA):offset+sl.read.Length], &sl.read)
-
-		data := s.raw[field.Offset : field.Offset+field.Size]
-		if bytes.Compare(data, last) != 0 {
+		offset := start + i*sl.read.Length
+		data := sl.raw[offset : offset+field.Size]
+		if string(data) != string(last) {
 			result = append(result, i)
 		}
 		last = data
 	}
+	sl.changes[index] = result
 	return result, nil
 }
 
+// validPrefix returns the number of leading snapshots that have a valid
+// BEGIN_SNAP_DATA marker.  The result is computed on first use.
+func (sl *SnapLog) validPrefix() int {
+	if sl.validSnaps >= 0 {
+		return sl.validSnaps
+	}
+	n := 0
+	for ; n < sl.SnapCount(); n++ {
+		offset := sl.bodyOffset + n*sl.read.Length
+		if string(sl.raw[offset:offset+len(BEGIN_SNAP_DATA)]) != BEGIN_SNAP_DATA {
+			break
+		}
+	}
+	sl.validSnaps = n
+	return n
+}
+
 type IntArraySaver struct {
 	Integers []int64
 }
@@ -629,19 +661,38 @@ func (s *IntArraySaver) SetInt64(name string, val int64) {
 func (s *IntArraySaver) SetBool(name string, val bool)     {}
 func (s *IntArraySaver) SetString(name string, val string) {}
 
-// about 40 nsec per field.
-func (sl *SnapLog) SliceIntField(fieldName string, indices []int) []int64 {
-	var s Snapshot // This saves about 2 usec, compared with creating new Snapshot for each row.
-	field := sl.read.find(fieldName)
-	result := NewIntArraySaver(len(indices))
-	for i := 0; i < len(indices); i++ {
-		// Safe to skip the validation, because it was done when getting the indices.
-		offset := sl.bodyOffset + indices[i]*sl.read.Length
-		s.reset(sl.raw[offset+len(BEGIN_SNAP_DATA):offset+sl.read.Length], &sl.read)
+// sparseSlice is the largest fraction of the snapshots for which
+// SliceIntField decodes each snapshot directly, rather than the whole column.
+const sparseSlice = 8
 
-		field.Save(s.raw[field.Offset:field.Offset+field.Size], &result)
+// SliceIntField returns the values of an integer field at the snapshot
+// indices.  A few indices are decoded directly from their snapshots.
+// Otherwise the whole field is decoded by DecodeInts, and cached, so callers
+// that need several fields should first decode them together with DecodeInts.
+func (sl *SnapLog) SliceIntField(fieldName string, indices []int) []int64 {
+	id, err := sl.intField(fieldName)
+	if err != nil {
+		return []int64{}
+	}
+	cached := sl.intCols != nil && sl.intCols[id] != nil
+	if cached || len(indices)*sparseSlice > sl.SnapCount() {
+		m, err := sl.DecodeInts(fieldName)
+		if err != nil {
+			return []int64{}
+		}
+		return m.Slice(fieldName, indices)
+	}
+	f := &sl.plan.fields[id]
+	result := make([]int64, 0, len(indices))
+	for _, i := range indices {
+		offset := sl.bodyOffset + i*sl.read.Length
+		if string(sl.raw[offset:offset+len(BEGIN_SNAP_DATA)]) != BEGIN_SNAP_DATA {
+			return []int64{}
+		}
+		rec := sl.raw[offset+len(BEGIN_SNAP_DATA) : offset+sl.read.Length]
+		result = append(result, f.decodeInt64(rec[f.offset:f.offset+f.size]))
 	}
-	return result.Integers
+	return result
 }
 
 // For each increment in CongSignal, we want to add values of snapCount, SRTT
@@ -185,6 +185,14 @@ func (tf *StandardTaskFactory) Get(ctx context.Context, dp etl.DataPath) (*task.
 // Returns an http status code and an error if the task did not complete
 // successfully.
 func ProcessGKETask(ctx context.Context, path etl.DataPath, tf task.Factory) etl.ProcessingError {
+	_, err := ProcessGKETaskComplete(ctx, path, tf)
+	return err
+}
+
+// ProcessGKETaskComplete is ProcessGKETask, but also reports whether every
+// test was parsed, and every row committed.  See task.Task.Complete.  The
+// task is not complete unless its sink is also closed without error.
+func ProcessGKETaskComplete(ctx context.Context, path etl.DataPath, tf task.Factory) (bool, etl.ProcessingError) {
 	// Count number of workers operating on each table.
 	metrics.WorkerCount.WithLabelValues(path.DataType).Inc()
 	defer metrics.WorkerCount.WithLabelValues(path.DataType).Dec()
@@ -197,15 +205,39 @@ func ProcessGKETask(ctx context.Context, path etl.DataPath, tf task.Factory) etl
 	if err != nil {
 		metrics.TaskCount.WithLabelValues(err.DataType(), err.Detail()).Inc()
 		log.Printf("TaskFactory error: %v", err)
-		return err
+		return false, err
 	}
 
-	defer tsk.Close()
-	return DoGKETask(tsk, path)
+	if err := DoGKETask(tsk, path); err != nil {
+		tsk.Close()
+		return false, err
+	}
+	if err := tsk.Close(); err != nil {
+		metrics.TaskCount.WithLabelValues(path.DataType, "CloseError").Inc()
+		log.Printf("Error closing task: %v", err)
+		return false, factory.NewError(
+			path.DataType, "CloseError", http.StatusInternalServerError, err)
+	}
+	return tsk.Complete(), nil
 }
 
 // DoGKETask creates task, processes all tests and handle metrics
 func DoGKETask(tsk *task.Task, path etl.DataPath) etl.ProcessingError {
+	// Parsers that can fork are spread across etl.ParseWorkers goroutines,
+	// even if prefetching is not otherwise enabled.
+	if _, ok := tsk.Parser.(etl.Forker); ok && etl.ParseWorkers > 1 {
+		prefetch := etl.PrefetchTests
+		if prefetch < 2*etl.ParseWorkers {
+			prefetch = 2 * etl.ParseWorkers
+		}
+		tsk.SetPipeline(prefetch, etl.ParseWorkers)
+		// Large indexed archives are also read as concurrent byte ranges.
+		if s, ok := tsk.TestSource.(etl.Splitter); ok && etl.ArchiveSplits > 1 {
+			if n := s.Split(etl.ArchiveSplits); n > 1 {
+				log.Println("Reading", n, "ranges of", path.URI)
+			}
+		}
+	}
 	files, err := tsk.ProcessAllTests(true) // fail fast on parsing errors.
 
 	dateFormat := "20060102"